@@ -0,0 +1,292 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <iopp/concepts.hpp>
+
+// bit I/O specialized for block coding
+//
+// BitWriter and BitReader keep a 64-bit accumulator and work on whole 64-bit words, so writing or reading a code takes a few shifts rather than a loop over its bits
+// like the iopp bit sinks and sources, multi-bit values are written and read in MSB-first order,
+// so anything written to a BitWriter can be appended to any other bit sink as a sequence of 64-bit writes
+
+template<iopp::BitSink Sink>
+class BitWriteCounter {
+private:
+    Sink const* sink_;
+    size_t initial_;
+
+public:
+    BitWriteCounter(Sink const& sink) : sink_(&sink), initial_(sink.num_bits_written()) {
+    }
+
+    size_t num() const { return sink_->num_bits_written() - initial_; }
+};
+
+// a bit sink that discards everything and only counts the number of bits written
+class BitCounter {
+private:
+    size_t num_;
+
+public:
+    BitCounter() : num_(0) {
+    }
+
+    void write(bool const) { ++num_; }
+    void write(uintmax_t const, size_t const bits) { num_ += bits; }
+    void flush() {}
+
+    size_t num_bits_written() const { return num_; }
+};
+
+// a bit sink that buffers the bits written to it in memory, so they can be read or appended to another sink later
+class BitWriter {
+private:
+    std::vector<uint64_t> words_; // full words
+    uint64_t acc_;                // pending bits, left-aligned
+    size_t fill_;                 // the number of pending bits, always less than 64
+
+public:
+    BitWriter() : acc_(0), fill_(0) {
+    }
+
+    void write(bool const b) {
+        acc_ |= uint64_t(b) << (63 - fill_);
+        if(++fill_ == 64) {
+            words_.push_back(acc_);
+            acc_ = 0;
+            fill_ = 0;
+        }
+    }
+
+    void write(uintmax_t x, size_t const bits) {
+        assert(bits <= 64);
+        if(bits == 0) [[unlikely]] return;
+        x &= ~uint64_t(0) >> (64 - bits);
+
+        auto const free = 64 - fill_;
+        if(bits < free) {
+            acc_ |= x << (free - bits);
+            fill_ += bits;
+        } else {
+            // the accumulator overflows, the remaining bits go into the next word
+            auto const rest = bits - free;
+            words_.push_back(acc_ | (x >> rest));
+            acc_ = (x << 1) << (63 - rest); // nb: zero if rest = 0, avoiding a shift by 64
+            fill_ = rest;
+        }
+    }
+
+    void flush() {}
+
+    void clear() {
+        words_.clear();
+        acc_ = 0;
+        fill_ = 0;
+    }
+
+    size_t num_bits_written() const { return 64 * words_.size() + fill_; }
+
+    // returns the packed words, padded by an additional zero word as required by BitReader
+    std::vector<uint64_t> words() const {
+        auto words = words_;
+        words.push_back(acc_);
+        words.push_back(0);
+        return words;
+    }
+
+    template<iopp::BitSink Sink>
+    void append_to(Sink& sink) const {
+        for(auto const w : words_) {
+            sink.write(w, 64);
+        }
+        if(fill_) sink.write(acc_ >> (64 - fill_), fill_);
+    }
+};
+
+// a bit source reading from packed words as returned by BitWriter::words
+// the words must be followed by at least one additional (padding) word, so that bits can be extracted from any position without branching
+class BitReader {
+private:
+    uint64_t const* words_;
+    size_t num_bits_;
+    size_t pos_;
+
+    // the 64 bits starting at the current position
+    uint64_t window() const {
+        auto const i = pos_ / 64;
+        auto const r = pos_ % 64;
+        return (words_[i] << r) | ((words_[i+1] >> 1) >> (63 - r)); // nb: the second term is zero if r = 0, avoiding a shift by 64
+    }
+
+public:
+    BitReader(uint64_t const* words, size_t const num_bits) : words_(words), num_bits_(num_bits), pos_(0) {
+    }
+
+    bool read() {
+        assert(pos_ < num_bits_);
+        auto const b = (words_[pos_ / 64] >> (63 - pos_ % 64)) & 1;
+        ++pos_;
+        return b;
+    }
+
+    // returns the next bits without consuming them
+    uint64_t peek(size_t const bits) const {
+        assert(bits > 0 && bits <= 64);
+        return window() >> (64 - bits);
+    }
+
+    uintmax_t read(size_t const bits) {
+        assert(bits <= 64);
+        assert(pos_ + bits <= num_bits_);
+        if(bits == 0) [[unlikely]] return 0;
+        auto const x = peek(bits);
+        pos_ += bits;
+        return x;
+    }
+
+    void skip(size_t const bits) {
+        assert(pos_ + bits <= num_bits_);
+        pos_ += bits;
+    }
+
+    explicit operator bool() const { return pos_ < num_bits_; }
+
+    size_t num_bits_read() const { return pos_; }
+    size_t num_bits_left() const { return num_bits_ - pos_; }
+};
+
+// bit sources that allow looking at the next bits without consuming them
+template<typename Src>
+concept PeekableBitSource = iopp::BitSource<Src> && requires(Src& src, size_t const bits) {
+    { src.peek(bits) } -> std::convertible_to<uint64_t>;
+    { src.skip(bits) };
+};
+
+// bit sources that know how many bits are left to read
+template<typename Src>
+concept SizedBitSource = iopp::BitSource<Src> && requires(Src const& src) {
+    { src.num_bits_left() } -> std::convertible_to<size_t>;
+};
+
+// wraps any bit source so that it can be peeked
+//
+// a source must not be read past its end, so if it does not know how many bits are left, the bits to peek are buffered one by one as they are needed
+// otherwise, the buffer is refilled using a single read of as many bits as fit
+// when the source ends before the peeked bits, the missing bits are zero
+template<iopp::BitSource Src>
+class BitLookahead {
+public:
+    static constexpr size_t MAX_PEEK = 32;
+
+private:
+    Src* src_;
+    uint64_t buffer_; // the buffered bits, left-aligned
+    size_t num_buffered_;
+
+    // buffers at least the given number of bits, unless the source ends before
+    void refill(size_t const bits) {
+        if constexpr(SizedBitSource<Src>) {
+            auto const n = std::min(64 - num_buffered_, size_t(src_->num_bits_left()));
+            if(n) {
+                buffer_ |= uint64_t(src_->read(n)) << (64 - num_buffered_ - n);
+                num_buffered_ += n;
+            }
+        } else {
+            while(num_buffered_ < bits && *src_) {
+                buffer_ |= uint64_t(src_->read()) << (63 - num_buffered_);
+                ++num_buffered_;
+            }
+        }
+    }
+
+public:
+    BitLookahead(Src& src) : src_(&src), buffer_(0), num_buffered_(0) {
+    }
+
+    bool read() {
+        if(num_buffered_) {
+            bool const b = buffer_ >> 63;
+            buffer_ <<= 1;
+            --num_buffered_;
+            return b;
+        }
+        return src_->read();
+    }
+
+    uintmax_t read(size_t const bits) {
+        assert(bits <= 64);
+        if(num_buffered_ == 0) return src_->read(bits);
+
+        if(bits <= num_buffered_) {
+            if(bits == 0) [[unlikely]] return 0;
+            auto const x = buffer_ >> (64 - bits);
+            buffer_ <<= bits;
+            num_buffered_ -= bits;
+            return x;
+        } else {
+            // drain the buffer and read the remaining bits from the source
+            auto const rest = bits - num_buffered_;
+            auto const x = buffer_ >> (64 - num_buffered_);
+            buffer_ = 0;
+            num_buffered_ = 0;
+            return (x << rest) | src_->read(rest);
+        }
+    }
+
+    // returns the next bits without consuming them
+    uint64_t peek(size_t const bits) {
+        assert(bits > 0 && bits <= MAX_PEEK);
+        if(num_buffered_ < bits) refill(bits);
+        return buffer_ >> (64 - bits);
+    }
+
+    // consumes bits that have been peeked before
+    void skip(size_t const bits) {
+        assert(bits <= num_buffered_);
+        buffer_ <<= bits;
+        num_buffered_ -= bits;
+    }
+
+    explicit operator bool() const { return num_buffered_ > 0 || bool(*src_); }
+};
+
+// writes n fixed-width values to the sink, packing as many of them as possible into each 64-bit write
+template<iopp::BitSink Sink, std::unsigned_integral T>
+void write_fixed(Sink& sink, T const* values, size_t const n, size_t const bits) {
+    assert(bits > 0 && bits <= 64);
+    auto const per_word = 64 / bits;
+
+    size_t i = 0;
+    if(per_word > 1) {
+        auto const mask = (uint64_t(1) << bits) - 1;
+        for(; i + per_word <= n; i += per_word) {
+            uint64_t w = 0;
+            for(size_t j = 0; j < per_word; j++) w = (w << bits) | (uint64_t(values[i + j]) & mask);
+            sink.write(w, per_word * bits);
+        }
+    }
+    for(; i < n; i++) sink.write(uintmax_t(values[i]), bits);
+}
+
+// reads n fixed-width values written by write_fixed
+template<iopp::BitSource Src, std::unsigned_integral T>
+void read_fixed(Src& src, T* values, size_t const n, size_t const bits) {
+    assert(bits > 0 && bits <= 64);
+    auto const per_word = 64 / bits;
+
+    size_t i = 0;
+    if(per_word > 1) {
+        auto const mask = (uint64_t(1) << bits) - 1;
+        for(; i + per_word <= n; i += per_word) {
+            uint64_t const w = src.read(per_word * bits);
+            for(size_t j = 0; j < per_word; j++) values[i + j] = T((w >> ((per_word - 1 - j) * bits)) & mask);
+        }
+    }
+    for(; i < n; i++) values[i] = T(src.read(bits));
+}
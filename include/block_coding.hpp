@@ -3,15 +3,30 @@
 #include <code.hpp>
 #include <iopp/concepts.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <cmath>
+#include <cstddef>
 #include <cstdint>
+#include <deque>
+#include <iostream>
 #include <memory>
+#include <string>
 #include <vector>
 
+#include <omp.h>
+
+#include "bit_io.hpp"
+#include "bv/elias_fano.hpp"
+#include "context_mixing.hpp"
+#include "debug_output.hpp"
+#include "huffman_decode_table.hpp"
 #include "rans.hpp"
 
 using Token = uintmax_t;
 using TokenType = uint8_t;
+using TokenContext = uint16_t; // the context of a token, e.g., the two preceding input bytes, used by context mixing
 
 static constexpr Token TOKEN_MAX = std::numeric_limits<Token>::max();
 
@@ -20,24 +35,45 @@ enum TokenEncoding {
     BinaryRaw,
     Huffman,
     rANS,
+    rANSInterleaved,
+    EliasGamma,
+    EliasDelta,
+    ContextMixing,
+    Adaptive,
 };
 
-struct TokenParams {
-    TokenEncoding encoding;
-    Token max;
+// the encodings tried for adaptive tokens, indexed by the code written to the block header
+static constexpr TokenEncoding ADAPTIVE_CANDIDATES[] = {
+    TokenEncoding::Binary,
+    TokenEncoding::Huffman,
+    TokenEncoding::rANSInterleaved,
+    TokenEncoding::EliasGamma,
+    TokenEncoding::EliasDelta,
+    TokenEncoding::ContextMixing,
 };
 
-template<iopp::BitSink Sink>
-class BitWriteCounter {
-private:
-    Sink const* sink_;
-    size_t initial_;
-
-public:
-    BitWriteCounter(Sink const& sink) : sink_(&sink), initial_(sink.num_bits_written()) {
+static constexpr size_t NUM_ADAPTIVE_CANDIDATES = std::size(ADAPTIVE_CANDIDATES);
+static constexpr size_t ADAPTIVE_ELIAS_GAMMA = 3;
+static_assert(ADAPTIVE_CANDIDATES[ADAPTIVE_ELIAS_GAMMA] == TokenEncoding::EliasGamma);
+
+inline std::string encoding_name(TokenEncoding const encoding) {
+    switch(encoding) {
+        case TokenEncoding::Binary: return "binary";
+        case TokenEncoding::BinaryRaw: return "binary_raw";
+        case TokenEncoding::Huffman: return "huffman";
+        case TokenEncoding::rANS: return "rans";
+        case TokenEncoding::rANSInterleaved: return "rans_interleaved";
+        case TokenEncoding::EliasGamma: return "gamma";
+        case TokenEncoding::EliasDelta: return "delta";
+        case TokenEncoding::ContextMixing: return "cm";
+        case TokenEncoding::Adaptive: return "adaptive";
     }
+    return "unknown";
+}
 
-    size_t num() const { return sink_->num_bits_written() - initial_; }
+struct TokenParams {
+    TokenEncoding encoding;
+    Token max;
 };
 
 class TokenBuffer {
@@ -48,55 +84,99 @@ public:
         size_t tokens_bits_headers;
         size_t tokens_bits_data;
         size_t tokens_total;
+        size_t blocks[NUM_ADAPTIVE_CANDIDATES]; // for adaptive tokens, the number of blocks using each candidate
 
         Stats() : tokens_bits_headers(0), tokens_bits_data(0), tokens_total(0) {
+            for(auto& x : blocks) x = 0;
+        }
+
+        Stats& operator+=(Stats const& other) {
+            tokens_bits_headers += other.tokens_bits_headers;
+            tokens_bits_data += other.tokens_bits_data;
+            tokens_total += other.tokens_total;
+            for(size_t i = 0; i < NUM_ADAPTIVE_CANDIDATES; i++) blocks[i] += other.blocks[i];
+            return *this;
         }
     };
 private:
+    using HuffmanTree = code::HuffmanTree<Token>;
+    using HuffmanTable = decltype(std::declval<HuffmanTree>().table());
+
+    // the state of the encoding used for the current block
+    struct EncodingState {
+        TokenEncoding encoding;
+        HuffmanTable huff_table;
+        code::Universe universe;
+    };
+
+    // the outcome of a trial encoding of an adaptive candidate
+    // the output is only buffered for candidates that write all tokens along with the header (see writes_tokens_with_header)
+    struct Trial {
+        BitWriter out;
+        Stats stats;
+        bool valid = false;       // whether the output is buffered for the current block
+        size_t num_data_bits = 0; // the number of bits needed to encode the tokens (see data_bits)
+        bool counted = false;     // whether num_data_bits is known for the current block
+    };
+
     // setup
     TokenParams params_;
 
     // encode buffer
     std::vector<Token> tokens_;
+    std::vector<TokenContext> contexts_; // only for tokens that may be coded using context mixing
     code::Range range_;
 
     // encoding phase
-    using HuffmanTree = code::HuffmanTree<Token>;
-    using HuffmanTable = decltype(std::declval<HuffmanTree>().table());
+    EncodingState state_;
+    size_t selected_; // for adaptive tokens, the index of the candidate encoding selected for the current block
+    Trial trials_[NUM_ADAPTIVE_CANDIDATES]; // for adaptive tokens, the trial encodings of the current block that are reused if selected
 
-    HuffmanTree huff_tree_;
-    HuffmanTable huff_table_;
+    std::unique_ptr<ContextMixingEncoder> cm_encoder_; // allocated on first use, because its tables are large
 
-    code::Universe universe_;
+    // decoding phase
+    HuffmanDecodeTable huff_decode_table_;
+    std::unique_ptr<ContextMixingDecoder> cm_decoder_;
     size_t next_;
 
     Stats stats_;
 
-public:
-    TokenBuffer(TokenParams params) : params_(params) {
+    // for rANSInterleaved, tokens are split into a bucket (a byte) coded using rANS, and a number of extra bits coded verbatim
+    // tokens less than 16 have their own bucket, otherwise the bucket is determined by the bit width and the bit following the most significant bit
+    static constexpr Token BUCKET_DIRECT = 16;
+
+    static uint8_t bucket_of(Token const token) {
+        if(token < BUCKET_DIRECT) return uint8_t(token);
+        auto const w = std::bit_width(token);
+        return uint8_t(BUCKET_DIRECT + 2 * (w - 5) + ((token >> (w - 2)) & 1));
     }
 
-    void push_back(Token const token) {
-        if(params_.encoding == TokenEncoding::rANS) {
-            assert(token <= 255);
-        }
+    static size_t bucket_extra_bits(uint8_t const bucket) {
+        return (bucket < BUCKET_DIRECT) ? 0 : (bucket - BUCKET_DIRECT) / 2 + 3;
+    }
 
-        tokens_.push_back(token);
-        range_.contain(token);
+    static Token bucket_base(uint8_t const bucket) {
+        if(bucket < BUCKET_DIRECT) return bucket;
+        return Token(2 | ((bucket - BUCKET_DIRECT) & 1)) << bucket_extra_bits(bucket);
+    }
+
+    // tests whether the given encoding writes all tokens along with the block header
+    static bool writes_tokens_with_header(TokenEncoding const encoding) {
+        return encoding == TokenEncoding::rANS || encoding == TokenEncoding::rANSInterleaved || encoding == TokenEncoding::ContextMixing;
     }
 
+    // writes the block header for the buffered tokens using the encoding set in the given state, and prepares the state for encoding the tokens
+    // nb: rANS encodings write all tokens along with the header
     template<iopp::BitSink Sink>
-    void prepare_encode(Sink& sink, size_t const block_size) {
-        if(params_.encoding == TokenEncoding::Huffman) {
+    void encode_header(Sink& sink, EncodingState& state, size_t const block_size, Stats& stats) {
+        if(state.encoding == TokenEncoding::Huffman) {
             // Huffman codes
             BitWriteCounter w(sink);
-            huff_tree_ = HuffmanTree(tokens_.begin(), tokens_.end());
-            huff_tree_.encode(sink);
-
-            huff_table_ = huff_tree_.table();
-            huff_tree_ = HuffmanTree(); // discard
-            stats_.tokens_bits_headers += w.num();
-        } else if(params_.encoding == TokenEncoding::rANS) {
+            HuffmanTree const huff_tree(tokens_.begin(), tokens_.end());
+            huff_tree.encode(sink);
+            state.huff_table = huff_tree.table();
+            stats.tokens_bits_headers += w.num();
+        } else if(state.encoding == TokenEncoding::rANS) {
             // rANS
             // narrow down tokens
             auto const n = tokens_.size();
@@ -108,87 +188,292 @@ public:
             // encode
             BitWriteCounter w(sink);
             code::Binary::encode(sink, tokens_.size(), code::Universe(block_size));
-            stats_.tokens_bits_headers += w.num();
+            stats.tokens_bits_headers += w.num();
 
             BitWriteCounter wdata(sink);
             rans_encode(sink, data.get(), n);
-            stats_.tokens_bits_data += wdata.num();
-        } else if(params_.encoding == TokenEncoding::BinaryRaw) {
+            stats.tokens_bits_data += wdata.num();
+        } else if(state.encoding == TokenEncoding::rANSInterleaved) {
+            // interleaved rANS on buckets, followed by the extra bits
+            auto const n = tokens_.size();
+            BitWriteCounter w(sink);
+            code::Binary::encode(sink, n, code::Universe(block_size));
+            stats.tokens_bits_headers += w.num();
+
+            if(n > 0) {
+                // tokens are coded relative to the minimum, like for Binary codes
+                BitWriteCounter wmin(sink);
+                auto const min = range_.min();
+                code::EliasDelta::encode(sink, min + 1);
+                stats.tokens_bits_headers += wmin.num();
+
+                auto buckets = std::make_unique<uint8_t[]>(n);
+                for(size_t i = 0; i < n; i++) {
+                    buckets[i] = bucket_of(tokens_[i] - min);
+                }
+
+                BitWriteCounter wdata(sink);
+                rans_encode_interleaved(sink, buckets.get(), n);
+                for(size_t i = 0; i < n; i++) {
+                    auto const bits = bucket_extra_bits(buckets[i]);
+                    if(bits) code::Binary::encode(sink, tokens_[i] - min - bucket_base(buckets[i]), bits);
+                }
+                stats.tokens_bits_data += wdata.num();
+            }
+        } else if(state.encoding == TokenEncoding::ContextMixing) {
+            // bytes coded adaptively in their contexts, written as a whole like for rANS
+            BitWriteCounter wdata(sink);
+            if(tokens_.empty()) {
+                code::EliasDelta::encode(sink, 1);
+            } else {
+                assert(contexts_.size() == tokens_.size());
+                if(cm_encoder_) cm_encoder_->reset();
+                else cm_encoder_ = std::make_unique<ContextMixingEncoder>();
+
+                for(size_t i = 0; i < tokens_.size(); i++) {
+                    assert(tokens_[i] <= 255);
+                    cm_encoder_->encode(uint8_t(tokens_[i]), contexts_[i]);
+                }
+
+                auto const& bytes = cm_encoder_->finish();
+                code::EliasDelta::encode(sink, bytes.size() + 1);
+                write_fixed(sink, bytes.data(), bytes.size(), 8);
+            }
+            stats.tokens_bits_data += wdata.num();
+        } else if(state.encoding == TokenEncoding::BinaryRaw) {
             // Binary codes with no written header
-            universe_ = code::Universe(params_.max);
-        } else {
+            state.universe = code::Universe(params_.max);
+        } else if(state.encoding == TokenEncoding::Binary) {
             BitWriteCounter w(sink);
             // Binary codes with written header
             if(params_.max <= 1) {
                 // a universe of single bits
-                universe_ = code::Universe::binary();
+                state.universe = code::Universe::binary();
             } else {
                 // a larger universe
                 code::Binary::encode(sink, range_.min(), code::Universe(params_.max));
                 code::Binary::encode(sink, range_.max(), code::Universe(range_.min(), params_.max));
-                universe_ = code::Universe(range_);
+                state.universe = code::Universe(range_);
             }
-            stats_.tokens_bits_headers += w.num();
+            stats.tokens_bits_headers += w.num();
+        } else {
+            // Elias codes need no header
+            assert(state.encoding == TokenEncoding::EliasGamma || state.encoding == TokenEncoding::EliasDelta);
         }
-        next_ = 0;
     }
 
     template<iopp::BitSink Sink>
-    void encode_next(Sink& sink) {
-        assert(next_ < tokens_.size());
-
-        auto const token = tokens_[next_++];
-        if(params_.encoding == TokenEncoding::Huffman) {
-            BitWriteCounter w(sink);
-            code::Huffman::encode(sink, token, huff_table_);
-            stats_.tokens_bits_data += w.num();
-        } else if(params_.encoding == TokenEncoding::rANS) {
+    void encode_token(Sink& sink, EncodingState const& state, Token const token) const {
+        if(state.encoding == TokenEncoding::Huffman) {
+            code::Huffman::encode(sink, token, state.huff_table);
+        } else if(state.encoding == TokenEncoding::rANS || state.encoding == TokenEncoding::rANSInterleaved || state.encoding == TokenEncoding::ContextMixing) {
             // nothing to do
+        } else if(state.encoding == TokenEncoding::EliasGamma) {
+            assert(token < TOKEN_MAX);
+            code::EliasGamma::encode(sink, token + 1);
+        } else if(state.encoding == TokenEncoding::EliasDelta) {
+            assert(token < TOKEN_MAX);
+            code::EliasDelta::encode(sink, token + 1);
+        } else {
+            code::Binary::encode(sink, token, state.universe);
+        }
+    }
+
+    // computes the number of bits needed to encode the buffered tokens using the given state, whose header has been written
+    // nb: this is done per block, so the encoding of each single token need not be measured
+    size_t data_bits(EncodingState const& state) const {
+        size_t bits = 0;
+        if(state.encoding == TokenEncoding::Huffman) {
+            BitCounter counter;
+            for(auto const token : tokens_) code::Huffman::encode(counter, token, state.huff_table);
+            bits = counter.num_bits_written();
+        } else if(state.encoding == TokenEncoding::rANS || state.encoding == TokenEncoding::rANSInterleaved || state.encoding == TokenEncoding::ContextMixing) {
+            // written along with the header
+        } else if(state.encoding == TokenEncoding::EliasGamma) {
+            for(auto const token : tokens_) {
+                size_t const n = std::bit_width(token + 1) - 1;
+                bits += 2 * n + 1;
+            }
+        } else if(state.encoding == TokenEncoding::EliasDelta) {
+            for(auto const token : tokens_) {
+                size_t const n = std::bit_width(token + 1) - 1;
+                size_t const l = std::bit_width(n + 1) - 1;
+                bits += n + 2 * l + 1;
+            }
+        } else if(!tokens_.empty()) {
+            // Binary codes have a fixed length
+            BitCounter counter;
+            code::Binary::encode(counter, tokens_.front(), state.universe);
+            bits = tokens_.size() * counter.num_bits_written();
+        }
+        return bits;
+    }
+
+public:
+    TokenBuffer(TokenParams params) : params_(params), selected_(0), next_(0) {
+        state_.encoding = params.encoding;
+    }
+
+    // tests whether the tokens may be coded using context mixing, i.e., whether they are bytes
+    bool allows_context_mixing() const {
+        return params_.encoding == TokenEncoding::ContextMixing || (params_.encoding == TokenEncoding::Adaptive && params_.max <= 255);
+    }
+
+    void push_back(Token const token, TokenContext const ctx = 0) {
+        if(params_.encoding == TokenEncoding::rANS || params_.encoding == TokenEncoding::ContextMixing) {
+            assert(token <= 255);
+        }
+
+        tokens_.push_back(token);
+        range_.contain(token);
+        if(allows_context_mixing()) contexts_.push_back(ctx);
+    }
+
+    // for adaptive tokens, computes the exact number of bits needed to encode the buffered tokens using the given candidate encoding
+    // candidates that write all tokens along with the header (e.g., rANS) are encoded into a buffer, which prepare_encode reuses if the candidate gets selected,
+    // the others are only counted
+    // nb: this only modifies the trial of the given candidate (and the context mixing encoder for that candidate), so it can be called concurrently for different candidates
+    size_t try_candidate(size_t const candidate, size_t const block_size) {
+        assert(candidate < NUM_ADAPTIVE_CANDIDATES);
+        auto const encoding = ADAPTIVE_CANDIDATES[candidate];
+        if(encoding == TokenEncoding::ContextMixing && !allows_context_mixing()) return SIZE_MAX;
+
+        EncodingState state;
+        state.encoding = encoding;
+        auto& trial = trials_[candidate];
+        if(writes_tokens_with_header(encoding)) {
+            trial.out.clear();
+            trial.stats = Stats();
+            encode_header(trial.out, state, block_size, trial.stats);
+            trial.valid = true;
+            trial.num_data_bits = 0;
+            trial.counted = true;
+            return trial.out.num_bits_written();
         } else {
+            BitCounter sink;
+            Stats stats;
+            encode_header(sink, state, block_size, stats);
+            trial.num_data_bits = data_bits(state);
+            trial.counted = true;
+            return sink.num_bits_written() + trial.num_data_bits;
+        }
+    }
+
+    // for adaptive tokens, selects the candidate encoding to use for the current block
+    void select(size_t const candidate) {
+        assert(candidate < NUM_ADAPTIVE_CANDIDATES);
+        selected_ = candidate;
+    }
+
+    template<iopp::BitSink Sink>
+    void prepare_encode(Sink& sink, size_t const block_size) {
+        if(params_.encoding == TokenEncoding::Adaptive) {
+            // signal the selected encoding
             BitWriteCounter w(sink);
-            code::Binary::encode(sink, token, universe_);
-            stats_.tokens_bits_data += w.num();
+            code::Binary::encode(sink, selected_, code::Universe(NUM_ADAPTIVE_CANDIDATES - 1));
+            stats_.tokens_bits_headers += w.num();
+            ++stats_.blocks[selected_];
+            state_.encoding = ADAPTIVE_CANDIDATES[selected_];
+        } else {
+            state_.encoding = params_.encoding;
+        }
+
+        if(params_.encoding == TokenEncoding::Adaptive && trials_[selected_].valid) {
+            // reuse the trial encoding
+            auto const& trial = trials_[selected_];
+            trial.out.append_to(sink);
+            stats_ += trial.stats;
+        } else {
+            encode_header(sink, state_, block_size, stats_);
         }
-        ++stats_.tokens_total;
+
+        if constexpr(gather_stats) {
+            // nb: the tokens have already been counted if the encoding was selected by trial
+            bool const counted = params_.encoding == TokenEncoding::Adaptive && trials_[selected_].counted;
+            stats_.tokens_bits_data += counted ? trials_[selected_].num_data_bits : data_bits(state_);
+            stats_.tokens_total += tokens_.size();
+        }
+        next_ = 0;
+    }
+
+    template<iopp::BitSink Sink>
+    void encode_next(Sink& sink) {
+        assert(next_ < tokens_.size());
+        encode_token(sink, state_, tokens_[next_++]);
     }
 
     template<iopp::BitSource Src>
     void prepare_decode(Src& src, size_t const block_size) {
-        if(params_.encoding == TokenEncoding::Huffman) {
+        if(params_.encoding == TokenEncoding::Adaptive) {
+            state_.encoding = ADAPTIVE_CANDIDATES[code::Binary::decode(src, code::Universe(NUM_ADAPTIVE_CANDIDATES - 1))];
+        } else {
+            state_.encoding = params_.encoding;
+        }
+
+        if(state_.encoding == TokenEncoding::Huffman) {
             // Huffman codes
-            huff_tree_ = HuffmanTree(src);
-        } else if(params_.encoding == TokenEncoding::rANS) {
+            HuffmanTree const huff_tree(src);
+            huff_decode_table_ = HuffmanDecodeTable(huff_tree);
+        } else if(state_.encoding == TokenEncoding::rANS) {
             // rANS
             auto const n = code::Binary::decode(src, code::Universe(block_size));
             tokens_.clear();
             rans_decode(src, n, std::back_inserter(tokens_));
             assert(tokens_.size() == n);
             next_ = 0;
-        } else if(params_.encoding == TokenEncoding::BinaryRaw) {
+        } else if(state_.encoding == TokenEncoding::rANSInterleaved) {
+            // interleaved rANS on buckets, followed by the extra bits
+            auto const n = code::Binary::decode(src, code::Universe(block_size));
+            tokens_.resize(n);
+            if(n > 0) {
+                auto const min = code::EliasDelta::decode(src) - 1;
+                auto buckets = std::make_unique<uint8_t[]>(n);
+                rans_decode_interleaved(src, n, buckets.get());
+                for(size_t i = 0; i < n; i++) {
+                    auto const bits = bucket_extra_bits(buckets[i]);
+                    tokens_[i] = min + bucket_base(buckets[i]) + (bits ? code::Binary::decode(src, bits) : 0);
+                }
+            }
+            next_ = 0;
+        } else if(state_.encoding == TokenEncoding::ContextMixing) {
+            // bytes coded adaptively in their contexts, decoded one by one
+            std::vector<uint8_t> bytes(code::EliasDelta::decode(src) - 1);
+            read_fixed(src, bytes.data(), bytes.size(), 8);
+
+            if(!cm_decoder_) cm_decoder_ = std::make_unique<ContextMixingDecoder>();
+            cm_decoder_->reset(std::move(bytes));
+        } else if(state_.encoding == TokenEncoding::BinaryRaw) {
             // Binary codes with no written header
-            universe_ = code::Universe(params_.max);
-        } else {
+            state_.universe = code::Universe(params_.max);
+        } else if(state_.encoding == TokenEncoding::Binary) {
             // Binary codes
             if(params_.max <= 1) {
                 // a universe of single bits
-                universe_ = code::Universe::binary();
+                state_.universe = code::Universe::binary();
             } else {
                 // a universe defined by min and max
                 auto const min = code::Binary::decode(src, code::Universe(params_.max));
                 auto const max = code::Binary::decode(src, code::Universe(min, params_.max));
-                universe_ = code::Universe(min, max);
+                state_.universe = code::Universe(min, max);
             }
         }
     }
 
+    // decodes the next token, the context must be the same as given when encoding it
     template<iopp::BitSource Src>
-    uintmax_t decode_next(Src& src) {
-        if(params_.encoding == TokenEncoding::Huffman) {
-            return code::Huffman::decode(src, huff_tree_.root());
-        } else if(params_.encoding == TokenEncoding::rANS) {
+    uintmax_t decode_next(Src& src, TokenContext const ctx = 0) {
+        if(state_.encoding == TokenEncoding::Huffman) {
+            return huff_decode_table_.decode(src);
+        } else if(state_.encoding == TokenEncoding::ContextMixing) {
+            return cm_decoder_->decode(ctx);
+        } else if(state_.encoding == TokenEncoding::rANS || state_.encoding == TokenEncoding::rANSInterleaved) {
             return tokens_[next_++];
+        } else if(state_.encoding == TokenEncoding::EliasGamma) {
+            return code::EliasGamma::decode(src) - 1;
+        } else if(state_.encoding == TokenEncoding::EliasDelta) {
+            return code::EliasDelta::decode(src) - 1;
         } else {
-            return code::Binary::decode(src, universe_);
+            return code::Binary::decode(src, state_.universe);
         }
     }
 
@@ -196,9 +481,18 @@ public:
         return params_;
     }
 
+    size_t size() const {
+        return tokens_.size();
+    }
+
     void clear() { 
         tokens_.clear();
+        contexts_.clear();
         range_ = code::Range();
+        for(auto& trial : trials_) {
+            trial.valid = false;
+            trial.counted = false;
+        }
     }
 
     void print_stats() {
@@ -224,7 +518,7 @@ public:
             }
             double const var = qdsum / (n - 1.0);
             double const stddev = sqrt(var);
-            std::cout << "\t\tn=" << n << ", min=" << min << ", max=" << max << ", avg=" << avg << ", stddev=" << stddev << std::endl;
+            *DebugOutput::stream << "\t\tn=" << n << ", min=" << min << ", max=" << max << ", avg=" << avg << ", stddev=" << stddev << std::endl;
         }
 
         if(params_.encoding == TokenEncoding::Huffman) {
@@ -237,19 +531,26 @@ public:
             }
 
             for(size_t c = 0; c < 256; c++) {
-                if(hist[c]) std::cout << "\t\t0x" << std::hex << c << std::dec << " -> " << hist[c] << std::endl;
+                if(hist[c]) *DebugOutput::stream << "\t\t0x" << std::hex << c << std::dec << " -> " << hist[c] << std::endl;
             }
 
-            std::cout << "\t\ttokens:" << std::endl;
+            *DebugOutput::stream << "\t\ttokens:" << std::endl;
             for(auto c : tokens_) {
-                std::cout << c << ",";
+                *DebugOutput::stream << c << ",";
             }
-            std::cout << std::endl;
+            *DebugOutput::stream << std::endl;
         }
         #endif
     }
 
     auto const& stats() const { return stats_; }
+
+    // returns the stats gathered so far and resets them
+    Stats take_stats() {
+        Stats s = stats_;
+        stats_ = Stats();
+        return s;
+    }
 };
 
 class BlockEncodingBase {
@@ -262,6 +563,8 @@ protected:
 
     TokenBuffer& tokens(TokenType const type) { return tokens_[type]; }
 
+    std::vector<TokenBuffer>& token_buffers() { return tokens_; }
+
     size_t num_types() const { return tokens_.size(); }
 
 public:
@@ -288,77 +591,293 @@ public:
         register_token(params);
     }
 
+    void register_rans_interleaved() {
+        TokenParams params;
+        params.encoding = TokenEncoding::rANSInterleaved;
+        register_token(params);
+    }
+
+    // registers a byte token type coded adaptively in the contexts given along with the tokens
+    void register_context_mixing() {
+        TokenParams params;
+        params.encoding = TokenEncoding::ContextMixing;
+        params.max = 255;
+        register_token(params);
+    }
+
+    // registers a token type whose encoding is selected for each block individually
+    // the given maximum is used for Binary codes
+    void register_adaptive(Token const max = TOKEN_MAX) {
+        TokenParams params;
+        params.encoding = TokenEncoding::Adaptive;
+        params.max = max;
+        register_token(params);
+    }
+
     void set_max(TokenType const type, Token const max) {
         tokens_[type].params().max = max;
     }
 };
 
+// pads the given bit sink with zeros up to the next byte boundary
+template<iopp::BitSink Sink>
+void pad_to_byte(Sink& sink) {
+    auto const r = sink.num_bits_written() % 8;
+    if(r) sink.write(0, 8 - r);
+}
+
+// pads the given bit sink with zeros up to the next byte boundary, preceded by the number of padding bits (3 bits)
+// this way, a decoder can skip the padding without knowing its position in the stream
+template<iopp::BitSink Sink>
+void pad_to_byte_counted(Sink& sink) {
+    auto const pad = (8 - (sink.num_bits_written() + 3) % 8) % 8;
+    sink.write(pad, 3);
+    if(pad) sink.write(0, pad);
+}
+
+// skips the padding written by pad_to_byte_counted
+template<iopp::BitSource Src>
+void skip_padding_counted(Src& src) {
+    auto const pad = src.read(3);
+    if(pad) src.read(pad);
+}
+
+// marks the end of the block index of a byte-aligned block stream
+static constexpr uint64_t BLOCK_INDEX_MAGIC =
+    ((uint64_t)'B') << 56 |
+    ((uint64_t)'L') << 48 |
+    ((uint64_t)'K') << 40 |
+    ((uint64_t)'I') << 32 |
+    ((uint64_t)'N') << 24 |
+    ((uint64_t)'D') << 16 |
+    ((uint64_t)'E') << 8 |
+    ((uint64_t)'X');
+
+// in byte-aligned mode, each block is padded to a byte boundary (see pad_to_byte_counted) and preceded by a bit telling that a block follows
+// after the last block, a zero bit is written, followed by the block index, which contains the byte offsets of all blocks (relative to the first)
+// and which is terminated by its own size in bytes (64 bits) and BLOCK_INDEX_MAGIC, such that it can be located from the end of the stream
 template<iopp::BitSink Sink>
 class BlockEncoder : public BlockEncodingBase {
 private:
+    // a full block of tokens handed off to be encoded concurrently
+    struct PendingBlock {
+        std::vector<TokenBuffer> tokens;
+        std::vector<TokenType> token_types;
+        size_t num_tokens;
+        BitWriter out;
+        std::atomic<bool> done;
+    };
+
     Sink* sink_;
     size_t max_block_size_;
 
     std::vector<TokenType> token_types_;
 
     size_t cur_tokens_;
+    bool aligned_;
     bool print_stats_;
 
-    void overflow() {
+    size_t data_begin_; // in byte-aligned mode, the bit position of the first block in the sink
+    std::vector<uint64_t> block_offsets_;
+    size_t index_bytes_;
+
+    std::deque<std::unique_ptr<PendingBlock>> pending_; // in the order of the blocks
+    std::vector<std::vector<TokenBuffer>> spare_tokens_; // the token buffers of written pending blocks, which are reused (e.g., for their context mixing encoder)
+    BitWriter block_out_;
+    std::vector<TokenBuffer::Stats> stats_;
+
+    // the minimum block size for which trial encodings of adaptive token types are done in parallel
+    static constexpr size_t MIN_PARALLEL_TRIALS = 4096;
+
+    // the maximum number of pending blocks per thread before the encoder waits for them
+    static constexpr size_t MAX_PENDING_PER_THREAD = 2;
+
+    // for each adaptive token type, selects the candidate encoding that needs the fewest bits for the given block
+    // nb: the trial encodings are independent, so they are done in parallel for sufficiently large blocks
+    static void select_encodings(std::vector<TokenBuffer>& tokens, size_t const num_tokens) {
+        std::vector<TokenType> adaptive;
+        for(size_t j = 0; j < tokens.size(); j++) {
+            if(tokens[j].params().encoding == TokenEncoding::Adaptive) {
+                if(tokens[j].size() > 0) {
+                    adaptive.push_back(j);
+                } else {
+                    // nothing to encode, select a candidate without a header
+                    tokens[j].select(ADAPTIVE_ELIAS_GAMMA);
+                }
+            }
+        }
+        if(adaptive.empty()) return;
+
+        auto const num_trials = adaptive.size() * NUM_ADAPTIVE_CANDIDATES;
+        std::vector<size_t> costs(num_trials);
+
+        #pragma omp parallel for schedule(dynamic, 1) if(num_tokens >= MIN_PARALLEL_TRIALS)
+        for(size_t t = 0; t < num_trials; t++) {
+            costs[t] = tokens[adaptive[t / NUM_ADAPTIVE_CANDIDATES]].try_candidate(t % NUM_ADAPTIVE_CANDIDATES, num_tokens);
+        }
+
+        for(size_t i = 0; i < adaptive.size(); i++) {
+            auto const first = costs.begin() + i * NUM_ADAPTIVE_CANDIDATES;
+            tokens[adaptive[i]].select(std::min_element(first, first + NUM_ADAPTIVE_CANDIDATES) - first);
+        }
+    }
+
+    // encodes a block of tokens along with its header
+    template<iopp::BitSink BlockSink>
+    void encode_block(BlockSink& sink, std::vector<TokenBuffer>& tokens, std::vector<TokenType> const& token_types, size_t const num_tokens) const {
         // write block header
-        assert(cur_tokens_ > 0);
-        assert(cur_tokens_ <= max_block_size_);
+        assert(num_tokens > 0);
+        assert(num_tokens <= max_block_size_);
 
-        bool const small_block = cur_tokens_ < max_block_size_;
-        sink_->write(small_block);
-        if(small_block) code::Binary::encode(*sink_, cur_tokens_ - 1, code::Universe(max_block_size_));
+        bool const small_block = num_tokens < max_block_size_;
+        sink.write(small_block);
+        if(small_block) code::Binary::encode(sink, num_tokens - 1, code::Universe(max_block_size_));
 
         // print block stats
         #ifndef NDEBUG
         if(print_stats_) {
-            std::cout << "BLOCK STATS" << std::endl;
-            for(size_t j = 0; j < num_types(); j++) {
-                std::cout << "\ttoken type " << j << ":" << std::endl;
-                tokens(j).print_stats();
+            *DebugOutput::stream << "BLOCK STATS" << std::endl;
+            for(size_t j = 0; j < tokens.size(); j++) {
+                *DebugOutput::stream << "\ttoken type " << j << ":" << std::endl;
+                tokens[j].print_stats();
             }
-            std::cout << std::endl;
+            *DebugOutput::stream << std::endl;
         }
         #endif
 
-        for(size_t j = 0; j < num_types(); j++) {
-            tokens(j).prepare_encode(*sink_, cur_tokens_);
+        select_encodings(tokens, num_tokens);
+        for(auto& t : tokens) {
+            t.prepare_encode(sink, num_tokens);
         }
 
         // write tokens
-        for(auto j : token_types_) {
-            tokens(j).encode_next(*sink_);
+        for(auto j : token_types) {
+            tokens[j].encode_next(sink);
+        }
+    }
+
+    void collect_stats(std::vector<TokenBuffer>& tokens) {
+        stats_.resize(tokens.size());
+        for(size_t j = 0; j < tokens.size(); j++) {
+            stats_[j] += tokens[j].take_stats();
+        }
+    }
+
+    // in byte-aligned mode, pads the sink to a byte boundary and records the offset of the block about to be written
+    void begin_block(bool const more = true) {
+        if(aligned_) {
+            pad_to_byte_counted(*sink_);
+            if(block_offsets_.empty()) data_begin_ = sink_->num_bits_written();
+            block_offsets_.push_back((sink_->num_bits_written() - data_begin_) / 8);
+            sink_->write(more);
+        }
+    }
+
+    // writes the encoded pending blocks to the sink, in order
+    // stops at the first block that is not yet encoded
+    void write_pending() {
+        while(!pending_.empty() && pending_.front()->done.load(std::memory_order_acquire)) {
+            auto& b = *pending_.front();
+            begin_block();
+            b.out.append_to(*sink_);
+            collect_stats(b.tokens);
+            for(auto& t : b.tokens) t.clear();
+            spare_tokens_.push_back(std::move(b.tokens));
+            pending_.pop_front();
         }
+    }
+
+    void overflow() {
+        // within a parallel region of multiple threads, the block is entropy coded by an OpenMP task into a buffer of its own
+        // thus, the thread producing tokens (e.g., a parser) is not held up by entropy coding
+        // nb: outside of such a region, blocks are encoded right away
+        if(omp_in_parallel() && omp_get_num_threads() > 1) {
+            auto b = std::make_unique<PendingBlock>();
+            if(!spare_tokens_.empty()) {
+                b->tokens = std::move(spare_tokens_.back());
+                spare_tokens_.pop_back();
+                for(size_t j = 0; j < num_types(); j++) {
+                    b->tokens[j].params() = tokens(j).params();
+                }
+            } else {
+                b->tokens.reserve(num_types());
+                for(size_t j = 0; j < num_types(); j++) {
+                    b->tokens.emplace_back(tokens(j).params());
+                }
+            }
+            std::swap(b->tokens, token_buffers());
+            std::swap(b->token_types, token_types_);
+            token_types_.reserve(max_block_size_);
+            b->num_tokens = cur_tokens_;
+            b->done = false;
+
+            auto* block = b.get();
+            pending_.push_back(std::move(b));
+
+            #pragma omp task firstprivate(block)
+            {
+                encode_block(block->out, block->tokens, block->token_types, block->num_tokens);
+                block->done.store(true, std::memory_order_release);
+            }
 
-        // 
-        for(size_t j = 0; j < num_types(); j++) {
-            tokens(j).clear();
+            if(pending_.size() > MAX_PENDING_PER_THREAD * omp_get_num_threads()) {
+                // too many blocks are pending, wait for them
+                #pragma omp taskwait
+            }
+            write_pending();
+        } else {
+            // pending blocks (if any) must be written first
+            #pragma omp taskwait
+            write_pending();
+            assert(pending_.empty());
+
+            // nb: the block is encoded into a buffer first, which is then appended to the sink word by word
+            block_out_.clear();
+            encode_block(block_out_, token_buffers(), token_types_, cur_tokens_);
+            begin_block();
+            block_out_.append_to(*sink_);
+            collect_stats(token_buffers());
+            for(size_t j = 0; j < num_types(); j++) {
+                tokens(j).clear();
+            }
+            token_types_.clear();
         }
-        token_types_.clear();
         cur_tokens_ = 0;
     }
 
 public:
-    BlockEncoder(Sink& sink, size_t const max_block_size, bool print_stats = false)
+    // tag for constructing an encoder that writes blocks only, without the header of a block stream
+    // such blocks can be appended to the stream of another encoder with the same maximum block size (see append_blocks)
+    struct BlocksOnly {};
+
+    BlockEncoder(Sink& sink, size_t const max_block_size, BlocksOnly)
         : BlockEncodingBase(),
           sink_(&sink),
           max_block_size_(max_block_size),
           cur_tokens_(0),
-          print_stats_(print_stats) {
-    
+          aligned_(false),
+          print_stats_(false),
+          data_begin_(0),
+          index_bytes_(0) {
+
         token_types_.reserve(max_block_size_);
+    }
+
+    BlockEncoder(Sink& sink, size_t const max_block_size, bool const aligned = false, bool print_stats = false)
+        : BlockEncoder(sink, max_block_size, BlocksOnly{}) {
+
+        aligned_ = aligned;
+        print_stats_ = print_stats;
 
         // header
         code::Binary::encode(sink, max_block_size_, code::Universe::of<uint32_t>());
+        sink.write(aligned_);
     }
 
-    void write_uint(TokenType const type, Token const token) {
+    // writes a token, the context is used only if the token is coded using context mixing
+    void write_uint(TokenType const type, Token const token, TokenContext const ctx = 0) {
         token_types_.push_back(type);
-        tokens(type).push_back(token);
+        tokens(type).push_back(token, ctx);
 
         ++cur_tokens_;
         if(cur_tokens_ >= max_block_size_) {
@@ -367,21 +886,64 @@ public:
         }
     }
 
-    void write_char(TokenType const type, char const c) {
-        write_uint(type, Token((uint8_t)c));
+    void write_char(TokenType const type, char const c, TokenContext const ctx = 0) {
+        write_uint(type, Token((uint8_t)c), ctx);
     }
 
+    // encodes the current block and writes all pending blocks to the sink
+    // nb: if blocks were handed off to tasks, this must be called by the thread that created them
+    // nb: in byte-aligned mode, this ends the stream by writing the block index, so no more tokens may be written afterwards
     void flush() {
         if(cur_tokens_ > 0) overflow();
+
+        #pragma omp taskwait
+        write_pending();
+        assert(pending_.empty());
+
+        if(aligned_) {
+            // the offset of the end marker is also the end of the last block
+            begin_block(false);
+            pad_to_byte(*sink_);
+
+            auto const index_begin = sink_->num_bits_written();
+            code::Binary::encode(*sink_, max_block_size_, code::Universe::of<uint32_t>());
+            EliasFano(block_offsets_.data(), block_offsets_.size()).encode(*sink_);
+            pad_to_byte(*sink_);
+
+            index_bytes_ = (sink_->num_bits_written() - index_begin) / 8;
+            sink_->write(index_bytes_, 64);
+            sink_->write(BLOCK_INDEX_MAGIC, 64);
+        }
+    }
+
+    // appends the blocks written by an encoder constructed with BlocksOnly, which must have been flushed
+    // the current block is ended first, such that the appended blocks follow all tokens written so far
+    // nb: not supported in byte-aligned mode, because the appended blocks are not indexed
+    void append_blocks(BitWriter const& blocks) {
+        assert(!aligned_);
+        if(cur_tokens_ > 0) overflow();
+
+        #pragma omp taskwait
+        write_pending();
+        assert(pending_.empty());
+
+        blocks.append_to(*sink_);
     }
 
     void gather_stats(pm::Result& r) {
+        stats_.resize(num_types());
+
         TokenBuffer::Stats total;
         for(size_t i = 0; i < num_types(); i++) {
-            auto const& stats = tokens(i).stats();
+            auto const& stats = stats_[i];
             r.add("tokens_" + std::to_string(i) + "_total", stats.tokens_total);
             r.add("tokens_" + std::to_string(i) + "_bits_headers", stats.tokens_bits_headers);
             r.add("tokens_" + std::to_string(i) + "_bits_data", stats.tokens_bits_data);
+            if(tokens(i).params().encoding == TokenEncoding::Adaptive) {
+                for(size_t c = 0; c < NUM_ADAPTIVE_CANDIDATES; c++) {
+                    r.add("tokens_" + std::to_string(i) + "_blocks_" + encoding_name(ADAPTIVE_CANDIDATES[c]), stats.blocks[c]);
+                }
+            }
 
             total.tokens_total += stats.tokens_total;
             total.tokens_bits_headers += stats.tokens_bits_headers;
@@ -391,26 +953,38 @@ public:
         r.add("tokens_total", total.tokens_total);
         r.add("tokens_bits_headers", total.tokens_bits_headers);
         r.add("tokens_bits_data", total.tokens_bits_data);
+        if(aligned_) r.add("block_index_bytes", index_bytes_);
     }
 };
 
 template<iopp::BitSource Src>
 class BlockDecoder : public BlockEncodingBase {
 private:
-    Src* src_;
+    // the bit source is wrapped so that Huffman codes can be decoded by peeking
+    using Source = BitLookahead<Src>;
+
+    Source src_;
     size_t max_block_size_;
+    bool aligned_;
+    bool more_; // in byte-aligned mode, whether another block follows
     
     size_t cur_block_size_;
     size_t next_token_;
 
+    // in byte-aligned mode, skips the padding after a block and tests whether another block follows
+    void end_block() {
+        skip_padding_counted(src_);
+        more_ = src_.read();
+    }
+
     void underflow() {
-        if(*src_) {
-            bool const small_block = src_->read();
-            cur_block_size_ = small_block ? (code::Binary::decode(*src_, code::Universe(max_block_size_)) + 1) : max_block_size_;
+        if(aligned_ ? more_ : bool(src_)) {
+            bool const small_block = src_.read();
+            cur_block_size_ = small_block ? (code::Binary::decode(src_, code::Universe(max_block_size_)) + 1) : max_block_size_;
 
             for(size_t j = 0; j < num_types(); j++) {
                 tokens(j).clear();
-                tokens(j).prepare_decode(*src_, cur_block_size_);
+                tokens(j).prepare_decode(src_, cur_block_size_);
             }
         } else {
             cur_block_size_ = 0;
@@ -421,24 +995,136 @@ private:
 public:
     BlockDecoder(Src& src)
         : BlockEncodingBase(),
-          src_(&src),
+          src_(src),
+          more_(false),
           cur_block_size_(0),
           next_token_(0) {
 
         // header
-        max_block_size_ = code::Binary::decode(src, code::Universe::of<uint32_t>());
+        max_block_size_ = code::Binary::decode(src_, code::Universe::of<uint32_t>());
+        aligned_ = src_.read();
+        if(aligned_) end_block();
     }
 
-    uintmax_t read_uint(TokenType const type) {
+    // reads a token, the context must be the same as given when writing it
+    uintmax_t read_uint(TokenType const type, TokenContext const ctx = 0) {
         if(next_token_ >= cur_block_size_) {
             underflow();
         }
 
         ++next_token_;
-        return tokens(type).decode_next(*src_);
+        auto const x = tokens(type).decode_next(src_, ctx);
+        if(aligned_ && next_token_ == cur_block_size_) end_block();
+        return x;
+    }
+
+    char read_char(TokenType const type, TokenContext const ctx = 0) {
+        return (char)read_uint(type, ctx);
+    }
+
+    // tests whether there are more tokens to read
+    // nb: testing the source alone does not suffice, because some encodings (rANS) consume the whole block in advance
+    // and because a byte-aligned stream is followed by its block index
+    explicit operator bool() const {
+        return next_token_ < cur_block_size_ || (aligned_ ? more_ : bool(src_));
+    }
+};
+
+// the block index at the end of a byte-aligned block stream (see BlockEncoder)
+// it allows for locating blocks and counting their tokens without decoding any token data
+// nb: this reads the stream's bytes directly, assuming that the bit sink wrote them in order, most significant bit first
+class BlockIndex {
+private:
+    // the maximum number of bytes that the bit sink may have appended after the block index
+    static constexpr size_t MAX_TRAILING_BYTES = 64;
+
+    // reads bits directly from a byte range
+    class ByteSource {
+    private:
+        char const* begin_;
+        char const* end_;
+        size_t pos_;
+
+    public:
+        ByteSource(char const* begin, char const* end) : begin_(begin), end_(end), pos_(0) {
+        }
+
+        bool read() {
+            assert(bool(*this));
+            auto const p = pos_++;
+            return (uint8_t(begin_[p / 8]) >> (7 - p % 8)) & 1;
+        }
+
+        uintmax_t read(size_t const bits) {
+            uintmax_t x = 0;
+            for(size_t i = 0; i < bits; i++) x = (x << 1) | uintmax_t(read());
+            return x;
+        }
+
+        operator bool() const { return pos_ < 8 * size_t(end_ - begin_); }
+    };
+
+    static uint64_t read_u64(char const* p) {
+        ByteSource src(p, p + 8);
+        return src.read(64);
+    }
+
+    char const* data_begin_;
+    char const* end_;
+    size_t max_block_size_;
+    EliasFano offsets_; // the byte offset of each block relative to the first, followed by that of the end marker
+
+public:
+    // reads the index of the byte-aligned block stream that ends at the given position
+    BlockIndex(char const* begin, char const* end) {
+        // find the magic
+        char const* trailer = nullptr;
+        for(size_t i = 0; i <= MAX_TRAILING_BYTES && end - begin >= ptrdiff_t(16 + i); i++) {
+            if(read_u64(end - i - 8) == BLOCK_INDEX_MAGIC) {
+                trailer = end - i - 16;
+                break;
+            }
+        }
+        if(!trailer) {
+            std::cerr << "no block index found (see --align-blocks)" << std::endl;
+            std::abort();
+        }
+
+        auto const index_bytes = read_u64(trailer);
+        if(uint64_t(trailer - begin) < index_bytes + 1) {
+            std::cerr << "truncated block index" << std::endl;
+            std::abort();
+        }
+
+        auto const index_begin = trailer - index_bytes;
+        ByteSource in(index_begin, trailer);
+        max_block_size_ = code::Binary::decode(in, code::Universe::of<uint32_t>());
+        offsets_.decode(in);
+
+        // the index immediately follows the byte containing the end marker
+        auto const end_marker = offsets_.size() > 0 ? offsets_[offsets_.size() - 1] : UINTMAX_MAX;
+        if(end_marker >= uint64_t(index_begin - begin)) {
+            std::cerr << "invalid block index" << std::endl;
+            std::abort();
+        }
+        data_begin_ = index_begin - 1 - end_marker;
+        end_ = index_begin;
     }
 
-    char read_char(TokenType const type) {
-        return (char)read_uint(type);
+    size_t num_blocks() const { return offsets_.size() - 1; }
+    size_t max_block_size() const { return max_block_size_; }
+
+    // the position of the i-th block, from which it can be decoded
+    char const* block_begin(size_t const i) const { return data_begin_ + offsets_[i]; }
+
+    // the size of the i-th block in bytes
+    size_t block_bytes(size_t const i) const { return offsets_[i+1] - offsets_[i]; }
+
+    // reads the number of tokens in the i-th block from its header
+    size_t num_tokens(size_t const i) const {
+        ByteSource in(block_begin(i), end_);
+        in.read(); // the bit telling that a block follows
+        bool const small_block = in.read();
+        return small_block ? (code::Binary::decode(in, code::Universe(max_block_size_)) + 1) : max_block_size_;
     }
 };
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <bit>
+#include <cassert>
+#include <concepts>
+#include <limits>
+#include <memory>
+
+#include "../idiv_ceil.hpp"
+
+/// \brief A space efficient data structure for answering select queries on a bit vector.
+///
+/// A select query finds the position of the j-th set or unset bit, respectively.
+/// The data structure samples the block (of 64 bits) containing every <tt>2^t_sample_bit_width</tt>-th such bit along with the number of such bits before that block.
+/// A query starts at the preceding sample and scans blocks using \c popcnt instructions, then selects within the final block.
+/// The default sampling rate of 512 keeps the overhead at about a quarter bit per sampled bit, while the scans remain short on dense bit vectors.
+///
+/// Note that this data structure is \em static.
+/// It maintains a pointer to the underlying bit vector and will become invalid if that bit vector is changed after construction.
+///
+/// \tparam bit_ whether to select set (1) or unset (0) bits
+/// \tparam sample_bit_width_ the logarithm of the sampling rate
+template<bool bit_, std::unsigned_integral Pack = uint64_t, uint64_t sample_bit_width_ = 9>
+class BitSelect {
+private:
+    static constexpr size_t SAMPLE_RATE = 1ULL << sample_bit_width_;
+    static constexpr size_t BLOCK_SZ = 8 * sizeof(Pack);
+
+    struct Sample {
+        size_t block; // the block containing the sampled bit
+        size_t rank;  // the number of selected bits before that block
+    };
+
+    Pack const* bits_;
+    size_t n_;
+    size_t num_;
+    std::unique_ptr<Sample[]> samples_;
+
+    // the block with unselected bits set to zero, including the bits beyond the end of the bit vector
+    Pack block(size_t const j) const {
+        auto b = bit_ ? bits_[j] : Pack(~bits_[j]);
+        if((j + 1) * BLOCK_SZ > n_) {
+            auto const valid = n_ - j * BLOCK_SZ;
+            b &= std::numeric_limits<Pack>::max() >> (BLOCK_SZ - valid);
+        }
+        return b;
+    }
+
+    static size_t select_in_block(Pack b, size_t r) {
+        // nb: r is zero-based
+        while(r--) b &= b - 1;
+        return std::countr_zero(b);
+    }
+
+public:
+    /// \brief Constructs the select data structure for the given bit vector.
+    /// \param bits the bit vector, packed least significant bit first
+    /// \param n the number of bits
+    BitSelect(Pack const* bits, size_t const n) : bits_(bits), n_(n), num_(0) {
+        size_t const num_blocks = idiv_ceil(n, BLOCK_SZ);
+
+        // count
+        for(size_t j = 0; j < num_blocks; j++) num_ += std::popcount(block(j));
+        samples_ = std::make_unique<Sample[]>(idiv_ceil(num_, SAMPLE_RATE) + 1);
+
+        // sample
+        size_t rank = 0;
+        size_t next_sample = 0;
+        for(size_t j = 0; j < num_blocks; j++) {
+            auto const r = rank + std::popcount(block(j));
+            while(next_sample * SAMPLE_RATE < r) {
+                samples_[next_sample++] = Sample { j, rank };
+            }
+            rank = r;
+        }
+    }
+
+    /// \brief Constructs an empty, uninitialized select data structure.
+    inline BitSelect() : bits_(nullptr), n_(0), num_(0) {
+    }
+
+    BitSelect(BitSelect&& other) = default;
+    BitSelect& operator=(BitSelect&& other) = default;
+
+    BitSelect(const BitSelect& other) = delete;
+    BitSelect& operator=(const BitSelect& other) = delete;
+
+    /// \brief Finds the position of the j-th selected bit.
+    /// \param j the rank of the bit to find, starting at one
+    size_t select(size_t const j) const {
+        assert(j > 0 && j <= num_);
+
+        auto const& s = samples_[(j - 1) / SAMPLE_RATE];
+        auto b = s.block;
+        auto rank = s.rank;
+        while(true) {
+            auto const x = block(b);
+            auto const r = rank + std::popcount(x);
+            if(r >= j) return b * BLOCK_SZ + select_in_block(x, j - rank - 1);
+            rank = r;
+            ++b;
+        }
+    }
+
+    /// \brief Finds the position of the j-th selected bit.
+    ///
+    /// This is a convenience alias for \ref select.
+    ///
+    /// \param j the rank of the bit to find, starting at one
+    inline size_t operator()(size_t const j) const {
+        return select(j);
+    }
+
+    /// \brief The number of selected bits in the bit vector.
+    inline size_t num() const {
+        return num_;
+    }
+
+    inline size_t alloc_size() const {
+        return (idiv_ceil(num_, SAMPLE_RATE) + 1) * sizeof(Sample);
+    }
+};
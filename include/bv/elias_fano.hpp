@@ -5,53 +5,157 @@
 #include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <vector>
 
+#include <code.hpp>
+#include <iopp/concepts.hpp>
 #include <word_packing.hpp>
 
+// Elias-Fano representation of a strictly increasing integer sequence
+// the lower bits of each value are stored verbatim, the upper bits as a unary coded gap sequence
+// accessing a value requires a select query on the upper bits, which starts from a sample taken at every SELECT_SAMPLE-th one bit
 class EliasFano {
 private:
     using Pack = uintmax_t;
 
+    static constexpr size_t SELECT_SAMPLE = 64;
+
+    size_t n_;
     std::unique_ptr<Pack[]> lower_;
     size_t lower_bits_;
-    word_packing::BitVector upper_;
+    std::vector<uint64_t> upper_;
+    size_t upper_size_;
+    std::vector<size_t> select_samples_;
+
+    void push_upper(bool const b) {
+        if(upper_size_ % 64 == 0) upper_.push_back(0);
+        if(b) upper_.back() |= uint64_t(1) << (upper_size_ % 64);
+        ++upper_size_;
+    }
+
+    void build_select() {
+        select_samples_.clear();
+        size_t rank = 0;
+        for(size_t w = 0; w < upper_.size(); w++) {
+            auto word = upper_[w];
+            while(word) {
+                if(rank % SELECT_SAMPLE == 0) select_samples_.push_back(64 * w + std::countr_zero(word));
+                word &= word - 1;
+                ++rank;
+            }
+        }
+    }
+
+    // finds the position of the i-th one bit in the upper bits
+    size_t select_upper(size_t i) const {
+        auto const sample = select_samples_[i / SELECT_SAMPLE];
+        i %= SELECT_SAMPLE;
+
+        auto w = sample / 64;
+        auto word = upper_[w] & (~uint64_t(0) << (sample % 64));
+        size_t c;
+        while(i >= (c = std::popcount(word))) {
+            i -= c;
+            word = upper_[++w];
+        }
+        for(; i > 0; i--) word &= word - 1;
+        return 64 * w + std::countr_zero(word);
+    }
 
 public:
+    EliasFano() : n_(0), lower_bits_(0), upper_size_(0) {
+    }
+
     template<std::unsigned_integral T>
-    EliasFano(T const* array, size_t const n) {
-        auto const log_n = std::bit_width(n-1);
+    EliasFano(T const* array, size_t const n) : n_(n), lower_bits_(0), upper_size_(0) {
+        if(n == 0) return;
+
+        auto const log_n = size_t(std::bit_width(n-1));
 
         auto const m = array[n-1];
-        auto const log_m = std::bit_width(m);
-        
-        lower_bits_ = log_m - log_n;
-        
+        auto const log_m = size_t(std::bit_width(m));
+
+        lower_bits_ = log_m > log_n ? log_m - log_n : 0;
+
         auto const lower_mask = (1ULL << lower_bits_) - 1;
         auto extract_lower = [&](T const v){ return v & lower_mask; };
-
-        auto const upper_mask = (1ULL << log_n) - 1;
-        auto extract_upper = [&](T const v) { return (v >> lower_bits_) & upper_mask; };
+        auto extract_upper = [&](T const v) { return v >> lower_bits_; };
 
         auto lower = word_packing::alloc(lower_, n, lower_bits_);
 
-        auto const max_block = upper_mask;
         size_t cur_block = 0;
         for(size_t i = 0; i < n; i++) {
             auto const v = array[i];
             assert(i == 0 || v > array[i-1]);
-            lower[i] = extract_lower(v);
+            if(lower_bits_) lower[i] = extract_lower(v);
 
             auto const block = extract_upper(v);
             while(block > cur_block) {
-                upper_.push_back(0);
+                push_upper(0);
                 ++cur_block;
             }
-            upper_.push_back(1);
+            push_upper(1);
+        }
+        build_select();
+    }
+
+    EliasFano(EliasFano&&) = default;
+    EliasFano& operator=(EliasFano&&) = default;
+
+    // returns the i-th value of the sequence
+    uintmax_t operator[](size_t const i) const {
+        assert(i < n_);
+        uintmax_t const upper = select_upper(i) - i;
+        if(lower_bits_ == 0) return upper;
+
+        auto const lower = word_packing::accessor(lower_.get(), lower_bits_);
+        return (upper << lower_bits_) | uintmax_t(lower[i]);
+    }
+
+    size_t size() const { return n_; }
+
+    template<iopp::BitSink Out>
+    void encode(Out& out) const {
+        code::EliasDelta::encode(out, n_ + 1);
+        if(n_ == 0) return;
+
+        out.write(lower_bits_, 8);
+        if(lower_bits_) {
+            auto const lower = word_packing::accessor(lower_.get(), lower_bits_);
+            for(size_t i = 0; i < n_; i++) out.write(uintmax_t(lower[i]), lower_bits_);
+        }
+
+        code::EliasDelta::encode(out, upper_size_);
+        for(size_t i = 0; i < upper_size_ / 64; i++) out.write(upper_[i], 64);
+        if(upper_size_ % 64) out.write(upper_.back(), upper_size_ % 64);
+    }
+
+    // restores a sequence written by encode
+    template<iopp::BitSource In>
+    void decode(In& in) {
+        n_ = code::EliasDelta::decode(in) - 1;
+        lower_.reset();
+        lower_bits_ = 0;
+        upper_.clear();
+        upper_size_ = 0;
+        select_samples_.clear();
+        if(n_ == 0) return;
+
+        lower_bits_ = in.read(8);
+        if(lower_bits_) {
+            auto lower = word_packing::alloc(lower_, n_, lower_bits_);
+            for(size_t i = 0; i < n_; i++) lower[i] = in.read(lower_bits_);
         }
 
-        while(cur_block <= max_block) {
-            upper_.push_back(0);
-            ++cur_block;
+        auto const upper_size = code::EliasDelta::decode(in);
+        for(size_t i = 0; i < upper_size / 64; i++) {
+            upper_.push_back(in.read(64));
+            upper_size_ += 64;
+        }
+        if(upper_size % 64) {
+            upper_.push_back(in.read(upper_size % 64));
+            upper_size_ = upper_size;
         }
+        build_select();
     }
 };
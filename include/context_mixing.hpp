@@ -0,0 +1,263 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// adaptive coding of bytes using binary context mixing
+//
+// each byte is coded bit by bit (most significant first) using a binary arithmetic coder
+// the probability of each bit is predicted by mixing the predictions of an order-0, an order-1 and an order-2 model,
+// where the order-1 and order-2 contexts are given by the caller as a 16-bit value (e.g., the two preceding bytes of the input)
+// the predictions are mixed in the logistic domain using weights that are trained online, like in the PAQ family of compressors
+// all arithmetic is done on integers, so the encoder and decoder make the exact same predictions on any platform
+namespace cm_internal {
+    constexpr int PROB_BITS = 12;
+    constexpr int PROB_MAX = (1 << PROB_BITS) - 1;
+
+    // the inverse of stretch, i.e., 4096 / (1 + e^{-d / 256}), interpolated from a table
+    inline int squash(int d) {
+        static constexpr int t[33] = {
+            1, 2, 3, 6, 10, 16, 27, 45, 73, 120, 194, 310, 488, 747, 1101, 1546,
+            2047, 2549, 2994, 3348, 3607, 3785, 3901, 3975, 4024, 4050, 4068, 4079, 4085, 4089, 4092, 4093, 4094
+        };
+        if(d > 2047) return PROB_MAX;
+        if(d < -2047) return 1;
+        auto const w = d & 127;
+        d = (d >> 7) + 16;
+        return (t[d] * (128 - w) + t[d + 1] * w + 64) >> 7;
+    }
+
+    // ln(p / (1 - p)), scaled such that it is the inverse of squash
+    struct StretchTable {
+        int16_t t[PROB_MAX + 1];
+
+        StretchTable() {
+            int pi = 0;
+            for(int x = -2047; x <= 2047; x++) {
+                auto const v = squash(x);
+                for(int i = pi; i <= v; i++) t[i] = x;
+                pi = v + 1;
+            }
+            for(int i = pi; i <= PROB_MAX; i++) t[i] = 2047;
+        }
+    };
+
+    inline int stretch(int const p) {
+        static StretchTable const table;
+        return table.t[p];
+    }
+
+    // bit predictions for the 255 nodes of the binary tree over bytes, for a number of contexts
+    // contexts that exceed the number of slots are mapped to slots by a hash; a slot is reset when it gets reused for a different context
+    class ContextTable {
+    private:
+        static constexpr uint32_t EMPTY = UINT32_MAX;
+
+        size_t slot_bits_;
+        std::unique_ptr<uint16_t[]> probs_;
+        std::unique_ptr<uint32_t[]> tags_;
+
+    public:
+        ContextTable(size_t const num_slots) : slot_bits_(std::bit_width(num_slots) - 1) {
+            assert(std::has_single_bit(num_slots));
+            probs_ = std::make_unique_for_overwrite<uint16_t[]>(num_slots * 256);
+            tags_ = std::make_unique_for_overwrite<uint32_t[]>(num_slots);
+            reset();
+        }
+
+        void reset() {
+            std::fill(tags_.get(), tags_.get() + (size_t(1) << slot_bits_), EMPTY);
+        }
+
+        // returns the predictions for the given context, indexed by tree node
+        uint16_t* get(uint32_t const ctx) {
+            auto const slot = (ctx >> slot_bits_) ? ((ctx * 0x9E3779B1U) >> (32 - slot_bits_)) : ctx;
+            auto* probs = probs_.get() + 256 * slot;
+            if(tags_[slot] != ctx) {
+                tags_[slot] = ctx;
+                std::fill(probs, probs + 256, uint16_t(1U << 15));
+            }
+            return probs;
+        }
+    };
+}
+
+// predicts the bits of bytes in a given context
+class ContextMixingModel {
+private:
+    static constexpr size_t NUM_INPUTS = 4; // three models and a bias
+    static constexpr int RATE = 4;          // the adaptation rate of the models
+    static constexpr int LEARNING_RATE = 2; // the learning rate of the mixer
+
+    cm_internal::ContextTable order0_, order1_, order2_;
+    std::unique_ptr<int32_t[]> weights_; // a weight set for each tree node
+
+    // the state of the current prediction
+    uint16_t* p0_;
+    uint16_t* p1_;
+    uint16_t* p2_;
+    int inputs_[NUM_INPUTS];
+    int p_;
+
+public:
+    ContextMixingModel() : order0_(1), order1_(256), order2_(4096), weights_(std::make_unique<int32_t[]>(256 * NUM_INPUTS)) {
+        reset();
+    }
+
+    void reset() {
+        order0_.reset();
+        order1_.reset();
+        order2_.reset();
+        std::fill(weights_.get(), weights_.get() + 256 * NUM_INPUTS, (1 << 16) / 3);
+    }
+
+    // sets the context for the next byte
+    void context(uint16_t const ctx) {
+        p0_ = order0_.get(0);
+        p1_ = order1_.get(ctx & 0xFF);
+        p2_ = order2_.get(ctx);
+    }
+
+    // predicts the probability (12 bits) that the next bit is a one, given the tree node (the bits of the current byte seen so far, prefixed by a one)
+    int predict(size_t const node) {
+        inputs_[0] = cm_internal::stretch(p0_[node] >> 4);
+        inputs_[1] = cm_internal::stretch(p1_[node] >> 4);
+        inputs_[2] = cm_internal::stretch(p2_[node] >> 4);
+        inputs_[3] = 256;
+
+        auto const* w = weights_.get() + NUM_INPUTS * node;
+        int64_t dot = 0;
+        for(size_t i = 0; i < NUM_INPUTS; i++) dot += int64_t(inputs_[i]) * w[i];
+        p_ = std::clamp(cm_internal::squash(int(dot >> 16)), 1, cm_internal::PROB_MAX);
+        return p_;
+    }
+
+    // updates the models and the mixer after a bit has been coded at the given tree node
+    void update(size_t const node, bool const bit) {
+        auto const err = ((int(bit) << cm_internal::PROB_BITS) - p_) * LEARNING_RATE;
+        auto* w = weights_.get() + NUM_INPUTS * node;
+        for(size_t i = 0; i < NUM_INPUTS; i++) w[i] += (inputs_[i] * err) >> 10;
+
+        auto const target = bit ? 65535 : 0;
+        p0_[node] += (target - int(p0_[node])) >> RATE;
+        p1_[node] += (target - int(p1_[node])) >> RATE;
+        p2_[node] += (target - int(p2_[node])) >> RATE;
+    }
+};
+
+// encodes bytes using a ContextMixingModel and a binary arithmetic coder
+class ContextMixingEncoder {
+private:
+    ContextMixingModel model_;
+    uint32_t x1_, x2_;
+    std::vector<uint8_t> out_;
+
+    void encode_bit(bool const bit, int const p) {
+        auto const xmid = x1_ + uint32_t((uint64_t(x2_ - x1_) * uint32_t(p)) >> cm_internal::PROB_BITS);
+        if(bit) x2_ = xmid;
+        else x1_ = xmid + 1;
+
+        while(((x1_ ^ x2_) & 0xFF000000U) == 0) {
+            out_.push_back(uint8_t(x2_ >> 24));
+            x1_ <<= 8;
+            x2_ = (x2_ << 8) | 0xFF;
+        }
+    }
+
+public:
+    ContextMixingEncoder() : x1_(0), x2_(UINT32_MAX) {
+    }
+
+    // resets the model and starts a new encoding, reusing the allocated tables
+    void reset() {
+        model_.reset();
+        x1_ = 0;
+        x2_ = UINT32_MAX;
+        out_.clear();
+    }
+
+    void encode(uint8_t const c, uint16_t const ctx) {
+        model_.context(ctx);
+        size_t node = 1;
+        for(int i = 7; i >= 0; i--) {
+            bool const bit = (c >> i) & 1;
+            encode_bit(bit, model_.predict(node));
+            model_.update(node, bit);
+            node = 2 * node + bit;
+        }
+    }
+
+    // flushes the coder and returns the encoded bytes
+    std::vector<uint8_t> const& finish() {
+        for(int i = 0; i < 4; i++) {
+            out_.push_back(uint8_t(x1_ >> 24));
+            x1_ <<= 8;
+        }
+        return out_;
+    }
+};
+
+// decodes bytes written by a ContextMixingEncoder
+class ContextMixingDecoder {
+private:
+    ContextMixingModel model_;
+    uint32_t x1_, x2_, x_;
+    std::vector<uint8_t> in_;
+    size_t pos_;
+
+    uint8_t next_byte() {
+        auto const c = pos_ < in_.size() ? in_[pos_] : 0;
+        ++pos_;
+        return c;
+    }
+
+    bool decode_bit(int const p) {
+        auto const xmid = x1_ + uint32_t((uint64_t(x2_ - x1_) * uint32_t(p)) >> cm_internal::PROB_BITS);
+        bool const bit = x_ <= xmid;
+        if(bit) x2_ = xmid;
+        else x1_ = xmid + 1;
+
+        while(((x1_ ^ x2_) & 0xFF000000U) == 0) {
+            x1_ <<= 8;
+            x2_ = (x2_ << 8) | 0xFF;
+            x_ = (x_ << 8) | next_byte();
+        }
+        return bit;
+    }
+
+public:
+    ContextMixingDecoder() : x1_(0), x2_(UINT32_MAX), x_(0), pos_(0) {
+    }
+
+    // resets the model and starts decoding the given encoded bytes
+    void reset(std::vector<uint8_t>&& in) {
+        model_.reset();
+        in_ = std::move(in);
+        pos_ = 0;
+        x1_ = 0;
+        x2_ = UINT32_MAX;
+        x_ = 0;
+        for(int i = 0; i < 4; i++) x_ = (x_ << 8) | next_byte();
+    }
+
+    // the number of bytes read so far, including any zeros read past the end of the encoded bytes
+    size_t num_bytes_read() const {
+        return pos_;
+    }
+
+    uint8_t decode(uint16_t const ctx) {
+        model_.context(ctx);
+        size_t node = 1;
+        while(node < 256) {
+            bool const bit = decode_bit(model_.predict(node));
+            model_.update(node, bit);
+            node = 2 * node + bit;
+        }
+        return uint8_t(node - 256);
+    }
+};
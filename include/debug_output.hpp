@@ -0,0 +1,10 @@
+#pragma once
+
+#include <iostream>
+#include <ostream>
+
+// the stream that statistics, progress and debug information is printed to
+// nb: this is stdout by default, but tools that write their output to stdout redirect it to stderr
+struct DebugOutput {
+    inline static std::ostream* stream = &std::cout;
+};
@@ -0,0 +1,297 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "bit_io.hpp"
+#include "memory_mapped_file.hpp"
+
+// a flat binary layout of tries, which can be memory mapped and used read-only without any deserialization (see FlatTrieView)
+//
+// the file starts with a FlatTrieHeader, followed by these arrays, each padded to a multiple of 8 bytes:
+// - the parent of each node (NIL for the root and orphans),
+// - the label of the edge from each node's parent,
+// - the children of each node sorted by label, in CSR form (the beginning of each node's range, and the labels and nodes of the edges),
+// - optionally, the frequency of each node, and
+// - optionally, a bit string holding further state of the owner as packed words (see BitWriter::words), e.g., the Space-Saving buckets
+// all values are stored in native byte order
+constexpr uint64_t FLAT_TRIE_MAGIC =
+    ((uint64_t)'T') << 56 |
+    ((uint64_t)'O') << 48 |
+    ((uint64_t)'P') << 40 |
+    ((uint64_t)'K') << 32 |
+    ((uint64_t)'F') << 24 |
+    ((uint64_t)'L') << 16 |
+    ((uint64_t)'A') << 8 |
+    ((uint64_t)'T');
+
+// must be incremented with every change of the layout
+constexpr uint32_t FLAT_TRIE_VERSION = 1;
+
+// identifies what wrote the file, such that it can only be loaded by the same kind of data structure
+enum class FlatTrieKind : uint64_t {
+    TRIE = 0,
+    TOPK = 1,
+    TOPK_LAZY = 2,
+};
+
+struct FlatTrieHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t index_bytes; // the size of a node index
+    FlatTrieKind kind;
+    uint64_t size;        // the number of nodes, including orphans
+    uint64_t num_edges;
+    uint64_t has_freqs;
+    uint64_t param;       // a parameter of the owner, e.g., the capacity of a Trie
+    uint64_t state_bits;  // the length of the state bit string
+};
+
+static_assert(sizeof(FlatTrieHeader) == 64);
+
+namespace flat_trie_internal {
+    inline size_t padded(size_t const bytes) {
+        return (bytes + 7) & ~size_t(7);
+    }
+
+    template<typename T>
+    void write_array(std::ofstream& out, T const* values, size_t const num) {
+        static uint64_t const zero = 0;
+        auto const bytes = num * sizeof(T);
+        out.write((char const*)values, bytes);
+        out.write((char const*)&zero, padded(bytes) - bytes);
+    }
+}
+
+// writes a trie in the flat layout
+// the trie must provide size, parent, children_of and node(v).inlabel like Trie; freq maps a node to its frequency if has_freqs is set
+template<std::unsigned_integral Index, typename Trie, typename FreqFunc>
+void write_flat_trie(std::filesystem::path const& path, Trie const& trie, FlatTrieKind const kind, uint64_t const param, bool const has_freqs, FreqFunc freq, BitWriter const* state) {
+    using namespace flat_trie_internal;
+
+    size_t const n = trie.size();
+
+    std::vector<Index> parent(n);
+    std::vector<char> label(n);
+    std::vector<Index> child_begin(n + 1);
+    std::vector<char> child_label;
+    std::vector<Index> child_node;
+    std::vector<Index> freqs;
+
+    std::vector<std::pair<uint8_t, Index>> children;
+    for(size_t v = 0; v < n; v++) {
+        parent[v] = trie.parent(v);
+        label[v] = trie.node(v).inlabel;
+
+        auto const& c = trie.children_of(v);
+        children.clear();
+        for(size_t i = 0; i < c.size(); i++) children.emplace_back(uint8_t(c.label(i)), c[i]);
+        std::sort(children.begin(), children.end());
+
+        child_begin[v] = Index(child_node.size());
+        for(auto const& [l, u] : children) {
+            child_label.push_back(char(l));
+            child_node.push_back(u);
+        }
+    }
+    child_begin[n] = Index(child_node.size());
+
+    if(has_freqs) {
+        freqs.resize(n);
+        for(size_t v = 0; v < n; v++) freqs[v] = freq(Index(v));
+    }
+
+    FlatTrieHeader header;
+    header.magic = FLAT_TRIE_MAGIC;
+    header.version = FLAT_TRIE_VERSION;
+    header.index_bytes = sizeof(Index);
+    header.kind = kind;
+    header.size = n;
+    header.num_edges = child_node.size();
+    header.has_freqs = has_freqs;
+    header.param = param;
+    header.state_bits = state ? state->num_bits_written() : 0;
+
+    std::ofstream out(path, std::ios::binary);
+    out.write((char const*)&header, sizeof(header));
+    write_array(out, parent.data(), n);
+    write_array(out, label.data(), n);
+    write_array(out, child_begin.data(), n + 1);
+    write_array(out, child_label.data(), child_label.size());
+    write_array(out, child_node.data(), child_node.size());
+    if(has_freqs) write_array(out, freqs.data(), n);
+    if(state) {
+        auto const words = state->words();
+        write_array(out, words.data(), words.size());
+    }
+
+    if(!out) {
+        std::cerr << "failed to write " << path << std::endl;
+        std::abort();
+    }
+}
+
+// read-only access to a trie in the flat layout, e.g., a memory mapped file
+template<std::unsigned_integral Index>
+class FlatTrieView {
+public:
+    static constexpr Index NIL = std::numeric_limits<Index>::max();
+
+private:
+    FlatTrieHeader const* header_;
+    Index const* parent_;
+    char const* label_;
+    Index const* child_begin_;
+    char const* child_label_;
+    Index const* child_node_;
+    Index const* freq_;
+    uint64_t const* state_;
+
+public:
+    FlatTrieView() : header_(nullptr) {
+    }
+
+    FlatTrieView(char const* data, size_t const size) {
+        using namespace flat_trie_internal;
+
+        header_ = (FlatTrieHeader const*)data;
+        if(size < sizeof(FlatTrieHeader) || header_->magic != FLAT_TRIE_MAGIC) {
+            std::cerr << "not a flat trie" << std::endl;
+            std::abort();
+        }
+        if(header_->version != FLAT_TRIE_VERSION) {
+            std::cerr << "unsupported flat trie version: " << header_->version << " (expected: " << FLAT_TRIE_VERSION << ")" << std::endl;
+            std::abort();
+        }
+        if(header_->index_bytes != sizeof(Index)) {
+            std::cerr << "flat trie has " << header_->index_bytes << "-byte node indices (expected: " << sizeof(Index) << ")" << std::endl;
+            std::abort();
+        }
+
+        auto const n = header_->size;
+        auto const m = header_->num_edges;
+        auto p = data + sizeof(FlatTrieHeader);
+        parent_ = (Index const*)p; p += padded(n * sizeof(Index));
+        label_ = p; p += padded(n);
+        child_begin_ = (Index const*)p; p += padded((n + 1) * sizeof(Index));
+        child_label_ = p; p += padded(m);
+        child_node_ = (Index const*)p; p += padded(m * sizeof(Index));
+        freq_ = header_->has_freqs ? (Index const*)p : nullptr; if(freq_) p += padded(n * sizeof(Index));
+        state_ = header_->state_bits ? (uint64_t const*)p : nullptr; if(state_) p += 8 * (header_->state_bits / 64 + 2);
+
+        if(size_t(p - data) > size) {
+            std::cerr << "flat trie is truncated: " << size << " bytes (expected: " << (p - data) << ")" << std::endl;
+            std::abort();
+        }
+    }
+
+    FlatTrieKind kind() const { return header_->kind; }
+    uint64_t param() const { return header_->param; }
+
+    Index root() const { return 0; }
+    size_t size() const { return header_->size; }
+    size_t num_edges() const { return header_->num_edges; }
+
+    Index parent(Index const v) const { return parent_[v]; }
+    char label(Index const v) const { return label_[v]; }
+
+    Index num_children(Index const v) const { return child_begin_[v + 1] - child_begin_[v]; }
+
+    bool try_get_child(Index const v, char const c, Index& out_child) const {
+        auto const* first = child_label_ + child_begin_[v];
+        auto const* last = child_label_ + child_begin_[v + 1];
+        auto const* it = std::lower_bound(first, last, c, [](char const a, char const b){ return uint8_t(a) < uint8_t(b); });
+        if(it != last && *it == c) {
+            out_child = child_node_[it - child_label_];
+            return true;
+        } else {
+            return false;
+        }
+    }
+
+    bool has_frequencies() const { return freq_ != nullptr; }
+
+    Index frequency(Index const v) const {
+        assert(has_frequencies());
+        return freq_[v];
+    }
+
+    // the state bit string, padded as required by BitReader
+    BitReader state() const { return BitReader(state_, header_->state_bits); }
+
+    size_t spell(Index const v, char* buffer) const {
+        size_t d = 0;
+        for(auto u = v; u != root() && u != NIL; u = parent_[u]) {
+            buffer[d++] = label_[u];
+        }
+        std::reverse(buffer, buffer + d);
+        return d;
+    }
+
+    // try to find the string in the trie and report its depth and node
+    size_t find(char const* s, size_t const max_len, Index& out_node) const {
+        auto v = root();
+        size_t dv = 0;
+        while(dv < max_len && try_get_child(v, s[dv], v)) {
+            ++dv;
+        }
+
+        out_node = v;
+        return dv;
+    }
+};
+
+// a memory mapped trie file in the flat layout
+template<std::unsigned_integral Index>
+class MappedFlatTrie : public FlatTrieView<Index> {
+private:
+    MemoryMappedFile file_;
+
+public:
+    MappedFlatTrie(std::filesystem::path const& path) : file_(path) {
+        static_cast<FlatTrieView<Index>&>(*this) = FlatTrieView<Index>(file_.data(), file_.size());
+    }
+
+    MappedFlatTrie(MappedFlatTrie&&) = default;
+    MappedFlatTrie& operator=(MappedFlatTrie&&) = default;
+};
+
+// writes a Trie in the flat layout
+template<typename Trie>
+void save_trie(std::filesystem::path const& path, Trie const& trie) {
+    using Index = decltype(trie.root());
+    write_flat_trie<Index>(path, trie, FlatTrieKind::TRIE, trie.capacity(), false, [](Index){ return 0; }, nullptr);
+}
+
+// restores a Trie written by save_trie
+// nb: children are attached in the order of their node indices, which is the only possible difference to the saved trie
+template<typename Trie>
+Trie load_trie(std::filesystem::path const& path) {
+    using Index = decltype(std::declval<Trie>().root());
+
+    MemoryMappedFile file(path);
+    FlatTrieView<Index> view(file.data(), file.size());
+    if(view.kind() != FlatTrieKind::TRIE) {
+        std::cerr << "flat trie was not written by a trie" << std::endl;
+        std::abort();
+    }
+
+    Trie trie(Index(view.param()));
+    while(trie.size() < view.size()) trie.new_node();
+    for(Index v = 1; v < view.size(); v++) {
+        auto const parent = view.parent(v);
+        if(parent != view.NIL) trie.attach(v, parent, view.label(v));
+    }
+    return trie;
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <bit_io.hpp>
+#include <code.hpp>
+
+// a lookup table for decoding Huffman codes
+//
+// the primary table is indexed by the next MAX_BITS bits peeked from the source
+// each entry either gives a symbol along with its codeword length, which is replicated for all possible bits following the codeword,
+// or it points to an overflow subtable for the longer codewords sharing those bits, indexed by further peeked bits
+// thus, a symbol with a codeword of at most MAX_BITS bits is decoded using a single table hit rather than one memory access per bit
+class HuffmanDecodeTable {
+public:
+    static constexpr size_t MAX_BITS = 11;
+
+private:
+    struct Entry {
+        uint32_t link;     // the symbol index for a leaf, or the offset of the subtable
+        uint16_t length;   // the number of bits consumed at this level - the rest of the codeword for a leaf, or the bits indexing this table
+        uint16_t sub_bits; // zero for a leaf, or the number of bits indexing the subtable
+    };
+
+    // a codeword, left-aligned in a 64-bit word
+    struct Codeword {
+        uint64_t word;
+        size_t length;
+        uintmax_t sym;
+    };
+
+    // bit source that reads from a fixed probe word and counts the number of bits read
+    class ProbeSource {
+    private:
+        uint64_t word_;
+        size_t num_read_;
+
+    public:
+        ProbeSource(uint64_t const word) : word_(word), num_read_(0) {
+        }
+
+        bool read() {
+            assert(num_read_ < 64);
+            bool const b = (word_ >> (63 - num_read_)) & 1;
+            ++num_read_;
+            return b;
+        }
+
+        uintmax_t read(size_t const bits) {
+            uintmax_t x = 0;
+            for(size_t i = 0; i < bits; i++) x = (x << 1) | uintmax_t(read());
+            return x;
+        }
+
+        operator bool() const { return num_read_ < 64; }
+
+        size_t num_read() const { return num_read_; }
+    };
+
+    std::vector<Entry> table_;
+    std::vector<uintmax_t> syms_;
+    uint32_t root_bits_;
+
+    static uint64_t extract(uint64_t const word, size_t const depth, size_t const bits) {
+        assert(bits > 0 && depth + bits <= 64);
+        return (word << depth) >> (64 - bits);
+    }
+
+    // builds the (sub)table for the codewords in [lo, hi), which share a prefix of the given depth, and returns its offset
+    uint32_t build(std::vector<Codeword> const& codes, size_t const lo, size_t const hi, size_t const depth, size_t const bits) {
+        auto const offset = uint32_t(table_.size());
+        table_.resize(table_.size() + (size_t(1) << bits));
+
+        size_t i = lo;
+        while(i < hi) {
+            auto const key = extract(codes[i].word, depth, bits);
+            if(codes[i].length <= depth + bits) {
+                // leaf, replicated for all bits following the codeword
+                auto const e = Entry { uint32_t(syms_.size()), uint16_t(codes[i].length - depth), 0 };
+                auto const span = size_t(1) << (depth + bits - codes[i].length);
+                std::fill_n(table_.begin() + offset + key, span, e);
+                syms_.push_back(codes[i].sym);
+                ++i;
+            } else {
+                // overflow subtable for all codewords sharing the next bits
+                size_t j = i + 1;
+                size_t max_length = codes[i].length;
+                while(j < hi && extract(codes[j].word, depth, bits) == key) {
+                    max_length = std::max(max_length, codes[j].length);
+                    ++j;
+                }
+
+                auto const sub_bits = std::min(max_length - depth - bits, MAX_BITS);
+                auto const sub_offset = build(codes, i, j, depth + bits, sub_bits);
+                table_[offset + key] = Entry { sub_offset, uint16_t(bits), uint16_t(sub_bits) };
+                i = j;
+            }
+        }
+        return offset;
+    }
+
+public:
+    HuffmanDecodeTable() : root_bits_(0) {
+    }
+
+    template<typename HuffmanTree>
+    HuffmanDecodeTable(HuffmanTree const& tree) : root_bits_(0) {
+        // enumerate the codewords in lexicographic order by decoding probe words
+        // starting from the all-zero word, the next codeword is found by incrementing the current one at its length
+        std::vector<Codeword> codes;
+        uint64_t probe = 0;
+        do {
+            ProbeSource src(probe);
+            auto const sym = code::Huffman::decode(src, tree.root());
+            auto const length = src.num_read();
+            codes.push_back(Codeword { probe, length, uintmax_t(sym) });
+
+            if(length == 0) break; // a single symbol with an empty codeword
+            probe += (length < 64) ? (uint64_t(1) << (64 - length)) : uint64_t(1);
+        } while(probe != 0);
+
+        if(codes.size() == 1 && codes[0].length == 0) {
+            // nothing to read
+            table_.push_back(Entry { 0, 0, 0 });
+            syms_.push_back(codes[0].sym);
+            return;
+        }
+
+        size_t max_length = 0;
+        for(auto const& c : codes) max_length = std::max(max_length, c.length);
+        root_bits_ = uint32_t(std::min(max_length, MAX_BITS));
+        build(codes, 0, codes.size(), 0, root_bits_);
+    }
+
+    template<PeekableBitSource Src>
+    uintmax_t decode(Src& src) const {
+        if(root_bits_ == 0) [[unlikely]] return syms_[0];
+
+        auto e = table_[src.peek(root_bits_)];
+        while(e.sub_bits) [[unlikely]] {
+            src.skip(e.length);
+            e = table_[e.link + src.peek(e.sub_bits)];
+        }
+        src.skip(e.length);
+        return syms_[e.link];
+    }
+
+    size_t size() const { return table_.size(); }
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// allocation policy for large arrays (e.g., the trie node arena or the Space-Saving buckets)
+// if enabled, arrays of at least one huge page are backed by anonymous mappings advised to use transparent huge pages,
+// optionally bound to a NUMA node; otherwise, they are allocated on the heap as usual
+struct HugePages {
+    static constexpr size_t PAGE_SIZE = 2ULL << 20; // 2 MiB
+
+    inline static bool enabled = false;
+    inline static int numa_node = -1; // -1 means no binding
+
+    // statistics on mapped memory, which is not visible to malloc counters
+    // nb: arrays may be mapped and unmapped by several threads concurrently (e.g., when decoding frames in parallel)
+    inline static std::atomic<size_t> mapped = 0;
+    inline static std::atomic<size_t> mapped_peak = 0;
+
+    static void* map(size_t const bytes) {
+        auto const len = ((bytes + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
+        void* p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(p == MAP_FAILED) {
+            std::cerr << "failed to map " << len << " bytes" << std::endl;
+            std::abort();
+        }
+
+        #ifdef MADV_HUGEPAGE
+        madvise(p, len, MADV_HUGEPAGE);
+        #endif
+
+        #ifdef SYS_mbind
+        if(numa_node >= 0) {
+            // nb: we call mbind directly in order not to depend on libnuma
+            constexpr int MPOL_BIND = 2;
+            constexpr size_t max_nodes = 8 * sizeof(unsigned long);
+            if((size_t)numa_node < max_nodes) {
+                unsigned long const mask = 1UL << numa_node;
+                if(syscall(SYS_mbind, p, len, MPOL_BIND, &mask, max_nodes, 0) != 0) {
+                    std::cerr << "warning: failed to bind memory to NUMA node " << numa_node << std::endl;
+                }
+            }
+        }
+        #endif
+
+        auto const now = mapped.fetch_add(len) + len;
+        auto peak = mapped_peak.load();
+        while(now > peak && !mapped_peak.compare_exchange_weak(peak, now)) {
+        }
+        return p;
+    }
+
+    static void unmap(void* p, size_t const bytes) {
+        auto const len = ((bytes + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
+        munmap(p, len);
+        mapped.fetch_sub(len);
+    }
+};
+
+// deleter for arrays allocated using make_array
+template<typename T>
+struct ArrayDeleter {
+    size_t size = 0;
+    bool mapped = false;
+
+    void operator()(T* p) const {
+        if(mapped) {
+            std::destroy_n(p, size);
+            HugePages::unmap(p, size * sizeof(T));
+        } else {
+            delete[] p;
+        }
+    }
+};
+
+template<typename T>
+using ArrayPtr = std::unique_ptr<T[], ArrayDeleter<T>>;
+
+// allocates a value-initialized array according to the huge page policy
+template<typename T>
+ArrayPtr<T> make_array(size_t const size) {
+    auto const bytes = size * sizeof(T);
+    if(HugePages::enabled && bytes >= HugePages::PAGE_SIZE) {
+        T* p = (T*)HugePages::map(bytes);
+        std::uninitialized_value_construct_n(p, size);
+        return ArrayPtr<T>(p, ArrayDeleter<T> { size, true });
+    } else {
+        return ArrayPtr<T>(new T[size](), ArrayDeleter<T> { size, false });
+    }
+}
@@ -7,6 +7,7 @@
 #include <memory>
 #include <vector>
 
+#include "debug_output.hpp"
 #include "space_saving.hpp"
 
 template<std::unsigned_integral StringIndex = uint32_t>
@@ -124,10 +125,10 @@ public:
 
     void print_debug_info() const {
         space_saving_.print_debug_info();
-        std::cout << "k-attractor:" << std::endl;
+        *DebugOutput::stream << "k-attractor:" << std::endl;
         for(size_t i = 0; i < k_; i++) {
-            std::cout << display(attr_[i]) << " (" << data_[i].freq() << "), ";
+            *DebugOutput::stream << display(attr_[i]) << " (" << data_[i].freq() << "), ";
         }
-        std::cout << std::endl;
+        *DebugOutput::stream << std::endl;
     }
 };
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <pm/result.hpp>
+
+// a histogram of operation latencies in nanoseconds with logarithmic buckets
+// bucket i counts the latencies x with bit_width(x) = i, i.e., 2^(i-1) <= x < 2^i
+class LatencyHistogram {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t num_buckets_ = 48;
+
+    std::array<uint64_t, num_buckets_> counts_;
+    uint64_t num_;
+    uint64_t max_;
+
+public:
+    using TimePoint = Clock::time_point;
+
+    static TimePoint now() {
+        return Clock::now();
+    }
+
+    LatencyHistogram() : num_(0), max_(0) {
+        counts_.fill(0);
+    }
+
+    void add(uint64_t const ns) {
+        ++counts_[std::min(size_t(std::bit_width(ns)), num_buckets_ - 1)];
+        ++num_;
+        max_ = std::max(max_, ns);
+    }
+
+    void add(TimePoint const& start, TimePoint const& stop) {
+        add(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count()));
+    }
+
+    uint64_t num() const {
+        return num_;
+    }
+
+    uint64_t max() const {
+        return max_;
+    }
+
+    // an upper bound for the given percentile (0 < p <= 1), namely the upper end of the bucket it falls into
+    uint64_t percentile(double const p) const {
+        auto const rank = uint64_t(p * num_);
+        uint64_t sum = 0;
+        for(size_t i = 0; i < num_buckets_; i++) {
+            sum += counts_[i];
+            if(sum >= rank && sum > 0) return std::min((uint64_t(1) << i) - 1, max_);
+        }
+        return max_;
+    }
+
+    // the non-empty buckets as a comma-separated list of "upper bound:count" pairs
+    std::string str() const {
+        std::string s;
+        for(size_t i = 0; i < num_buckets_; i++) {
+            if(counts_[i]) {
+                if(!s.empty()) s += ",";
+                s += std::to_string((uint64_t(1) << i) - 1) + ":" + std::to_string(counts_[i]);
+            }
+        }
+        return s;
+    }
+
+    void add_to(pm::Result& result, std::string const& op) const {
+        result.add("max_" + op + "_latency_ns", max());
+        result.add(op + "_latency_p99_ns", percentile(0.99));
+        result.add(op + "_latency_p9999_ns", percentile(0.9999));
+        result.add(op + "_latency_hist", str());
+    }
+};
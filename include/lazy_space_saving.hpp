@@ -0,0 +1,339 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <concepts>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include <iopp/concepts.hpp>
+
+#include "always_inline.hpp"
+#include "debug_output.hpp"
+#include "huge_pages.hpp"
+#include "space_saving.hpp"
+
+// a variant of SpaceSaving whose frequencies are stored relative to a global offset (the threshold)
+// decrement_all merely advances the offset, the buckets form a ring indexed by the stored frequencies and are never rebuilt,
+// and stale frequencies (those that fell below the threshold) are reset by a sweep that visits one item per decrement_all
+// hence, there is no renormalization and every operation takes constant time
+// nb: in contrast to SpaceSaving, frequencies are never halved; instead, an item's frequency relative to the threshold is capped at max_allowed_frequency
+template <SpaceSavingItem T>
+class LazySpaceSaving
+{
+private:
+    using Index = typename T::Index;
+    static_assert(std::unsigned_integral<Index>);
+
+public:
+    static constexpr Index NIL = -1;
+
+private:
+    struct Bucket
+    {
+        Index head = NIL;
+        Index tail = NIL;
+
+        bool empty() const ALWAYS_INLINE { return head == NIL; }
+    };
+
+    T *items_;
+    size_t beg_;
+    size_t end_;
+
+    ArrayPtr<Bucket> buckets_; // a ring of buckets, indexed by stored frequencies modulo its size
+    Index bucket_mask_;
+    Index offset_;             // the threshold, all stored frequencies are relative to it (modulo the range of Index)
+
+    Index max_allowed_frequency_;
+
+    Index sweep_;              // the next item to be visited by the sweep
+
+    // the frequency of an item relative to the threshold
+    Index relative(Index const v) const ALWAYS_INLINE
+    {
+        Index const r = items_[v].freq() - offset_;
+        return r <= max_allowed_frequency_ ? r : 0; // nb: anything else is stale, i.e., below the threshold
+    }
+
+    Bucket &bucket(Index const r) ALWAYS_INLINE
+    {
+        return buckets_[Index(offset_ + r) & bucket_mask_];
+    }
+
+    Bucket const &bucket(Index const r) const ALWAYS_INLINE
+    {
+        return buckets_[Index(offset_ + r) & bucket_mask_];
+    }
+
+    void push_front(Bucket &b, Index const v) ALWAYS_INLINE
+    {
+        auto &item = items_[v];
+        if (b.head != NIL)
+            items_[b.head].prev(v);
+        else
+            b.tail = v;
+
+        item.prev(NIL);
+        item.next(b.head);
+        b.head = v;
+    }
+
+    void erase(Bucket &b, Index const v) ALWAYS_INLINE
+    {
+        assert(!b.empty());
+
+        auto const &item = items_[v];
+        auto const iprev = item.prev();
+        auto const inext = item.next();
+
+        if (iprev != NIL) items_[iprev].next(inext);
+        if (inext != NIL) items_[inext].prev(iprev);
+
+        if (b.head == v) b.head = inext;
+        if (b.tail == v) b.tail = iprev;
+    }
+
+    // appends the contents of src to dst in constant time
+    void append(Bucket &dst, Bucket &src) ALWAYS_INLINE
+    {
+        if (src.empty())
+            return;
+
+        if (dst.empty())
+        {
+            dst = src;
+        }
+        else
+        {
+            items_[dst.tail].next(src.head);
+            items_[src.head].prev(dst.tail);
+            dst.tail = src.tail;
+        }
+        src = Bucket();
+    }
+
+public:
+    LazySpaceSaving() : items_(nullptr), offset_(0)
+    {
+    }
+
+    LazySpaceSaving(T *items, Index const begin, Index const end, Index const max_allowed_frequency)
+        : items_(items), beg_(begin), end_(end), offset_(0), max_allowed_frequency_(max_allowed_frequency), sweep_(begin)
+    {
+        assert(beg_ <= end_);
+        assert(max_allowed_frequency_ > 1);
+
+        // the sweep must reset every stale frequency before it could be mistaken for a valid one
+        assert(size_t(end_ - beg_ + 1) + 2 * size_t(max_allowed_frequency_) < size_t(std::numeric_limits<Index>::max()));
+
+        // initialize buckets
+        auto const num_buckets = std::bit_ceil(size_t(max_allowed_frequency_) + 1);
+        buckets_ = make_array<Bucket>(num_buckets);
+        bucket_mask_ = Index(num_buckets - 1);
+    }
+
+    LazySpaceSaving(LazySpaceSaving &&) = default;
+    LazySpaceSaving &operator=(LazySpaceSaving &&) = default;
+
+    LazySpaceSaving(LazySpaceSaving const &other)
+    {
+        *this = other;
+    }
+
+    LazySpaceSaving &operator=(LazySpaceSaving const &other)
+    {
+        items_ = other.items_;
+        beg_ = other.beg_;
+        end_ = other.end_;
+        bucket_mask_ = other.bucket_mask_;
+        offset_ = other.offset_;
+        max_allowed_frequency_ = other.max_allowed_frequency_;
+        sweep_ = other.sweep_;
+
+        buckets_ = make_array<Bucket>(size_t(bucket_mask_) + 1);
+        std::copy(other.buckets_.get(), other.buckets_.get() + bucket_mask_ + 1, buckets_.get());
+        return *this;
+    }
+
+    void set_items(T *items)
+    {
+        items_ = items;
+    }
+
+    void init_garbage()
+    {
+        // link items in garbage bucket
+        auto &garbage_bucket = bucket(0);
+        for (Index i = beg_; i <= end_; i++)
+        {
+            items_[i].freq(offset_);
+            push_front(garbage_bucket, i);
+        }
+    }
+
+    bool get_garbage(Index &out_v) const ALWAYS_INLINE
+    {
+        auto const &garbage_bucket = bucket(0);
+        if (garbage_bucket.empty())
+        {
+            return false;
+        }
+        else
+        {
+            out_v = garbage_bucket.head;
+            return true;
+        }
+    }
+
+    void increment(Index const v) ALWAYS_INLINE
+    {
+        assert(v >= beg_);
+        assert(v <= end_);
+
+        auto const r = relative(v);
+        if (r == max_allowed_frequency_)
+        {
+            // this item already has the maximum frequency, don't increment
+            return;
+        }
+
+        if (items_[v].is_linked())
+        {
+            // move to next bucket
+            erase(bucket(r), v);
+            push_front(bucket(r + 1), v);
+        }
+
+        items_[v].freq(offset_ + r + 1);
+    }
+
+    void decrement_all() ALWAYS_INLINE
+    {
+        // merge the threshold bucket into the next one
+        append(bucket(1), bucket(0));
+
+        // then simply advance the offset
+        // nb: the items of the former threshold bucket now have a stale frequency, which is interpreted as the threshold
+        ++offset_;
+
+        // reset one stale frequency
+        if (relative(sweep_) == 0)
+            items_[sweep_].freq(offset_);
+
+        sweep_ = (sweep_ == end_) ? beg_ : sweep_ + 1;
+    }
+
+    void link(Index const v) ALWAYS_INLINE
+    {
+        assert(v >= beg_);
+        assert(v <= end_);
+
+        auto const r = relative(v);
+        items_[v].freq(offset_ + r);
+        push_front(bucket(r), v);
+    }
+
+    void unlink(Index const v) ALWAYS_INLINE
+    {
+        assert(v >= beg_);
+        assert(v <= end_);
+
+        erase(bucket(relative(v)), v);
+    }
+
+    // writes the relative item frequencies and the exact contents of all buckets
+    template <iopp::BitSink Out>
+    void encode_snapshot(Out &out) const
+    {
+        auto const freq_bits = std::bit_width(size_t(max_allowed_frequency_));
+        auto const num_bits = std::bit_width(size_t(end_ - beg_ + 1));
+        auto const item_bits = std::bit_width(size_t(end_ - beg_));
+
+        for (Index i = beg_; i <= end_; i++)
+        {
+            out.write(relative(i), freq_bits);
+        }
+
+        for (Index r = 0; r <= max_allowed_frequency_; r++)
+        {
+            auto const &b = bucket(r);
+            out.write(!b.empty());
+            if (!b.empty())
+            {
+                size_t num = 0;
+                for (auto v = b.head; v != NIL; v = items_[v].next()) ++num;
+                out.write(num, num_bits);
+                for (auto v = b.head; v != NIL; v = items_[v].next())
+                {
+                    out.write(v - beg_, item_bits);
+                }
+            }
+        }
+    }
+
+    // restores a snapshot written by encode_snapshot
+    // nb: the offset is reset to zero, which does not change the behaviour because all frequencies are relative to it
+    template <iopp::BitSource In>
+    void decode_snapshot(In &in)
+    {
+        auto const freq_bits = std::bit_width(size_t(max_allowed_frequency_));
+        auto const num_bits = std::bit_width(size_t(end_ - beg_ + 1));
+        auto const item_bits = std::bit_width(size_t(end_ - beg_));
+
+        offset_ = 0;
+        sweep_ = beg_;
+        for (Index i = beg_; i <= end_; i++)
+        {
+            items_[i].freq(in.read(freq_bits));
+        }
+
+        for (size_t i = 0; i <= bucket_mask_; i++)
+        {
+            buckets_[i] = Bucket();
+        }
+
+        std::vector<Index> bucket_items;
+        for (Index r = 0; r <= max_allowed_frequency_; r++)
+        {
+            if (in.read())
+            {
+                size_t const num = in.read(num_bits);
+                bucket_items.clear();
+                for (size_t j = 0; j < num; j++)
+                {
+                    bucket_items.push_back(beg_ + Index(in.read(item_bits)));
+                }
+
+                auto &b = bucket(r);
+                for (auto it = bucket_items.rbegin(); it != bucket_items.rend(); ++it)
+                {
+                    push_front(b, *it);
+                }
+            }
+        }
+    }
+
+    Index threshold() const ALWAYS_INLINE
+    {
+        return offset_;
+    }
+
+    // the frequency of the given item, which is at least the threshold
+    Index frequency(Index const v) const ALWAYS_INLINE
+    {
+        return offset_ + relative(v);
+    }
+
+    void print_snapshot() const
+    {
+        print_debug_info();
+    }
+
+    void print_debug_info() const
+    {
+        *DebugOutput::stream << "# DEBUG: lazy-space-saving << offset=" << offset_ << ", num_buckets=" << (size_t(bucket_mask_) + 1) << std::endl;
+    }
+};
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "always_inline.hpp"
+#include "huge_pages.hpp"
+
+// allocates link arrays of power-of-two capacities on the heap, one by one
+template<std::unsigned_integral NodeIndex>
+struct HeapLinks {
+    NodeIndex* allocate(size_t const capacity) ALWAYS_INLINE {
+        return new NodeIndex[capacity];
+    }
+
+    void free(NodeIndex* links, size_t const) ALWAYS_INLINE {
+        delete[] links;
+    }
+};
+
+// a size-class slab pool for link arrays of power-of-two capacities
+// blocks are cut from slabs that grow geometrically up to the huge page size, and freed blocks are kept in one free list per size class
+// the memory is only returned when the pool is destroyed
+template<std::unsigned_integral NodeIndex>
+class LinkPool {
+private:
+    using Word = uint64_t;
+
+    static constexpr size_t num_classes_ = 8 * sizeof(size_t);
+    static constexpr size_t min_slab_words_ = (64ULL << 10) / sizeof(Word);
+    static constexpr size_t max_slab_words_ = HugePages::PAGE_SIZE / sizeof(Word);
+    static constexpr size_t min_block_words_ = (sizeof(void*) + sizeof(Word) - 1) / sizeof(Word);
+
+    // the number of words of a block in the given size class
+    // nb: each block must be able to hold the free list pointer
+    static constexpr size_t block_words(size_t const c) {
+        return std::max(((size_t(1) << c) * sizeof(NodeIndex) + sizeof(Word) - 1) / sizeof(Word), min_block_words_);
+    }
+
+    std::vector<ArrayPtr<Word>> slabs_;
+    Word* cur_;     // the next free word in the current slab
+    size_t avail_;  // the number of words available in the current slab
+
+    std::array<Word*, num_classes_> free_; // the heads of the free lists for each size class
+
+    size_t slab_words_total_;
+
+    Word* bump(size_t const words) {
+        if(avail_ < words) {
+            // allocate a new slab that doubles the total size of the pool, up to the maximum slab size
+            // nb: whatever is left of the current slab is wasted
+            auto const size = std::max(words, std::clamp(2 * slab_words_total_, min_slab_words_, max_slab_words_));
+            slabs_.emplace_back(make_array<Word>(size));
+            cur_ = slabs_.back().get();
+            avail_ = size;
+            slab_words_total_ += size;
+        }
+
+        auto* p = cur_;
+        cur_ += words;
+        avail_ -= words;
+        return p;
+    }
+
+public:
+    LinkPool() : cur_(nullptr), avail_(0), slab_words_total_(0) {
+        free_.fill(nullptr);
+    }
+
+    LinkPool(LinkPool&&) = default;
+    LinkPool& operator=(LinkPool&&) = default;
+
+    // nb: blocks cannot be copied without knowing which of them are in use
+    LinkPool(LinkPool const&) = delete;
+    LinkPool& operator=(LinkPool const&) = delete;
+
+    NodeIndex* allocate(size_t const capacity) ALWAYS_INLINE {
+        assert(std::has_single_bit(capacity));
+        auto const c = std::countr_zero(capacity);
+
+        Word* p = free_[c];
+        if(p) {
+            Word* next;
+            std::memcpy(&next, p, sizeof(next));
+            free_[c] = next;
+        } else {
+            p = bump(block_words(c));
+        }
+        return (NodeIndex*)p;
+    }
+
+    void free(NodeIndex* links, size_t const capacity) ALWAYS_INLINE {
+        assert(std::has_single_bit(capacity));
+        auto const c = std::countr_zero(capacity);
+
+        auto* p = (Word*)links;
+        std::memcpy(p, &free_[c], sizeof(Word*));
+        free_[c] = p;
+    }
+
+    size_t num_slabs() const {
+        return slabs_.size();
+    }
+
+    // the total amount of memory allocated by the pool, including unused blocks
+    size_t mem_size() const {
+        return sizeof(LinkPool) + slabs_.capacity() * sizeof(ArrayPtr<Word>) + slab_words_total_ * sizeof(Word);
+    }
+};
+
+template<std::unsigned_integral NodeIndex>
+size_t memory_size_of(HeapLinks<NodeIndex> const&) {
+    return 0; // nb: heap allocations are accounted for by their owners
+}
+
+template<std::unsigned_integral NodeIndex>
+size_t memory_size_of(LinkPool<NodeIndex> const& pool) {
+    return pool.mem_size();
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <concepts>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bv/bit_select.hpp"
+#include "idiv_ceil.hpp"
+
+// a static trie represented by its level-order unary degree sequence (LOUDS), which takes about 2 bits per node plus the labels
+//
+// the nodes are numbered in breadth-first order, where the children of each node are ordered by their labels
+// the LOUDS is the bit string 10 followed by, for each node in that order, a one for each of its children and a zero
+// hence, the one representing node v is the (v+1)-th one, and the ones representing the children of node v follow the (v+1)-th zero,
+// such that navigation only takes select queries and the children of a node have consecutive numbers
+class LoudsTrie {
+private:
+    using Pack = uint64_t;
+
+    size_t size_;
+    size_t num_bits_;
+    std::unique_ptr<Pack[]> louds_;
+    std::unique_ptr<char[]> labels_; // the label of the edge from each node's parent
+    BitSelect<0, Pack> select0_;
+    BitSelect<1, Pack> select1_;
+
+    // the first child of v and the number of children
+    std::pair<size_t, size_t> children_range(size_t const v) const {
+        auto const p = select0_(v + 1);
+        auto const q = select0_(v + 2);
+        return { p - v, q - p - 1 };
+    }
+
+    // lists the (label, node) pairs of the children of a node of a trie
+    template<typename Trie>
+    static auto trie_children(Trie const& trie) {
+        return [&trie](auto const v, auto& children){
+            auto const& c = trie.children_of(v);
+            for(size_t i = 0; i < c.size(); i++) children.emplace_back(uint8_t(c.label(i)), c[i]);
+        };
+    }
+
+    // traverses a trie in breadth-first order, visiting each node along with its children ordered by their labels
+    // children(v, out) must append the (label, node) pairs of the children of v to out in any order
+    template<typename NodeIndex, typename Children, typename Visit>
+    static void traverse(NodeIndex const root, Children children, Visit visit) {
+        std::vector<NodeIndex> queue = { root };
+        std::vector<std::pair<uint8_t, NodeIndex>> sorted;
+        for(size_t i = 0; i < queue.size(); i++) {
+            sorted.clear();
+            children(queue[i], sorted);
+            std::sort(sorted.begin(), sorted.end());
+
+            visit(queue[i], sorted);
+            for(auto const& [label, u] : sorted) queue.push_back(u);
+        }
+    }
+
+    template<typename NodeIndex, typename Children>
+    void build(NodeIndex const root, Children children, std::vector<size_t>* node_map) {
+        std::vector<Pack> louds(1, 0);
+        std::vector<char> labels = { 0 };
+        size_t pos = 0;
+        auto append = [&](bool const b){
+            if(pos / 64 == louds.size()) louds.push_back(0);
+            if(b) louds[pos / 64] |= Pack(1) << (pos % 64);
+            ++pos;
+        };
+
+        append(1);
+        append(0);
+
+        size_t num = 0;
+        traverse(root, children, [&](NodeIndex const v, auto const& sorted){
+            if(node_map) (*node_map)[v] = num;
+            ++num;
+
+            for(auto const& [label, u] : sorted) {
+                append(1);
+                labels.push_back(char(label));
+            }
+            append(0);
+        });
+
+        size_ = num;
+        num_bits_ = pos;
+
+        louds_ = std::make_unique<Pack[]>(idiv_ceil(num_bits_, 64));
+        std::copy(louds.begin(), louds.begin() + idiv_ceil(num_bits_, 64), louds_.get());
+        labels_ = std::make_unique<char[]>(size_);
+        std::copy(labels.begin(), labels.end(), labels_.get());
+
+        select0_ = BitSelect<0, Pack>(louds_.get(), num_bits_);
+        select1_ = BitSelect<1, Pack>(louds_.get(), num_bits_);
+    }
+
+public:
+    LoudsTrie() : size_(0), num_bits_(0) {
+    }
+
+    LoudsTrie(LoudsTrie&&) = default;
+    LoudsTrie& operator=(LoudsTrie&&) = default;
+
+    LoudsTrie(LoudsTrie const&) = delete;
+    LoudsTrie& operator=(LoudsTrie const&) = delete;
+
+    // constructs the trie from the nodes reachable from the root of the given trie
+    // if node_map is given, it receives the number of each of the given trie's nodes in this trie
+    template<typename Trie>
+    LoudsTrie(Trie const& other, std::vector<size_t>* node_map = nullptr) {
+        if(node_map) node_map->assign(other.size(), 0);
+        build(other.root(), trie_children(other), node_map);
+    }
+
+    // constructs the trie from a topology given as balanced parentheses and the labels of the nodes, both in depth-first order (see trie_coding.hpp)
+    LoudsTrie(std::vector<bool> const& topology, std::string const& labels) {
+        // the size of the subtree of each node, given by its depth-first number
+        // nb: the children of node v are v+1, followed by each child's next sibling, which is the child plus its subtree size
+        std::vector<size_t> subtree(labels.size());
+        {
+            std::vector<size_t> stack;
+            size_t num_open = 0;
+            for(size_t i = 0; i < topology.size(); i++) {
+                if(topology[i]) {
+                    stack.push_back(num_open++);
+                } else {
+                    auto const v = stack.back();
+                    stack.pop_back();
+                    subtree[v] = num_open - v;
+                }
+            }
+            assert(num_open == labels.size());
+        }
+
+        build(size_t(0), [&](size_t const v, auto& children){
+            for(auto u = v + 1; u < v + subtree[v]; u += subtree[u]) children.emplace_back(uint8_t(labels[u]), u);
+        }, nullptr);
+    }
+
+    // numbers the nodes reachable from the root of the given trie like a LoudsTrie constructed from it would, without constructing it
+    template<typename Trie>
+    static std::vector<size_t> numbering(Trie const& trie) {
+        std::vector<size_t> node_map(trie.size(), 0);
+        size_t num = 0;
+        traverse(trie.root(), trie_children(trie), [&](auto const v, auto const&){ node_map[v] = num++; });
+        return node_map;
+    }
+
+    size_t root() const { return 0; }
+    size_t size() const { return size_; }
+
+    size_t parent(size_t const v) const {
+        assert(v > 0);
+        return select1_(v + 1) - v - 1;
+    }
+
+    char label(size_t const v) const {
+        return labels_[v];
+    }
+
+    size_t num_children(size_t const v) const {
+        return children_range(v).second;
+    }
+
+    template<std::unsigned_integral NodeIndex>
+    bool try_get_child(size_t const v, char const c, NodeIndex& out_node) const {
+        auto const [first, num] = children_range(v);
+        auto const* begin = labels_.get() + first;
+        auto const* end = begin + num;
+        auto const* it = std::lower_bound(begin, end, c, [](char const a, char const b){ return uint8_t(a) < uint8_t(b); });
+        if(it != end && *it == c) {
+            out_node = NodeIndex(it - labels_.get());
+            return true;
+        } else {
+            return false;
+        }
+    }
+
+    size_t spell_reverse(size_t const node, char* buffer) const {
+        size_t d = 0;
+        for(auto v = node; v != root(); v = parent(v)) {
+            buffer[d++] = labels_[v];
+        }
+        return d;
+    }
+
+    size_t spell(size_t const node, char* buffer) const {
+        auto const d = spell_reverse(node, buffer);
+        std::reverse(buffer, buffer + d);
+        return d;
+    }
+
+    void print_debug_info() const {
+    }
+
+    size_t mem_size() const {
+        return sizeof(LoudsTrie) + idiv_ceil(num_bits_, 64) * sizeof(Pack) + size_ + select0_.alloc_size() + select1_.alloc_size();
+    }
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <lz77/factor.hpp>
+
+#include "libsais_wrapper.hpp"
+
+// computes the longest previous factor (LPF) array of a text along with a source for each longest previous factor,
+// i.e., lpf[i] is the length of the longest prefix of suffix i that also occurs starting at some position prev[i] < i (prev[i] is meaningless if lpf[i] = 0)
+// nb: the longest previous factor of suffix i is shared with the previous or next smaller value (PSV/NSV) of i in the suffix array,
+// the lengths of which are obtained from the LCP array as range minima while scanning with a stack
+template<std::contiguous_iterator TextReadAccess>
+requires (sizeof(std::iter_value_t<TextReadAccess>) == 1)
+void lpf_prev_u32(TextReadAccess begin, TextReadAccess end, uint32_t* lpf, uint32_t* prev) {
+    auto const n = size_t(end - begin);
+    if(n == 0) return;
+
+    auto [sa, isa, lcp] = sa_isa_lcp_u32(begin, end);
+    isa.reset();
+
+    for(size_t i = 0; i < n; i++) lpf[i] = 0;
+
+    static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+    // each stack entry holds a suffix array position along with the minimum LCP between it and the entry below it
+    std::vector<std::pair<uint32_t, uint32_t>> stack;
+    auto report = [&](uint32_t const i, uint32_t const src, uint32_t const len){
+        if(len > lpf[i]) {
+            lpf[i] = len;
+            prev[i] = src;
+        }
+    };
+
+    // PSV: scan from left to right, where run is the minimum LCP between the stack top and the current position
+    {
+        uint32_t run = NONE;
+        for(size_t r = 0; r < n; r++) {
+            run = std::min(run, lcp[r]);
+            while(!stack.empty() && sa[stack.back().first] > sa[r]) {
+                run = std::min(run, stack.back().second);
+                stack.pop_back();
+            }
+            if(!stack.empty()) report(sa[r], sa[stack.back().first], run);
+            stack.emplace_back(r, run);
+            run = NONE;
+        }
+    }
+    stack.clear();
+
+    // NSV: scan from right to left, symmetrically
+    {
+        uint32_t run = NONE;
+        for(size_t r = n; r-- > 0;) {
+            if(r + 1 < n) run = std::min(run, lcp[r + 1]);
+            while(!stack.empty() && sa[stack.back().first] > sa[r]) {
+                run = std::min(run, stack.back().second);
+                stack.pop_back();
+            }
+            if(!stack.empty()) report(sa[r], sa[stack.back().first], run);
+            stack.emplace_back(r, run);
+            run = NONE;
+        }
+    }
+}
+
+// computes the greedy LZ77 factorization of the text [mid, end), where references may also point into the preceding history [begin, mid)
+// each factor is the longest previous factor at its position, or a literal if that is shorter than the threshold, and its source is given as the distance
+template<std::contiguous_iterator TextReadAccess, std::output_iterator<lz77::Factor> Out>
+requires (sizeof(std::iter_value_t<TextReadAccess>) == 1)
+void factorize_with_history(TextReadAccess begin, TextReadAccess mid, TextReadAccess end, size_t const threshold, Out out) {
+    auto const n = size_t(end - begin);
+    auto lpf = std::make_unique<uint32_t[]>(n);
+    auto prev = std::make_unique<uint32_t[]>(n);
+    lpf_prev_u32(begin, end, lpf.get(), prev.get());
+
+    auto const min_len = std::max(threshold, size_t(2));
+    for(size_t i = size_t(mid - begin); i < n;) {
+        if(lpf[i] >= min_len) {
+            *out++ = lz77::Factor(i - prev[i], lpf[i]);
+            i += lpf[i];
+        } else {
+            *out++ = lz77::Factor(begin[i]);
+            ++i;
+        }
+    }
+}
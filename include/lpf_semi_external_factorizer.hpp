@@ -12,6 +12,8 @@
 #include <lz77/factor.hpp>
 #include <pm.hpp>
 
+#include "debug_output.hpp"
+
 /**
  * \brief Computes an exact Lempel-Ziv 77 factorization of the input by simulating the longest previous factor (LPF) array
  */
@@ -56,7 +58,7 @@ public:
     void factorize(Input begin, Input const& end, Output out, bool keep_index = false) {
         std::string_view const t(begin, end);
         size_t const n = t.size();
-        std::cout << "loaded input: n=" << n << std::endl;
+        *DebugOutput::stream << "loaded input: n=" << n << std::endl;
 
         pm::Stopwatch sw;
 
@@ -64,7 +66,7 @@ public:
         auto const work_file_isa = isa_path();
 
         // allocate working memory
-        std::cout << "allocating working memory" << std::endl;
+        *DebugOutput::stream << "allocating working memory" << std::endl;
         auto work_mem = std::make_unique<int64_t[]>(n);
 
         if(!(keep_index && std::filesystem::is_regular_file(work_file_sa) && std::filesystem::is_regular_file(work_file_isa))) {        
@@ -72,8 +74,8 @@ public:
             {
                 auto* sa = work_mem.get();
 
-                std::cout << "construct suffix array ... ";
-                std::cout.flush();
+                *DebugOutput::stream << "construct suffix array ... ";
+                DebugOutput::stream->flush();
                 sw.start();
                 #if LIBSAIS_OPENMP
                 libsais64_omp((uint8_t const*)t.data(), sa, n, 0, nullptr, 0);
@@ -81,26 +83,26 @@ public:
                 libsais64((uint8_t const*)t.data(), sa, n, 0, nullptr);
                 #endif
                 sw.stop();
-                std::cout << long(sw.elapsed_time_millis()/1000.0) << "s" << std::endl;
+                *DebugOutput::stream << long(sw.elapsed_time_millis()/1000.0) << "s" << std::endl;
 
                 // externalize suffix array
-                std::cout << "externalize suffix array ... ";
-                std::cout.flush();
+                *DebugOutput::stream << "externalize suffix array ... ";
+                DebugOutput::stream->flush();
                 sw.start();
                 {
                     auto sa_out = iopp::FileOutputStream(work_file_sa);
                     for(size_t i = 0; i < n; i++) write5(sa_out, sa[i]);
                 }
                 sw.stop();
-                std::cout << long(sw.elapsed_time_millis()/1000.0) << "s" << std::endl;
+                *DebugOutput::stream << long(sw.elapsed_time_millis()/1000.0) << "s" << std::endl;
             }
 
             // construct inverse suffix array and load suffix array
             {
                 auto* isa = work_mem.get();
 
-                std::cout << "construct inverse suffix array ... ";
-                std::cout.flush();
+                *DebugOutput::stream << "construct inverse suffix array ... ";
+                DebugOutput::stream->flush();
                 sw.start();
                 {
                     auto sa_in = iopp::FileInputStream(work_file_sa);
@@ -130,37 +132,37 @@ public:
                     #endif
                 }
                 sw.stop();
-                std::cout << long(sw.elapsed_time_millis()/1000.0) << "s" << std::endl;
+                *DebugOutput::stream << long(sw.elapsed_time_millis()/1000.0) << "s" << std::endl;
 
                 // externalize suffix array and load sufix array
-                std::cout << "externalize inverse suffix array ... ";
-                std::cout.flush();
+                *DebugOutput::stream << "externalize inverse suffix array ... ";
+                DebugOutput::stream->flush();
                 sw.start();
                 {
                     auto isa_out = iopp::FileOutputStream(work_file_isa);
                     for(size_t i = 0; i < n; i++) write5(isa_out, isa[i]);
                 }
                 sw.stop();
-                std::cout << long(sw.elapsed_time_millis()/1000.0) << "s" << std::endl;
+                *DebugOutput::stream << long(sw.elapsed_time_millis()/1000.0) << "s" << std::endl;
             }
         } else {
-            std::cout << "index files already present -- skipping suffix array and inverse construction" << std::endl;
-            std::cout << "\t" << work_file_sa << std::endl;
-            std::cout << "\t" << work_file_isa << std::endl;
+            *DebugOutput::stream << "index files already present -- skipping suffix array and inverse construction" << std::endl;
+            *DebugOutput::stream << "\t" << work_file_sa << std::endl;
+            *DebugOutput::stream << "\t" << work_file_isa << std::endl;
         }
 
         // reload suffix array
         auto* sa = work_mem.get();
         {
-            std::cout << "reload suffix array ... ";
-            std::cout.flush();
+            *DebugOutput::stream << "reload suffix array ... ";
+            DebugOutput::stream->flush();
             sw.start();
             {
                 auto sa_in = iopp::FileInputStream(work_file_sa);
                 for(size_t i = 0; i < n; i++) sa[i] = read5(sa_in);
             }
             sw.stop();
-            std::cout << long(sw.elapsed_time_millis()/1000.0) << "s" << std::endl;
+            *DebugOutput::stream << long(sw.elapsed_time_millis()/1000.0) << "s" << std::endl;
 
             if(!keep_index) std::filesystem::remove(work_file_sa);
         }
@@ -170,14 +172,14 @@ public:
 
         // factorize
         sw.start();
-        std::cout << "factorize" << std::endl;
+        *DebugOutput::stream << "factorize" << std::endl;
         size_t prog_next = 0;
         size_t const prog_step = n / 100;
         size_t z=0;
         for(size_t i = 0; i < n;) {
             if(i >= prog_next) {
                 sw.pause();
-                std::cout << "\ti=" << i << " (" << 100.0 * double(i) / double(n) << "%), z=" << z << ", time=" << long(sw.elapsed_time_millis()/1000.0) << "s" << std::endl;
+                *DebugOutput::stream << "\ti=" << i << " (" << 100.0 * double(i) / double(n) << "%), z=" << z << ", time=" << long(sw.elapsed_time_millis()/1000.0) << "s" << std::endl;
                 prog_next += prog_step;
                 sw.resume();
             }
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// read-only memory mapping of a file (or a prefix thereof) exposed as a contiguous range of characters
+class MemoryMappedFile {
+private:
+    int fd_;
+    void* map_;
+    size_t size_;
+
+    void unmap() {
+        if(map_) {
+            munmap(map_, size_);
+            map_ = nullptr;
+        }
+        if(fd_ >= 0) {
+            close(fd_);
+            fd_ = -1;
+        }
+        size_ = 0;
+    }
+
+public:
+    MemoryMappedFile() : fd_(-1), map_(nullptr), size_(0) {
+    }
+
+    MemoryMappedFile(std::filesystem::path const& path, size_t const prefix = SIZE_MAX) : MemoryMappedFile() {
+        fd_ = open(path.c_str(), O_RDONLY);
+        if(fd_ < 0) {
+            std::cerr << "failed to open " << path << ": " << std::strerror(errno) << std::endl;
+            std::abort();
+        }
+
+        struct stat st;
+        if(fstat(fd_, &st) != 0) {
+            std::cerr << "failed to stat " << path << ": " << std::strerror(errno) << std::endl;
+            std::abort();
+        }
+
+        size_ = std::min((size_t)st.st_size, prefix);
+        if(size_ > 0) {
+            // nb: empty files cannot be mapped, in that case we simply keep a null range
+            map_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+            if(map_ == MAP_FAILED) {
+                map_ = nullptr;
+                std::cerr << "failed to map " << path << ": " << std::strerror(errno) << std::endl;
+                std::abort();
+            }
+
+            // the compressors read their input front to back
+            madvise(map_, size_, MADV_SEQUENTIAL);
+        }
+    }
+
+    ~MemoryMappedFile() {
+        unmap();
+    }
+
+    MemoryMappedFile(MemoryMappedFile&& other) : fd_(other.fd_), map_(other.map_), size_(other.size_) {
+        other.fd_ = -1;
+        other.map_ = nullptr;
+        other.size_ = 0;
+    }
+
+    MemoryMappedFile& operator=(MemoryMappedFile&& other) {
+        if(this != &other) {
+            unmap();
+            fd_ = other.fd_;
+            map_ = other.map_;
+            size_ = other.size_;
+            other.fd_ = -1;
+            other.map_ = nullptr;
+            other.size_ = 0;
+        }
+        return *this;
+    }
+
+    MemoryMappedFile(MemoryMappedFile const&) = delete;
+    MemoryMappedFile& operator=(MemoryMappedFile const&) = delete;
+
+    char const* data() const { return (char const*)map_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    char const* begin() const { return data(); }
+    char const* end() const { return data() + size_; }
+};
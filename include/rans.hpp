@@ -7,6 +7,8 @@
 #include <iopp/concepts.hpp>
 #include <rans_byte.h>
 
+#include "bit_io.hpp"
+
 namespace rans_internal {
     constexpr size_t MAX_NUM_SYMBOLS = 256;
     constexpr size_t BYTE_BITS = 8;
@@ -75,34 +77,22 @@ namespace rans_internal {
             freqs[i] = cum_freqs[i+1] - cum_freqs[i];
         }
     }
-}
-
-template<iopp::BitSink Sink>
-void rans_encode(Sink& sink, uint8_t const* data, size_t const n, uint32_t const prob_bits = 14) {
-    assert(prob_bits >= 8);
-    static constexpr auto MAX_NUM_SYMBOLS = rans_internal::MAX_NUM_SYMBOLS;
-
-    // initialize frequencies
-    uint32_t freqs[MAX_NUM_SYMBOLS];
-    for(size_t x = 0; x < MAX_NUM_SYMBOLS; x++) {
-        freqs[x] = 0;
-    }
-
-    // count frequencies
-    for(size_t i = 0; i < n; i++) {
-        ++freqs[data[i]];
-    }
 
-    // compute cumulative frequencies
-    uint32_t cum_freqs[MAX_NUM_SYMBOLS + 1];
-    rans_internal::compute_cumulative_freqs(freqs, cum_freqs);
+    // counts and normalizes the frequencies of the given symbols and encodes them to the sink
+    template<iopp::BitSink Sink>
+    void encode_freqs(Sink& sink, uint8_t const* data, size_t const n, uint32_t* freqs, uint32_t* cum_freqs, uint32_t const prob_bits) {
+        // count frequencies
+        for(size_t x = 0; x < MAX_NUM_SYMBOLS; x++) {
+            freqs[x] = 0;
+        }
+        for(size_t i = 0; i < n; i++) {
+            ++freqs[data[i]];
+        }
 
-    // normalize
-    auto const prob_scale = 1U << prob_bits;
-    rans_internal::normalize_freqs(freqs, cum_freqs, prob_scale);
+        // compute cumulative frequencies and normalize
+        compute_cumulative_freqs(freqs, cum_freqs);
+        normalize_freqs(freqs, cum_freqs, 1U << prob_bits);
 
-    // encode
-    {
         // we need prob_bits to encode a frequency
         // to encode the corresponding symbols, we encode them as deltas from the previous symbol
         uintmax_t prev = 0;
@@ -118,6 +108,46 @@ void rans_encode(Sink& sink, uint8_t const* data, size_t const n, uint32_t const
         code::EliasDelta::encode(sink, MAX_NUM_SYMBOLS - prev + 1);
     }
 
+    // decodes normalized frequencies written by encode_freqs
+    template<iopp::BitSource Src>
+    void decode_freqs(Src& src, uint32_t* freqs, uint32_t* cum_freqs, uint32_t const prob_bits) {
+        for(size_t x = 0; x < MAX_NUM_SYMBOLS; x++) {
+            freqs[x] = 0;
+        }
+
+        auto x = code::EliasDelta::decode(src) - 1;
+        while(x < MAX_NUM_SYMBOLS) {
+            freqs[x] = code::Binary::decode(src, prob_bits) + 1;
+            x += code::EliasDelta::decode(src) - 1;
+        }
+
+        // compute cumulative frequencies, which are already normalized
+        compute_cumulative_freqs(freqs, cum_freqs);
+        assert(cum_freqs[MAX_NUM_SYMBOLS] == (1U << prob_bits));
+    }
+
+    // brute-force (but fast) cumulative to symbol table
+    inline std::unique_ptr<uint8_t[]> cum_to_sym(uint32_t const* cum_freqs, uint32_t const prob_bits) {
+        auto cum2sym = std::make_unique<uint8_t[]>(1U << prob_bits);
+        for(size_t x = 0; x < MAX_NUM_SYMBOLS; x++) {
+            for(size_t i = cum_freqs[x]; i < cum_freqs[x+1]; i++) {
+                cum2sym[i] = x;
+            }
+        }
+        return cum2sym;
+    }
+}
+
+template<iopp::BitSink Sink>
+void rans_encode(Sink& sink, uint8_t const* data, size_t const n, uint32_t const prob_bits = 14) {
+    assert(prob_bits >= 8);
+    static constexpr auto MAX_NUM_SYMBOLS = rans_internal::MAX_NUM_SYMBOLS;
+
+    // count, normalize and encode frequencies
+    uint32_t freqs[MAX_NUM_SYMBOLS];
+    uint32_t cum_freqs[MAX_NUM_SYMBOLS + 1];
+    rans_internal::encode_freqs(sink, data, n, freqs, cum_freqs, prob_bits);
+
     // initialize rANS symbols
     RansEncSymbol esyms[MAX_NUM_SYMBOLS];
     for(size_t x = 0; x < MAX_NUM_SYMBOLS; x++) {
@@ -144,9 +174,7 @@ void rans_encode(Sink& sink, uint8_t const* data, size_t const n, uint32_t const
     auto const num_enc_bytes = end - p;
     assert(num_enc_bytes < n);
     code::Binary::encode(sink, num_enc_bytes, code::Universe(n));
-    while(p < end) {
-        code::Binary::encode(sink, *p++, rans_internal::BYTE_BITS);
-    }
+    write_fixed(sink, p, num_enc_bytes, rans_internal::BYTE_BITS);
 }
 
 template<iopp::BitSource Src, std::output_iterator<uint8_t> Out>
@@ -154,34 +182,11 @@ void rans_decode(Src& src, size_t const n, Out out, uint32_t const prob_bits = 1
     assert(prob_bits >= 8);
     static constexpr auto MAX_NUM_SYMBOLS = rans_internal::MAX_NUM_SYMBOLS;
 
-    // initialize frequencies
-    uint32_t freqs[MAX_NUM_SYMBOLS];
-    for(size_t x = 0; x < MAX_NUM_SYMBOLS; x++) {
-        freqs[x] = 0;
-    }
-
     // decode frequencies
-    auto x = code::EliasDelta::decode(src) - 1;
-    while(x < MAX_NUM_SYMBOLS) {
-        freqs[x] = code::Binary::decode(src, prob_bits) + 1;
-        x += code::EliasDelta::decode(src) - 1;
-    }
-
-    // compute cumulative frequencies
+    uint32_t freqs[MAX_NUM_SYMBOLS];
     uint32_t cum_freqs[MAX_NUM_SYMBOLS + 1];
-    rans_internal::compute_cumulative_freqs(freqs, cum_freqs);
-
-    // already normalized
-    auto const prob_scale = 1U << prob_bits;
-    assert(cum_freqs[MAX_NUM_SYMBOLS] == prob_scale);
-
-    // brute-force (but fast) cumulative to symbol table
-    auto cum2sym = std::make_unique<uint8_t[]>(prob_scale);
-    for(size_t x = 0; x < MAX_NUM_SYMBOLS; x++) {
-        for(size_t i = cum_freqs[x]; i < cum_freqs[x+1]; i++) {
-            cum2sym[i] = x;
-        }
-    }
+    rans_internal::decode_freqs(src, freqs, cum_freqs, prob_bits);
+    auto const cum2sym = rans_internal::cum_to_sym(cum_freqs, prob_bits);
 
     // initialize rANS symbols
     RansDecSymbol dsyms[MAX_NUM_SYMBOLS];
@@ -193,9 +198,7 @@ void rans_decode(Src& src, size_t const n, Out out, uint32_t const prob_bits = 1
     auto const num_dec_bytes = code::Binary::decode(src, code::Universe(n));
     assert(num_dec_bytes < n);
     auto buffer = std::make_unique<uint8_t[]>(num_dec_bytes);
-    for(size_t i = 0; i < num_dec_bytes; i++) {
-        buffer[i] = code::Binary::decode(src, rans_internal::BYTE_BITS);
-    }
+    read_fixed(src, buffer.get(), num_dec_bytes, rans_internal::BYTE_BITS);
 
     // initialize state
     uint8_t* p = buffer.get();
@@ -211,3 +214,106 @@ void rans_decode(Src& src, size_t const n, Out out, uint32_t const prob_bits = 1
     }
 }
 
+// rANS using multiple interleaved states, where the i-th symbol is coded using state (i mod ways)
+// the states are independent except for sharing the byte stream, so decoding exposes instruction-level parallelism
+// unlike rans_encode, the number of encoded bytes is not bounded by n, so it is encoded using an Elias-delta code
+template<size_t ways = 4, iopp::BitSink Sink>
+void rans_encode_interleaved(Sink& sink, uint8_t const* data, size_t const n, uint32_t const prob_bits = 14) {
+    static_assert(ways > 0);
+    assert(prob_bits >= 8);
+    static constexpr auto MAX_NUM_SYMBOLS = rans_internal::MAX_NUM_SYMBOLS;
+
+    // count, normalize and encode frequencies
+    uint32_t freqs[MAX_NUM_SYMBOLS];
+    uint32_t cum_freqs[MAX_NUM_SYMBOLS + 1];
+    rans_internal::encode_freqs(sink, data, n, freqs, cum_freqs, prob_bits);
+
+    // initialize rANS symbols
+    RansEncSymbol esyms[MAX_NUM_SYMBOLS];
+    for(size_t x = 0; x < MAX_NUM_SYMBOLS; x++) {
+        RansEncSymbolInit(&esyms[x], cum_freqs[x], freqs[x], prob_bits);
+    }
+
+    // initialize states
+    RansState states[ways];
+    for(size_t j = 0; j < ways; j++) {
+        RansEncInit(&states[j]);
+    }
+
+    // encode data in reverse
+    // each symbol needs at most prob_bits + 8 bits, and each state is flushed using 4 bytes
+    auto const capacity = n * ((prob_bits + 15) / 8) + 4 * ways;
+    auto buffer = std::make_unique<uint8_t[]>(capacity);
+    uint8_t* const end = buffer.get() + capacity;
+    uint8_t* p = end;
+
+    for(size_t i = n; i > 0; i--) {
+        RansEncPutSymbol(&states[(i - 1) % ways], &p, &esyms[data[i - 1]]);
+    }
+    for(size_t j = ways; j > 0; j--) {
+        RansEncFlush(&states[j - 1], &p);
+    }
+
+    // emit
+    auto const num_enc_bytes = size_t(end - p);
+    assert(p >= buffer.get());
+    code::EliasDelta::encode(sink, num_enc_bytes + 1);
+    write_fixed(sink, p, num_enc_bytes, rans_internal::BYTE_BITS);
+}
+
+template<size_t ways = 4, iopp::BitSource Src>
+void rans_decode_interleaved(Src& src, size_t const n, uint8_t* out, uint32_t const prob_bits = 14) {
+    static_assert(ways > 0);
+    assert(prob_bits >= 8);
+    static constexpr auto MAX_NUM_SYMBOLS = rans_internal::MAX_NUM_SYMBOLS;
+
+    // decode frequencies
+    uint32_t freqs[MAX_NUM_SYMBOLS];
+    uint32_t cum_freqs[MAX_NUM_SYMBOLS + 1];
+    rans_internal::decode_freqs(src, freqs, cum_freqs, prob_bits);
+    auto const cum2sym = rans_internal::cum_to_sym(cum_freqs, prob_bits);
+
+    // initialize rANS symbols
+    RansDecSymbol dsyms[MAX_NUM_SYMBOLS];
+    for(size_t x = 0; x < MAX_NUM_SYMBOLS; x++) {
+        RansDecSymbolInit(&dsyms[x], cum_freqs[x], freqs[x]);
+    }
+
+    // initialize buffer
+    auto const num_dec_bytes = code::EliasDelta::decode(src) - 1;
+    auto buffer = std::make_unique<uint8_t[]>(num_dec_bytes);
+    read_fixed(src, buffer.get(), num_dec_bytes, rans_internal::BYTE_BITS);
+
+    // initialize states
+    uint8_t* p = buffer.get();
+
+    RansState states[ways];
+    for(size_t j = 0; j < ways; j++) {
+        RansDecInit(&states[j], &p);
+    }
+
+    // decode full rounds
+    // the state updates of a round are independent, only the renormalizations must happen in order, because they share the byte stream
+    size_t const num_rounds = n / ways;
+    for(size_t r = 0; r < num_rounds; r++) {
+        uint8_t* const round_out = out + r * ways;
+        for(size_t j = 0; j < ways; j++) {
+            round_out[j] = cum2sym[RansDecGet(&states[j], prob_bits)];
+        }
+        for(size_t j = 0; j < ways; j++) {
+            RansDecAdvanceSymbolStep(&states[j], &dsyms[round_out[j]], prob_bits);
+        }
+        for(size_t j = 0; j < ways; j++) {
+            RansDecRenorm(&states[j], &p);
+        }
+    }
+
+    // decode remainder
+    for(size_t i = num_rounds * ways; i < n; i++) {
+        auto& state = states[i % ways];
+        auto const x = cum2sym[RansDecGet(&state, prob_bits)];
+        out[i] = x;
+        RansDecAdvanceSymbol(&state, &p, &dsyms[x], prob_bits);
+    }
+    assert(p == buffer.get() + num_dec_bytes);
+}
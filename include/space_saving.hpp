@@ -1,13 +1,19 @@
 #pragma once
 
 #include <algorithm>
+#include <bit>
 #include <cassert>
 #include <concepts>
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <vector>
+
+#include <iopp/concepts.hpp>
 
 #include "always_inline.hpp"
+#include "debug_output.hpp"
+#include "huge_pages.hpp"
 #include "linked_list.hpp"
 
 template <typename T>
@@ -50,7 +56,7 @@ private:
     size_t beg_;
     size_t end_;
 
-    std::unique_ptr<List[]> buckets_;
+    ArrayPtr<List> buckets_;
     Index threshold_;
 
     Index max_allowed_frequency_;
@@ -70,7 +76,7 @@ private:
         }
 
         // compact buckets
-        auto compacted_buckets = std::make_unique<List[]>(max_allowed_frequency_ + 1);
+        auto compacted_buckets = make_array<List>(max_allowed_frequency_ + 1);
 
         for (size_t f = 0; f <= max_allowed_frequency_; f++)
         {
@@ -112,7 +118,7 @@ public:
         assert(max_allowed_frequency_ > 1);
 
         // initialize buckets
-        buckets_ = std::make_unique<List[]>(max_allowed_frequency_ + 1);
+        buckets_ = make_array<List>(max_allowed_frequency_ + 1);
     }
 
     SpaceSaving(SpaceSaving &&) = default;
@@ -133,7 +139,7 @@ public:
         min_frequency_ = other.min_frequency_;
         num_renormalize_ = 0;
 
-        buckets_ = std::make_unique<List[]>(max_allowed_frequency_ + 1);
+        buckets_ = make_array<List>(max_allowed_frequency_ + 1);
         for (Index f = 0; f <= max_allowed_frequency_; f++)
         {
             buckets_[f] = other.buckets_[f];
@@ -353,11 +359,84 @@ public:
         }
     }
 
+    // writes the threshold, the item frequencies and the exact contents of all buckets
+    template <iopp::BitSink Out>
+    void encode_snapshot(Out &out) const
+    {
+        auto const freq_bits = std::bit_width(size_t(max_allowed_frequency_));
+        auto const num_bits = std::bit_width(size_t(end_ - beg_ + 1));
+        auto const item_bits = std::bit_width(size_t(end_ - beg_));
+
+        out.write(threshold_, freq_bits);
+        for (Index i = beg_; i <= end_; i++)
+        {
+            out.write(items_[i].freq(), freq_bits);
+        }
+
+        for (size_t f = 0; f <= max_allowed_frequency_; f++)
+        {
+            auto const &bucket = buckets_[f];
+            out.write(!bucket.empty());
+            if (!bucket.empty())
+            {
+                out.write(bucket.size(items_), num_bits);
+                for (auto v = bucket.front(); v != NIL; v = items_[v].next())
+                {
+                    out.write(v - beg_, item_bits);
+                }
+            }
+        }
+    }
+
+    // restores a snapshot written by encode_snapshot
+    // nb: the buckets are rebuilt in the exact same order, so that the restored structure behaves exactly like the original one
+    template <iopp::BitSource In>
+    void decode_snapshot(In &in)
+    {
+        auto const freq_bits = std::bit_width(size_t(max_allowed_frequency_));
+        auto const num_bits = std::bit_width(size_t(end_ - beg_ + 1));
+        auto const item_bits = std::bit_width(size_t(end_ - beg_));
+
+        threshold_ = in.read(freq_bits);
+        for (Index i = beg_; i <= end_; i++)
+        {
+            items_[i].freq(in.read(freq_bits));
+        }
+
+        std::vector<Index> bucket_items;
+        for (size_t f = 0; f <= max_allowed_frequency_; f++)
+        {
+            auto &bucket = buckets_[f];
+            bucket.clear();
+
+            if (in.read())
+            {
+                size_t const num = in.read(num_bits);
+                bucket_items.clear();
+                for (size_t j = 0; j < num; j++)
+                {
+                    bucket_items.push_back(beg_ + Index(in.read(item_bits)));
+                }
+
+                for (auto it = bucket_items.rbegin(); it != bucket_items.rend(); ++it)
+                {
+                    bucket.push_front(items_, *it);
+                }
+            }
+        }
+    }
+
     Index threshold() const ALWAYS_INLINE
     {
         return threshold_;
     }
 
+    // the frequency of the given item, which is at least the threshold
+    Index frequency(Index const v) const ALWAYS_INLINE
+    {
+        return std::max(items_[v].freq(), threshold_);
+    }
+
     Index bucket_size(Index const f) const
     {
         return buckets_[f].size(items_);
@@ -418,19 +497,19 @@ public:
     void print_snapshot() const
     {
         print_debug_info();
-        std::cout << "#           bucket population:" << std::endl;
+        *DebugOutput::stream << "#           bucket population:" << std::endl;
         for (size_t f = 0; f <= max_allowed_frequency_; f++)
         {
             auto sz = buckets_[f].size(items_);
             if (sz > 0)
             {
-                std::cout << "#           " << f << " -> " << sz << " (product: " << (f * sz) << ")" << std::endl;
+                *DebugOutput::stream << "#           " << f << " -> " << sz << " (product: " << (f * sz) << ")" << std::endl;
             }
         }
     }
 
     void print_debug_info() const
     {
-        std::cout << "# DEBUG: space-saving << threshold=" << threshold_ << ", num_renormalize=" << num_renormalize_ << std::endl;
+        *DebugOutput::stream << "# DEBUG: space-saving << threshold=" << threshold_ << ", num_renormalize=" << num_renormalize_ << std::endl;
     }
 };
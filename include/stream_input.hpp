@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string_view>
+
+#include <unistd.h>
+
+// single-pass input from a file descriptor (e.g., a pipe) of unknown length, read in chunks of bounded size
+class StreamInput {
+private:
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 1ULL << 20;
+
+    int fd_;
+    size_t chunk_size_;
+    std::unique_ptr<char[]> buffer_;
+    size_t pos_;       // the current position in the buffer
+    size_t len_;       // the number of valid characters in the buffer
+    size_t remaining_; // the number of characters that may still be read (prefix)
+    uint64_t num_read_;
+
+    // reads up to max characters into the given buffer, returns zero if the end of the stream was reached
+    size_t read_some(char* buffer, size_t const max) {
+        while(remaining_ > 0) {
+            auto const r = ::read(fd_, buffer, std::min(max, remaining_));
+            if(r > 0) {
+                remaining_ -= (size_t)r;
+                return (size_t)r;
+            } else if(r == 0) {
+                break;
+            } else if(errno != EINTR) {
+                std::cerr << "failed to read input stream: " << std::strerror(errno) << std::endl;
+                std::abort();
+            }
+        }
+        remaining_ = 0;
+        return 0;
+    }
+
+    // reads the next chunk, returns false if the end of the stream was reached
+    bool fill() {
+        pos_ = 0;
+        len_ = read_some(buffer_.get(), chunk_size_);
+        return len_ > 0;
+    }
+
+    bool exhausted() {
+        return pos_ == len_ && !fill();
+    }
+
+public:
+    class Iterator {
+    private:
+        StreamInput* in_; // nullptr denotes the end
+
+        bool at_end() const {
+            return in_ == nullptr || in_->exhausted();
+        }
+
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using difference_type = std::ptrdiff_t;
+        using value_type = char;
+        using pointer = char const*;
+        using reference = char;
+
+        // returned by the postfix increment, holds the character read
+        struct Proxy {
+            char c;
+            char operator*() const { return c; }
+        };
+
+        Iterator() : in_(nullptr) {
+        }
+
+        Iterator(StreamInput& in) : in_(&in) {
+        }
+
+        char operator*() const {
+            in_->exhausted(); // make sure that the buffer is filled
+            return in_->buffer_[in_->pos_];
+        }
+
+        Iterator& operator++() {
+            ++in_->pos_;
+            ++in_->num_read_;
+            return *this;
+        }
+
+        Proxy operator++(int) {
+            Proxy p { **this };
+            ++*this;
+            return p;
+        }
+
+        bool operator==(Iterator const& other) const {
+            return at_end() == other.at_end();
+        }
+    };
+
+    StreamInput(int const fd, size_t const prefix = SIZE_MAX, size_t const chunk_size = DEFAULT_CHUNK_SIZE)
+        : fd_(fd), chunk_size_(chunk_size), buffer_(std::make_unique<char[]>(chunk_size)), pos_(0), len_(0), remaining_(prefix), num_read_(0) {
+    }
+
+    StreamInput(StreamInput const&) = delete;
+    StreamInput& operator=(StreamInput const&) = delete;
+
+    Iterator begin() { return Iterator(*this); }
+    Iterator end() { return Iterator(); }
+
+    // returns the next (up to) n characters without consuming them, e.g., to inspect a header
+    // fewer characters are returned only if the stream ends before
+    std::string_view peek(size_t const n) {
+        assert(n <= chunk_size_);
+        if(len_ - pos_ < n) {
+            // move the buffered characters to the front and read more
+            std::memmove(buffer_.get(), buffer_.get() + pos_, len_ - pos_);
+            len_ -= pos_;
+            pos_ = 0;
+            while(len_ < n) {
+                auto const r = read_some(buffer_.get() + len_, chunk_size_ - len_);
+                if(r == 0) break;
+                len_ += r;
+            }
+        }
+        return std::string_view(buffer_.get() + pos_, std::min(n, len_ - pos_));
+    }
+
+    // the number of characters consumed so far
+    uint64_t num_read() const { return num_read_; }
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+
+#include <unistd.h>
+
+// output to a file descriptor (e.g., stdout), written in chunks of bounded size
+// nb: the file descriptor is not closed, it is owned by whoever opened it
+class StreamOutput : public std::ostream {
+private:
+    class Buffer : public std::streambuf {
+    private:
+        int fd_;
+        std::unique_ptr<char[]> buffer_;
+        size_t chunk_size_;
+
+        // writes the buffered characters
+        void drain() {
+            char const* p = pbase();
+            size_t len = pptr() - pbase();
+            while(len > 0) {
+                auto const r = ::write(fd_, p, len);
+                if(r >= 0) {
+                    p += r;
+                    len -= (size_t)r;
+                } else if(errno != EINTR) {
+                    std::cerr << "failed to write output stream: " << std::strerror(errno) << std::endl;
+                    std::abort();
+                }
+            }
+            setp(buffer_.get(), buffer_.get() + chunk_size_);
+        }
+
+    protected:
+        virtual int_type overflow(int_type const c) override {
+            drain();
+            if(!traits_type::eq_int_type(c, traits_type::eof())) {
+                *pptr() = traits_type::to_char_type(c);
+                pbump(1);
+            }
+            return traits_type::not_eof(c);
+        }
+
+        virtual int sync() override {
+            drain();
+            return 0;
+        }
+
+    public:
+        Buffer(int const fd, size_t const chunk_size) : fd_(fd), buffer_(std::make_unique<char[]>(chunk_size)), chunk_size_(chunk_size) {
+            setp(buffer_.get(), buffer_.get() + chunk_size_);
+        }
+
+        ~Buffer() {
+            drain();
+        }
+    };
+
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 1ULL << 20;
+
+    Buffer buf_;
+
+public:
+    StreamOutput(int const fd, size_t const chunk_size = DEFAULT_CHUNK_SIZE) : std::ostream(nullptr), buf_(fd, chunk_size) {
+        rdbuf(&buf_);
+    }
+
+    StreamOutput(StreamOutput const&) = delete;
+    StreamOutput& operator=(StreamOutput const&) = delete;
+};
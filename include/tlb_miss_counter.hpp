@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// counts data TLB load misses of the calling thread and all threads it creates afterwards using a hardware performance counter
+// nb: threads that already exist are not included, so the counter must be constructed before the first parallel region (e.g., the OpenMP workers are created)
+// the counter may be unavailable, e.g., in virtual machines or if perf_event_paranoid forbids it
+class TlbMissCounter {
+private:
+    int fd_;
+    uint64_t count_;
+
+public:
+    TlbMissCounter() : fd_(-1), count_(0) {
+        perf_event_attr attr = {};
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.inherit = 1; // nb: reading the counter includes the counts of all inherited counters
+        fd_ = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+
+    ~TlbMissCounter() {
+        if(fd_ >= 0) close(fd_);
+    }
+
+    TlbMissCounter(TlbMissCounter const&) = delete;
+    TlbMissCounter& operator=(TlbMissCounter const&) = delete;
+
+    bool available() const {
+        return fd_ >= 0;
+    }
+
+    void start() {
+        if(available()) {
+            ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    void stop() {
+        if(available()) {
+            ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+            if(read(fd_, &count_, sizeof(count_)) != sizeof(count_)) count_ = 0;
+        }
+    }
+
+    uint64_t count() const {
+        return count_;
+    }
+};
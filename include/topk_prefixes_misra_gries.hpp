@@ -2,32 +2,52 @@
 
 #include <algorithm>
 #include <bit>
+#include <bitset>
 #include <cstddef>
 #include <cstdint>
 #include <iterator>
 #include <functional>
 #include <memory>
+#include <queue>
 #include <random>
+#include <type_traits>
 #include <vector>
 #include <unordered_map>
 
+#include <iopp/concepts.hpp>
+
 #include "always_inline.hpp"
 #include "trie.hpp"
 #include "trie_node.hpp"
 #include "display.hpp"
+#include "flat_trie.hpp"
+#include "lazy_space_saving.hpp"
 #include "space_saving.hpp"
 
-template<std::unsigned_integral TrieNodeIndex = uint32_t>
+// a node of a top-k trie given explicitly, used to (re)build instances (see TopKPrefixesMisraGries::assign)
+struct TopKTrieEntry {
+    size_t parent; // the index of the parent's entry
+    char label;    // the label of the edge from the parent
+    uint64_t freq; // the frequency, relative to the threshold
+};
+
+// if split_nodes_ is set, the trie navigation data (children, parent, label) and the Space-Saving data (frequency and bucket links) are kept
+// in two separate arrays, such that frequency updates do not need to touch the cache lines holding the child arrays
+// if lazy_ is set, frequencies are maintained using LazySpaceSaving, which never renormalizes
+template<std::unsigned_integral TrieNodeIndex = uint32_t, bool split_nodes_ = false, bool lazy_ = false>
 class TopKPrefixesMisraGries {
 private:
     static constexpr bool gather_stats_ = true;
 
-    struct NodeData;
-    static constexpr auto NIL = SpaceSaving<NodeData>::NIL;
+    static constexpr TrieNodeIndex NIL = -1;
+
+    // nb: every input character walks the trie, so fast child lookups are used (see TrieEdgeArray)
+    // nb: the trie churns heavily as nodes get recycled, so the external link arrays are taken from the trie's pool
+    using BaseNode = TrieNode<TrieNodeIndex, true, true>;
 
-    struct NodeData : public TrieNode<TrieNodeIndex> {
-        using Character = TrieNode<TrieNodeIndex>::Character;
-        using Index = TrieNode<TrieNodeIndex>::Index;
+    struct NodeData : public BaseNode {
+        using Character = BaseNode::Character;
+        using Index = BaseNode::Index;
 
     private:
         TrieNodeIndex freq_; // the current frequency
@@ -38,7 +58,7 @@ private:
         NodeData() {
         }
 
-        NodeData(Index v, Character c) : TrieNode<TrieNodeIndex>(v, c), freq_(0), prev_(NIL), next_(NIL) {
+        NodeData(Index v, Character c) : BaseNode(v, c), freq_(0), prev_(NIL), next_(NIL) {
         }
 
         // SpaceSavingItem
@@ -53,12 +73,76 @@ private:
         void next(TrieNodeIndex const x) ALWAYS_INLINE { next_ = x; }
     } __attribute__((packed));
 
+    // the Space-Saving data of a node if nodes are split
+    struct FreqItem {
+        using Index = TrieNodeIndex;
+
+    private:
+        TrieNodeIndex freq_; // the current frequency
+        TrieNodeIndex prev_; // the previous node in frequency order
+        TrieNodeIndex next_; // the next node in frequency order
+        bool leaf_;          // whether the node is a leaf in the trie, mirrored here so that we never need to look at the trie node
+
+    public:
+        FreqItem() : freq_(0), prev_(NIL), next_(NIL), leaf_(true) {
+        }
+
+        // SpaceSavingItem
+        TrieNodeIndex freq() const ALWAYS_INLINE { return freq_; }
+        TrieNodeIndex prev() const ALWAYS_INLINE { return prev_; }
+        TrieNodeIndex next() const ALWAYS_INLINE { return next_; }
+
+        bool is_linked() const ALWAYS_INLINE { return leaf_; }
+
+        void freq(TrieNodeIndex const f) ALWAYS_INLINE { freq_ = f; }
+        void prev(TrieNodeIndex const x) ALWAYS_INLINE { prev_ = x; }
+        void next(TrieNodeIndex const x) ALWAYS_INLINE { next_ = x; }
+
+        void leaf(bool const b) ALWAYS_INLINE { leaf_ = b; }
+    } __attribute__((packed));
+
     using TrieNodeDepth = TrieNodeIndex;
+    using NavNode = std::conditional_t<split_nodes_, BaseNode, NodeData>;
+    using FreqData = std::conditional_t<split_nodes_, FreqItem, NodeData>;
+    using SpaceSavingType = std::conditional_t<lazy_, LazySpaceSaving<FreqData>, SpaceSaving<FreqData>>;
 
     size_t k_;
+    size_t sketch_columns_;
 
-    Trie<NodeData> trie_;
-    SpaceSaving<NodeData> space_saving_;
+    Trie<NavNode> trie_;
+    ArrayPtr<FreqItem> freq_items_; // only used if nodes are split
+    SpaceSavingType space_saving_;
+
+    // the nodes that have been recycled and those that have been given a new child since the last call to reset_changes (see find)
+    // nb: these are filters indexed by the node modulo their size, so they may report nodes that have not changed, but never the opposite
+    static constexpr size_t CHANGE_FILTER_BITS = 4096;
+    std::bitset<CHANGE_FILTER_BITS> recycled_;
+    std::bitset<CHANGE_FILTER_BITS> extended_;
+
+    FreqData* freq_data() {
+        if constexpr(split_nodes_) {
+            return freq_items_.get();
+        } else {
+            return trie_.nodes();
+        }
+    }
+
+    FreqData const& freq_data(TrieNodeIndex const v) const ALWAYS_INLINE {
+        if constexpr(split_nodes_) {
+            return freq_items_[v];
+        } else {
+            return trie_.node(v);
+        }
+    }
+
+    // updates whether a node is a leaf, which is only tracked explicitly if nodes are split
+    void set_leaf(TrieNodeIndex const v, bool const leaf) ALWAYS_INLINE {
+        if constexpr(split_nodes_) freq_items_[v].leaf(leaf);
+    }
+
+    static ArrayPtr<FreqItem> allocate_freq_items(size_t const k) {
+        return split_nodes_ ? make_array<FreqItem>(k) : ArrayPtr<FreqItem>();
+    }
 
     bool insert(TrieNodeIndex const parent, char const label, TrieNodeIndex& out_node) ALWAYS_INLINE {
         TrieNodeIndex v;
@@ -67,25 +151,28 @@ private:
             assert(v < k_);
             assert(v != 0);
 
-            auto& vdata = trie_.node(v);
-            assert(vdata.is_leaf());
-            assert(vdata.freq() <= space_saving_.threshold());
+            assert(trie_.is_leaf(v));
+            assert(space_saving_.frequency(v) == space_saving_.threshold());
 
             // extract from trie
             auto const old_parent = trie_.extract(v);
 
             // old parent may have become a leaf
             if(trie_.is_valid_nonroot(old_parent) && trie_.is_leaf(old_parent)) {
+                set_leaf(old_parent, true);
                 space_saving_.link(old_parent);
             }
 
             // new parent can no longer be a leaf
             if(trie_.is_valid_nonroot(parent) && trie_.is_leaf(parent)) {
                 space_saving_.unlink(parent);
+                set_leaf(parent, false);
             }
 
             // insert into trie with new parent
             trie_.insert_child(v, parent, label);
+            recycled_.set(v % CHANGE_FILTER_BITS);
+            extended_.set(parent % CHANGE_FILTER_BITS);
 
             // now simply increment
             space_saving_.increment(v);
@@ -100,13 +187,17 @@ private:
     }
 
 public:
-    inline TopKPrefixesMisraGries() : k_(0) {
+    static constexpr bool lazy = lazy_;
+
+    inline TopKPrefixesMisraGries() : k_(0), sketch_columns_(0) {
     }
 
     inline TopKPrefixesMisraGries(size_t const k, size_t const sketch_columns, size_t const fp_window_size = 8)
         : trie_(k),
           k_(k),
-          space_saving_(trie_.nodes(), 1, k_ - 1, sketch_columns - 1) {
+          sketch_columns_(sketch_columns),
+          freq_items_(allocate_freq_items(k)),
+          space_saving_(freq_data(), 1, k_ - 1, sketch_columns - 1) {
         
         // initialize all k nodes as orphans in trie
         trie_.fill();
@@ -124,9 +215,16 @@ public:
 
     TopKPrefixesMisraGries& operator=(TopKPrefixesMisraGries const& other) {
         k_ = other.k_;
+        sketch_columns_ = other.sketch_columns_;
         trie_ = other.trie_;
+        recycled_ = other.recycled_;
+        extended_ = other.extended_;
+        if constexpr(split_nodes_) {
+            freq_items_ = make_array<FreqItem>(k_);
+            std::copy(other.freq_items_.get(), other.freq_items_.get() + k_, freq_items_.get());
+        }
         space_saving_ = other.space_saving_;
-        space_saving_.set_items(trie_.nodes());
+        space_saving_.set_items(freq_data());
         return *this;
     }
 
@@ -177,6 +275,16 @@ public:
         return ext;
     }
 
+    // read-only access to the trie topology, e.g., for traversals
+    TrieNodeIndex root() const { return trie_.root(); }
+    auto const& children_of(TrieNodeIndex const v) const { return trie_.children_of(v); }
+
+    // the estimated frequency of the string represented by the given node, i.e., its counter in excess of the current Misra-Gries threshold
+    // nb: counters are renormalized from time to time, so this is relative to the other nodes rather than an absolute count
+    TrieNodeIndex frequency(TrieNodeIndex const v) const {
+        return space_saving_.frequency(v) - space_saving_.threshold();
+    }
+
     // read the string with the given index into the buffer
     TrieNodeDepth get(TrieNodeIndex const index, char* buffer) const {
         return trie_.spell(index, buffer);
@@ -184,8 +292,11 @@ public:
 
     // try to find the string in the trie and report its depth and node
     TrieNodeDepth find(char const* s, size_t const max_len, TrieNodeIndex& out_node) const {
-        auto v = trie_.root();
-        TrieNodeDepth dv = 0;
+        return find(s, max_len, trie_.root(), 0, out_node);
+    }
+
+    // like find, but continues from the given node, which represents the string's prefix of the given depth
+    TrieNodeDepth find(char const* s, size_t const max_len, TrieNodeIndex v, TrieNodeDepth dv, TrieNodeIndex& out_node) const {
         while(dv < max_len) {
             TrieNodeIndex u;
             if(trie_.try_get_child(v, s[dv], u)) {
@@ -200,6 +311,240 @@ public:
         return dv;
     }
 
+    // like find, but for many strings at once
+    // the trie walks are interleaved in groups, prefetching the next node of each walk before advancing the others, such that their cache misses overlap
+    // nb: to use the results after the trie has been changed, call reset_changes right away and look them up again using refind
+    template<size_t group_size_ = 16>
+    void find_many(char const* const* strings, size_t const* max_lens, size_t const num, TrieNodeIndex* out_nodes, TrieNodeDepth* out_depths) const {
+        struct Walk {
+            size_t i;
+            TrieNodeIndex v;
+            TrieNodeDepth d;
+        };
+
+        Walk walks[group_size_];
+        size_t num_active = 0;
+        size_t next = 0;
+        while(num_active < group_size_ && next < num) {
+            walks[num_active++] = Walk { next++, trie_.root(), 0 };
+        }
+
+        while(num_active > 0) {
+            for(size_t j = 0; j < num_active;) {
+                auto& w = walks[j];
+
+                TrieNodeIndex u;
+                if(w.d < max_lens[w.i] && trie_.try_get_child(w.v, strings[w.i][w.d], u)) {
+                    // advance and prefetch the child for the next round
+                    w.v = u;
+                    ++w.d;
+                    trie_.prefetch(u);
+                    ++j;
+                } else {
+                    // this walk is done, replace it by the next string or the last active walk
+                    out_nodes[w.i] = w.v;
+                    out_depths[w.i] = w.d;
+                    if(next < num) {
+                        w = Walk { next++, trie_.root(), 0 };
+                        ++j;
+                    } else {
+                        w = walks[--num_active];
+                    }
+                }
+            }
+        }
+    }
+
+    // forgets about all changes to the trie so far, such that the results of lookups done since can be validated using refind
+    void reset_changes() {
+        recycled_.reset();
+        extended_.reset();
+    }
+
+    // finds a string again, given the node and depth reported by a lookup done before the last call to reset_changes
+    // only insertions change the trie, and only leaves get recycled, so the path to the node is intact unless the node itself has been recycled,
+    // and the string cannot be found any deeper unless the node has been given a new child -- in that case, the lookup continues from the node
+    TrieNodeDepth refind(char const* s, size_t const max_len, TrieNodeIndex const v, TrieNodeDepth const dv, TrieNodeIndex& out_node) const {
+        if(recycled_.test(v % CHANGE_FILTER_BITS)) return find(s, max_len, out_node);
+        if(extended_.test(v % CHANGE_FILTER_BITS)) return find(s, max_len, v, dv, out_node);
+
+        out_node = v;
+        return dv;
+    }
+
+    // merges another instance, constructed with the same parameters, into this one
+    // the tries are united and the frequencies of strings contained in both are added up, then the trie is pruned back to k nodes by repeatedly
+    // evicting a leaf of minimum frequency, which keeps it prefix-closed
+    // like in the merge of Misra-Gries summaries (Agarwal et al., 2012), the largest evicted frequency is then subtracted from all remaining ones,
+    // such that no estimate exceeds the true frequency and the error grows by at most that amount
+    // nb: frequencies are relative to each instance's threshold and may have been renormalized differently, so the merged ones are just as approximate
+    void merge(TopKPrefixesMisraGries const& other) {
+        assert(k_ == other.k_);
+        assert(sketch_columns_ == other.sketch_columns_);
+
+        // unite the tries, numbering the nodes in the order of discovery such that every parent precedes its children
+        std::vector<TopKTrieEntry> entries = { TopKTrieEntry { 0, 0, 0 } };
+        std::vector<size_t> num_children = { 0 };
+        std::unordered_map<uint64_t, size_t> edges; // maps (parent, label) to the child's entry
+        auto unite = [&](TopKPrefixesMisraGries const& summary){
+            std::vector<std::pair<TrieNodeIndex, size_t>> stack = { { summary.root(), 0 } };
+            while(!stack.empty()) {
+                auto const [v, e] = stack.back();
+                stack.pop_back();
+
+                auto const& children = summary.children_of(v);
+                for(size_t i = 0; i < children.size(); i++) {
+                    auto const label = children.label(i);
+                    auto const [it, inserted] = edges.try_emplace((uint64_t(e) << 8) | uint8_t(label), entries.size());
+                    if(inserted) {
+                        entries.push_back(TopKTrieEntry { e, label, 0 });
+                        num_children.push_back(0);
+                        ++num_children[e];
+                    }
+                    entries[it->second].freq += summary.frequency(children[i]);
+                    stack.emplace_back(children[i], it->second);
+                }
+            }
+        };
+        unite(*this);
+        unite(other);
+        edges = {};
+
+        // prune
+        std::vector<bool> evicted(entries.size(), false);
+        uint64_t max_evicted = 0;
+        {
+            using Leaf = std::pair<uint64_t, size_t>;
+            std::priority_queue<Leaf, std::vector<Leaf>, std::greater<Leaf>> leaves;
+            for(size_t e = 1; e < entries.size(); e++) {
+                if(num_children[e] == 0) leaves.emplace(entries[e].freq, e);
+            }
+
+            for(size_t num = entries.size() - 1; num > k_ - 1; num--) {
+                auto const [f, e] = leaves.top();
+                leaves.pop();
+                evicted[e] = true;
+                max_evicted = std::max(max_evicted, f);
+
+                auto const p = entries[e].parent;
+                if(--num_children[p] == 0 && p != 0) leaves.emplace(entries[p].freq, p);
+            }
+        }
+
+        // compact the surviving entries
+        std::vector<size_t> index(entries.size());
+        size_t num = 1;
+        for(size_t e = 1; e < entries.size(); e++) {
+            if(evicted[e]) continue;
+
+            auto& entry = entries[num];
+            entry = entries[e];
+            entry.parent = index[entry.parent];
+            entry.freq -= std::min(entry.freq, max_evicted);
+            index[e] = num++;
+        }
+        entries.resize(num);
+
+        assign(entries);
+    }
+
+    // replaces the contents by the given trie, where the first entry is the root and every parent precedes its children
+    // nb: the nodes are numbered in the order of the entries, and frequencies are capped such that they can be represented
+    void assign(std::vector<TopKTrieEntry> const& entries) {
+        assert(entries.size() <= k_);
+
+        // a fresh instance has all nodes in the garbage, the entries are assigned to them in order
+        TopKPrefixesMisraGries fresh(k_, sketch_columns_);
+        auto const max_freq = uint64_t(sketch_columns_ - 2); // nb: one below the maximum allowed frequency, which could not be linked
+
+        for(TrieNodeIndex v = 1; v < entries.size(); v++) {
+            auto const& entry = entries[v];
+            assert(entry.parent < v);
+
+            fresh.space_saving_.unlink(v);
+            fresh.trie_.attach(v, TrieNodeIndex(entry.parent), entry.label);
+            fresh.freq_data()[v].freq(TrieNodeIndex(std::min(entry.freq, max_freq)));
+        }
+
+        for(TrieNodeIndex v = 1; v < entries.size(); v++) {
+            bool const leaf = fresh.trie_.is_leaf(v);
+            fresh.set_leaf(v, leaf);
+            if(leaf) fresh.space_saving_.link(v);
+        }
+
+        *this = std::move(fresh);
+    }
+
+    // writes the current state to a file in the flat layout (see flat_trie.hpp), which can be restored using load or used read-only via FlatTrieView
+    // the frequencies in the file are relative to the threshold, and the Space-Saving state is kept as the state bit string
+    void save(std::filesystem::path const& path) const {
+        BitWriter state;
+        space_saving_.encode_snapshot(state);
+        write_flat_trie<TrieNodeIndex>(path, trie_, lazy_ ? FlatTrieKind::TOPK_LAZY : FlatTrieKind::TOPK, sketch_columns_, true,
+            [&](TrieNodeIndex const v){ return frequency(v); }, &state);
+    }
+
+    // restores a state written by save
+    static TopKPrefixesMisraGries load(std::filesystem::path const& path) {
+        MemoryMappedFile file(path);
+        FlatTrieView<TrieNodeIndex> view(file.data(), file.size());
+
+        auto const kind = lazy_ ? FlatTrieKind::TOPK_LAZY : FlatTrieKind::TOPK;
+        if(view.kind() != kind) {
+            std::cerr << "flat trie was not written by this kind of top-k data structure" << std::endl;
+            std::abort();
+        }
+
+        TopKPrefixesMisraGries topk(view.size(), view.param());
+        for(TrieNodeIndex v = 1; v < topk.k_; v++) {
+            auto const parent = view.parent(v);
+            if(!topk.trie_.is_nil(parent)) topk.trie_.attach(v, parent, view.label(v));
+        }
+
+        if constexpr(split_nodes_) {
+            for(TrieNodeIndex v = 1; v < topk.k_; v++) topk.set_leaf(v, topk.trie_.is_leaf(v));
+        }
+
+        auto state = view.state();
+        topk.space_saving_.decode_snapshot(state);
+        return topk;
+    }
+
+    // writes a snapshot of the current state, which can be restored into a freshly constructed instance with the same parameters
+    template<iopp::BitSink Out>
+    void encode_snapshot(Out& out) const {
+        auto const node_bits = std::bit_width(k_ - 1);
+        for(TrieNodeIndex v = 1; v < k_; v++) {
+            auto const parent = trie_.parent(v);
+            bool const orphan = trie_.is_nil(parent);
+            out.write(orphan);
+            if(!orphan) {
+                out.write(parent, node_bits);
+                out.write((uint8_t)trie_.node(v).inlabel, 8);
+            }
+        }
+        space_saving_.encode_snapshot(out);
+    }
+
+    // restores a snapshot written by encode_snapshot
+    template<iopp::BitSource In>
+    void decode_snapshot(In& in) {
+        auto const node_bits = std::bit_width(k_ - 1);
+        for(TrieNodeIndex v = 1; v < k_; v++) {
+            bool const orphan = in.read();
+            if(!orphan) {
+                auto const parent = TrieNodeIndex(in.read(node_bits));
+                auto const label = char(in.read(8));
+                trie_.attach(v, parent, label);
+            }
+        }
+
+        if constexpr(split_nodes_) {
+            for(TrieNodeIndex v = 1; v < k_; v++) set_leaf(v, trie_.is_leaf(v));
+        }
+        space_saving_.decode_snapshot(in);
+    }
+
 private:
     template<typename M>
     void get_string_freq_mapping(TrieNodeIndex const v, std::string const& prefix, M& out_map) {
@@ -237,7 +582,7 @@ public:
         space_saving_.print_debug_info();
     }
 
-    using TrieType = Trie<NodeData>;
+    using TrieType = Trie<NavNode>;
 
     TrieType&& trie() {
         return std::move(trie_);
@@ -9,9 +9,13 @@
 #include <limits>
 #include <memory>
 #include <string>
+#include <type_traits>
 
 #include "always_inline.hpp"
+#include "debug_output.hpp"
 #include "display.hpp"
+#include "huge_pages.hpp"
+#include "link_pool.hpp"
 #include "trie_concepts.hpp"
 
 template<trie_node Node>
@@ -19,6 +23,7 @@ class Trie {
 private:
     using Character = typename Node::Character;
     using NodeIndex = typename Node::Index;
+    using LinkAllocator = typename Node::ChildArray::Allocator;
 
 public:
     static constexpr NodeIndex ROOT = 0;
@@ -34,7 +39,8 @@ private:
     NodeIndex capacity_;
     NodeIndex size_;
 
-    std::unique_ptr<Node[]> nodes_;
+    ArrayPtr<Node> nodes_;
+    LinkAllocator links_; // allocates the external link arrays of the nodes' children
 
     #ifndef NDEBUG
     bool is_child_of(NodeIndex const node, NodeIndex const parent) const {
@@ -47,7 +53,7 @@ public:
     }
 
     Trie(NodeIndex const capacity) : capacity_(capacity), size_(1) {
-        nodes_ = std::make_unique<Node[]>(capacity_);
+        nodes_ = make_array<Node>(capacity_);
         for(NodeIndex i = 0; i < capacity_; i++) {
             nodes_[i] = Node(NIL, {});
         }
@@ -63,9 +69,11 @@ public:
     Trie& operator=(Trie const& other) {
         capacity_ = other.capacity_;
         size_ = other.size_;
-        nodes_ = std::make_unique<Node[]>(capacity_);
+        nodes_ = make_array<Node>(capacity_);
+        links_ = LinkAllocator();
         for(NodeIndex i = 0; i < capacity_; i++) {
             nodes_[i] = other.nodes_[i];
+            nodes_[i].children.clone_links(links_);
         }
         return *this;
     }
@@ -84,16 +92,26 @@ public:
         NodeIndex discard;
         assert(!try_get_child(parent, label, discard));
 
-        nodes_[parent].children.insert(label, node);
+        nodes_[parent].children.insert(label, node, links_);
         nodes_[node].parent = parent;
         nodes_[node].inlabel = label;
-        nodes_[node].children.clear();
+        nodes_[node].children.clear(links_);
 
         assert(is_leaf(node));
 
         return nodes_[node];
     }
 
+    // attach a node to the given parent without touching the node's own children, used to restore snapshots
+    void attach(NodeIndex const node, NodeIndex const parent, Character const label) {
+        assert(is_valid_nonroot(node));
+        assert(is_valid(parent));
+
+        nodes_[parent].children.insert(label, node, links_);
+        nodes_[node].parent = parent;
+        nodes_[node].inlabel = label;
+    }
+
     // extract node from trie and return parent
     NodeIndex extract(NodeIndex const node) {
         assert(!is_root(node));
@@ -106,7 +124,7 @@ public:
         if(is_valid(parent)) {
             auto const label = v.inlabel;
             assert(is_child_of(node, parent));
-            nodes_[parent].children.remove(label);
+            nodes_[parent].children.remove(label, links_);
 
             NodeIndex discard;
             assert(!try_get_child(parent, label, discard));
@@ -126,6 +144,13 @@ public:
         return nodes_[node].children.try_get(label, out_child);
     }
 
+    // hints that the given node will be accessed soon
+    void prefetch(NodeIndex const node) const ALWAYS_INLINE {
+        auto const* p = (char const*)&nodes_[node];
+        __builtin_prefetch(p);
+        __builtin_prefetch(p + sizeof(Node) - 1); // nb: a node may span two cache lines
+    }
+
     NodeIndex child_count(NodeIndex const node) const {
         return nodes_[node].children.size();
     }
@@ -166,6 +191,10 @@ public:
         return size_;
     }
 
+    NodeIndex capacity() const {
+        return capacity_;
+    }
+
     Node& node(NodeIndex const v) {
         return nodes_[v];
     }
@@ -213,7 +242,7 @@ public:
             if(v.size() <= Node::ChildArray::inline_size_) ++num_small;
         }
 
-        std::cout << "# DEBUG: trie"
+        *DebugOutput::stream << "# DEBUG: trie"
                   << ", sizeof(Node)=" << sizeof(Node)
                   << ", small_node_size_=" << Node::ChildArray::inline_size_
                   << ", small_node_align_=" << Node::ChildArray::inline_align_
@@ -282,8 +311,12 @@ public:
 
     size_t mem_size() const {
         auto sz = sizeof(Trie) + capacity_ * sizeof(Node);
-        for(size_t v = 0; v < capacity_; v++) {
-            sz += nodes_[v].children.allocated_extra_memory();
+        if constexpr(std::is_same_v<LinkAllocator, HeapLinks<NodeIndex>>) {
+            for(size_t v = 0; v < capacity_; v++) {
+                sz += nodes_[v].children.allocated_extra_memory();
+            }
+        } else {
+            sz += memory_size_of(links_) - sizeof(LinkAllocator);
         }
         return sz;
     }
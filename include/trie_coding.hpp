@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cassert>
+#include <concepts>
+#include <string>
+#include <vector>
+
+#include <code.hpp>
+#include <iopp/concepts.hpp>
+
+// succinct encoding of trie topologies and labels, used to store tries (e.g., topk-twopass and the dictionaries of topk-lz78)
+// the topology is written as balanced parentheses and the labels are Huffman coded, both in depth-first order
+
+// gathers the incoming label of every node in depth-first order, where the root's label is the given one
+template<typename Trie, std::unsigned_integral NodeIndex>
+void gather_labels(Trie const& trie, NodeIndex const v, char const inlabel, std::string& labels) {
+    labels.push_back(inlabel);
+
+    auto const& children = trie.children_of(v);
+    for(size_t i = 0; i < children.size(); i++) {
+        gather_labels(trie, children[i], children.label(i), labels);
+    }
+}
+
+template<typename Trie, std::unsigned_integral NodeIndex, iopp::BitSink Out>
+void encode_topology(Trie const& trie, NodeIndex const v, Out& out) {
+    // balanced parantheses
+    out.write(bool(1));
+
+    auto const& children = trie.children_of(v);
+    for(size_t i = 0; i < children.size(); i++) {
+        encode_topology(trie, children[i], out);
+    }
+
+    out.write(bool(0));
+}
+
+// reads a topology written by encode_topology
+template<iopp::BitSource In>
+std::vector<bool> decode_topology(In& in, size_t const max_nodes, size_t& num_nodes) {
+    std::vector<bool> topology;
+    topology.reserve(2 * max_nodes);
+
+    const bool open_root = in.read();
+    assert(open_root == true); // nb: must at least open the root ...
+
+    topology.push_back(open_root);
+    num_nodes = 1;
+
+    size_t dv = 1;
+    while(dv) {
+        const bool b = in.read();
+        if(b) {
+            // open node
+            ++dv;
+            ++num_nodes;
+        } else {
+            // close node
+            --dv;
+        }
+        topology.push_back(b);
+    }
+
+    assert(topology.size() % 2 == 0);
+    assert(topology.size() / 2 == num_nodes);
+    return topology;
+}
+
+// writes labels using Huffman coding
+template<iopp::BitSink Out>
+void encode_labels(std::string const& labels, Out& out) {
+    code::HuffmanTree<char> huff(labels.begin(), labels.end());
+    huff.encode(out);
+
+    auto table = huff.table();
+    for(auto const c : labels) {
+        code::Huffman::encode(out, uint8_t(c), table);
+    }
+}
+
+// reads the given number of labels written by encode_labels
+template<iopp::BitSource In>
+std::string decode_labels(In& in, size_t const num) {
+    std::string labels;
+    labels.reserve(num);
+
+    code::HuffmanTree<char> huff(in);
+    for(size_t i = 0; i < num; i++) {
+        labels.push_back(code::Huffman::decode(in, huff.root()));
+    }
+    return labels;
+}
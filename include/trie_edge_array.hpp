@@ -6,14 +6,29 @@
 #include <concepts>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <functional>
+#include <limits>
+#include <type_traits>
 #include <utility>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "always_inline.hpp"
+#include "link_pool.hpp"
 
 // mantains an array of trie edges
-template<std::integral Character = char, std::unsigned_integral NodeIndex = uint32_t, std::unsigned_integral Size = uint16_t>
+// if fast_lookup_ is set, label lookups compare all inline labels at once (SSE2 or SWAR) and ranks in the external bitmap are looked up in a stored prefix-popcount table
+// nb: the table makes each array larger by a few bytes, so fast lookups have to be opted in where they pay off (e.g., in top-k tries)
+// if pooled_ is set, the external link arrays are taken from a LinkPool owned by the caller (e.g., the trie), which has to be passed to all modifying operations;
+// in that case, copies are shallow and have to be completed using clone_links
+template<std::integral Character = char, std::unsigned_integral NodeIndex = uint32_t, std::unsigned_integral Size = uint16_t, bool fast_lookup_ = false, bool pooled_ = false>
 class TrieEdgeArray {
+public:
+    using Allocator = std::conditional_t<pooled_, LinkPool<NodeIndex>, HeapLinks<NodeIndex>>;
+
 private:
     static constexpr size_t capacity_for(size_t const n) {
         return (n > 0) ? std::bit_ceil(n) : 0;
@@ -28,9 +43,14 @@ private:
     static_assert((sigma_ % bits_per_pack_) == 0);
     static constexpr size_t num_bit_packs_ = sigma_ / bits_per_pack_;
 
+    struct NoPrefixRanks {};
+    using PrefixRanks = std::conditional_t<fast_lookup_, uint8_t[num_bit_packs_], NoPrefixRanks>;
+    static_assert(sigma_ - bits_per_pack_ <= std::numeric_limits<uint8_t>::max());
+
     struct ExternalArray {
         BitPack ind[num_bit_packs_];
         NodeIndex* links;
+        [[no_unique_address]] PrefixRanks prefix; // if fast_lookup_ is set, the number of bits set in all preceding packs
 
         #ifndef NDEBUG
         // only used for debugging
@@ -46,6 +66,7 @@ private:
         void clear() ALWAYS_INLINE {
             for(size_t i = 0; i < num_bit_packs_; i++) {
                 ind[i] = 0;
+                if constexpr(fast_lookup_) prefix[i] = 0;
             }
         }
 
@@ -53,12 +74,18 @@ private:
             size_t const b = i / bits_per_pack_;
             size_t const j = i % bits_per_pack_;
             ind[b] |= (1ULL << j);
+            if constexpr(fast_lookup_) {
+                for(size_t k = b + 1; k < num_bit_packs_; k++) ++prefix[k];
+            }
         }
 
         void unset(UCharacter const i) ALWAYS_INLINE {
             size_t const b = i / bits_per_pack_;
             size_t const j = i % bits_per_pack_;
             ind[b] &= ~(1ULL << j);
+            if constexpr(fast_lookup_) {
+                for(size_t k = b + 1; k < num_bit_packs_; k++) --prefix[k];
+            }
         }
 
         bool get(UCharacter const i) const ALWAYS_INLINE {
@@ -73,8 +100,12 @@ private:
             size_t r = 0;
             size_t const b = i / bits_per_pack_;
             size_t const j = i % bits_per_pack_;
-            for(size_t i = 0; i < b; i++) {
-                r += std::popcount(ind[i]);
+            if constexpr(fast_lookup_) {
+                r = prefix[b];
+            } else {
+                for(size_t i = 0; i < b; i++) {
+                    r += std::popcount(ind[i]);
+                }
             }
 
             BitPack const mask = std::numeric_limits<BitPack>::max() >> (std::numeric_limits<BitPack>::digits - 1 - j);
@@ -121,11 +152,52 @@ private:
         InlineArray   inl;
     } data_;
 
-    size_t find(Character const label) const ALWAYS_INLINE {
-        if(is_inline()) {
+    // whether the inline labels can be compared at once
+    #ifdef __SSE2__
+    static constexpr size_t inline_compare_width_ = 16;
+    #else
+    static constexpr size_t inline_compare_width_ = 8;
+    #endif
+    static constexpr bool compare_inline_at_once_ = fast_lookup_ && sizeof(Character) == 1 && inline_size_ <= inline_compare_width_ && sizeof(InlineArray) >= inline_compare_width_;
+
+    // finds the index of the given label in the inline array, or size_ if it is not contained
+    size_t find_inline(Character const label) const ALWAYS_INLINE {
+        if constexpr(compare_inline_at_once_) {
+            uint32_t match;
+            #ifdef __SSE2__
+            {
+                // compare 16 bytes at once, the matches beyond the current size are masked out below
+                auto const labels = _mm_loadu_si128((__m128i const*)data_.inl.labels);
+                match = _mm_movemask_epi8(_mm_cmpeq_epi8(labels, _mm_set1_epi8(label)));
+            }
+            #else
+            {
+                // SWAR: find zero bytes in the XOR of the labels with the broadcast label
+                static_assert(std::endian::native == std::endian::little);
+                constexpr uint64_t lo = 0x0101010101010101ULL;
+                constexpr uint64_t hi = 0x8080808080808080ULL;
+
+                uint64_t labels;
+                std::memcpy(&labels, data_.inl.labels, sizeof(labels));
+                auto const x = labels ^ (lo * (uint8_t)label);
+                auto const zero = (x - lo) & ~x & hi; // nb: false positives only occur above the lowest true match
+
+                match = 0;
+                if(zero) match = 1U << (std::countr_zero(zero) / 8);
+            }
+            #endif
+            match &= (1U << size_) - 1;
+            return match ? std::countr_zero(match) : size_;
+        } else {
             NodeIndex found = 0;
             while(found < size_ && data_.inl.labels[found] != label) ++found;
             return found;
+        }
+    }
+
+    size_t find(Character const label) const ALWAYS_INLINE {
+        if(is_inline()) {
+            return find_inline(label);
         } else {
             return data_.ext.get(label) ? data_.ext.rank(label) : size_;
         }
@@ -137,8 +209,10 @@ public:
     }
 
     ~TrieEdgeArray() {
-        if(!is_inline()) {
-            delete[] data_.ext.links;
+        if constexpr(!pooled_) {
+            if(!is_inline()) {
+                delete[] data_.ext.links;
+            }
         }
     }
 
@@ -147,25 +221,40 @@ public:
     }
 
     TrieEdgeArray& operator=(TrieEdgeArray const& other) {
-        clear();
+        if constexpr(pooled_) {
+            // shallow copy, the links are still shared with other until clone_links is called
+            size_ = other.size_;
+            data_ = other.data_;
+        } else {
+            clear();
 
-        size_ = other.size_;
-        data_ = other.data_;
+            size_ = other.size_;
+            data_ = other.data_;
 
-        if(!other.is_inline()) {
-            // deep copy of links
-            data_.ext.links = new NodeIndex[capacity_for(size_)];
-            for(size_t i = 0; i < size_; i++) {
-                data_.ext.links[i] = other.data_.ext.links[i];
+            if(!other.is_inline()) {
+                // deep copy of links
+                data_.ext.links = new NodeIndex[capacity_for(size_)];
+                for(size_t i = 0; i < size_; i++) {
+                    data_.ext.links[i] = other.data_.ext.links[i];
+                }
             }
         }
         return *this;
     }
 
+    // completes a shallow copy by copying the external links into memory allocated from the given pool, no-op if not pooled
+    void clone_links(Allocator& alloc) {
+        if(pooled_ && !is_inline()) {
+            auto const* shared = data_.ext.links;
+            data_.ext.links = alloc.allocate(capacity_for(size_));
+            std::copy(shared, shared + size_, data_.ext.links);
+        }
+    }
+
     TrieEdgeArray(TrieEdgeArray&& other) { size_ = 0; *this = std::move(other); }
     TrieEdgeArray& operator=(TrieEdgeArray&& other) {
         // deallocate children
-        clear();
+        if constexpr(!pooled_) clear();
 
         // copy data
         size_ = other.size_;
@@ -179,14 +268,19 @@ public:
         return *this;
     }
 
-    void clear() ALWAYS_INLINE {
+    void clear(Allocator& alloc) ALWAYS_INLINE {
         if(!is_inline()) {
-            delete[] data_.ext.links;
+            alloc.free(data_.ext.links, capacity_for(size_));
             data_.ext.links = nullptr;
         }
         size_ = 0;
     }
 
+    void clear() requires(!pooled_) {
+        Allocator heap;
+        clear(heap);
+    }
+
     bool is_inline() const ALWAYS_INLINE {
         return size_ <= inline_size_;
     }
@@ -266,14 +360,16 @@ public:
         return false;
     }
 
-    void insert(Character const label, NodeIndex const link) {
+    void insert(Character const label, NodeIndex const link) requires(!pooled_) {
+        Allocator heap;
+        insert(label, link, heap);
+    }
+
+    void insert(Character const label, NodeIndex const link, Allocator& alloc) {
         // possibly allocate slots
-        // nb: because we are only keeping track of the size and assume the capacity to always be its hyperceil,
-        //     we may re-allocate here even though it would not be necessary
-        //     however, if there were many removals, this may also (unknowingly) actually shrink the capacity
-        //     in any event: it's not a bug, it's a feature!
+        // nb: we are only keeping track of the size and the capacity is always its hyperceil (see remove, which shrinks the link array accordingly)
         if(size_ == inline_size_ || (!is_inline() && size_ == capacity_for(size_))) {
-            auto* new_links = new NodeIndex[capacity_for(size_ + 1)];
+            auto* new_links = alloc.allocate(capacity_for(size_ + 1));
             if(is_inline()) {
                 assert(size_ == inline_size_);
 
@@ -299,7 +395,7 @@ public:
             } else {
                 // staying large
                 std::copy(data_.ext.links, data_.ext.links + size_, new_links);
-                delete[] data_.ext.links;
+                alloc.free(data_.ext.links, capacity_for(size_));
             }
             data_.ext.links = new_links;
         }
@@ -324,7 +420,12 @@ public:
         assert(contains(link));
     }
 
-    void remove(Character const label) {
+    void remove(Character const label) requires(!pooled_) {
+        Allocator heap;
+        remove(label, heap);
+    }
+
+    void remove(Character const label, Allocator& alloc) {
         auto const i = find(label);
         if(i < size_) {
             // remove from link array if necessary
@@ -368,12 +469,19 @@ public:
                     assert(j == inline_size_);
                 }
 
-                delete[] data_.ext.links;
+                alloc.free(data_.ext.links, capacity_for(size_ + 1));
 
                 for(size_t j = 0; j < size_; j++) {
                     data_.inl.labels[j] = new_labels[j];
                     data_.inl.links[j] = new_links[j];
                 }
+            } else if(!is_inline() && capacity_for(size_) < capacity_for(size_ + 1)) {
+                // shrink the link array, such that its capacity remains the hyperceil of the size
+                // nb: otherwise, the array would later be freed as one of a smaller capacity, which a pool could never reuse in full
+                auto* new_links = alloc.allocate(capacity_for(size_));
+                std::copy(data_.ext.links, data_.ext.links + size_, new_links);
+                alloc.free(data_.ext.links, capacity_for(size_ + 1));
+                data_.ext.links = new_links;
             }
         } else {
             // "this kid is not my son"
@@ -383,11 +491,10 @@ public:
 
     bool try_get(Character const label, NodeIndex& out_link) const ALWAYS_INLINE {
         if(is_inline()) {
-            for(NodeIndex i = 0; i < size_; i++) {
-                if(data_.inl.labels[i] == label) {
-                    out_link = data_.inl.links[i];
-                    return true;
-                }
+            auto const i = find_inline(label);
+            if(i < size_) {
+                out_link = data_.inl.links[i];
+                return true;
             }
             return false;
         } else {
@@ -5,7 +5,7 @@
 #include "always_inline.hpp"
 #include "trie_edge_array.hpp"
 
-template<std::unsigned_integral NodeIndex = uint32_t>
+template<std::unsigned_integral NodeIndex = uint32_t, bool fast_lookup_ = false, bool pooled_links_ = false>
 struct TrieNode {
     static constexpr NodeIndex NIL = std::numeric_limits<NodeIndex>::max(); // nb: used to denote orphans and is only ever used if orphans are allowed
 
@@ -13,7 +13,7 @@ struct TrieNode {
     using Index = NodeIndex;
     using Size = uint16_t;
 
-    using ChildArray = TrieEdgeArray<Character, Index, Size>;
+    using ChildArray = TrieEdgeArray<Character, Index, Size, fast_lookup_, pooled_links_>;
 
     ChildArray children;
     Character inlabel;
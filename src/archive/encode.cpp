@@ -2,6 +2,17 @@
 
 #include <block_coding.hpp>
 
+// nb: the block stream used to be written without a header, the magic number was added when the byte-alignment flag was added to block streams
+constexpr uint64_t MAGIC =
+    ((uint64_t)'E') << 56 |
+    ((uint64_t)'N') << 48 |
+    ((uint64_t)'C') << 40 |
+    ((uint64_t)'O') << 32 |
+    ((uint64_t)'D') << 24 |
+    ((uint64_t)'E') << 16 |
+    ((uint64_t)'#') << 8 |
+    ((uint64_t)'2');
+
 struct Compressor : public CompressorBase {
     Compressor() : CompressorBase("encode", "Encodes the input as a baseline compressor") {
     }
@@ -15,8 +26,9 @@ struct Compressor : public CompressorBase {
         return ".encode";
     }
 
-    virtual void compress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) override {
+    virtual void compress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) override {
         auto bitout = iopp::bitwise_output_to(out);
+        bitout.write(MAGIC, 64);
 
         BlockEncoder enc(bitout, block_size);
         enc.register_huffman();
@@ -28,13 +40,19 @@ struct Compressor : public CompressorBase {
         enc.flush();
     }
     
-    virtual void decompress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) override {
+    virtual void decompress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) override {
         auto bitin = iopp::bitwise_input_from(in.begin(), in.end());
         auto _out = iopp::StreamOutputIterator(out);
 
+        uint64_t const magic = bitin.read(64);
+        if(magic != MAGIC) {
+            std::cerr << "wrong magic: 0x" << std::hex << magic << " (expected: 0x" << MAGIC << ")" << std::endl;
+            std::abort();
+        }
+
         BlockDecoder dec(bitin);
         dec.register_huffman();
-        while(bitin) {
+        while(dec) {
             *_out++ = dec.read_char(0);
         }
     }
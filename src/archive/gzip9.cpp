@@ -15,7 +15,7 @@ struct Compressor : public Lz77Compressor {
         return ".gzip";
     }
 
-    virtual void factorize(iopp::FileInputStream& in, FactorWriter& out) override {
+    virtual void factorize(MemoryMappedFile const& in, FactorWriter& out) override {
         lz77::Gzip9Factorizer factorizer;
         factorizer.factorize(in.begin(), in.end(), out);
     }
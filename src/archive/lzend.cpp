@@ -14,11 +14,11 @@ struct Compressor : public CompressorBase {
         return ".lzend";
     }
 
-    virtual void compress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) override {
+    virtual void compress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) override {
         lzend::compress(in.begin(), in.end(), iopp::bitwise_output_to(out), block_size, result);
     }
     
-    virtual void decompress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) override {
+    virtual void decompress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) override {
         lzend::decompress(iopp::bitwise_input_from(in.begin(), in.end()), iopp::StreamOutputIterator(out));
     }
 };
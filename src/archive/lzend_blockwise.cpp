@@ -20,11 +20,11 @@ struct Compressor : public CompressorBase {
         return ".lzendblock";
     }
 
-    virtual void compress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) override {
+    virtual void compress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) override {
         topk_lzend::compress<false>(in.begin(), in.end(), iopp::bitwise_output_to(out), window, 1, 1, 1, block_size, result);
     }
     
-    virtual void decompress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) override {
+    virtual void decompress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) override {
         topk_lzend::decompress<false>(iopp::bitwise_input_from(in.begin(), in.end()), iopp::StreamOutputIterator(out));
     }
 };
@@ -25,7 +25,7 @@ void decompress_offline(In in, Out out, uint64_t const expected_magic) {
     
     BlockDecoder dec(in);
     setup_encoding(dec);
-    while(in) {
+    while(dec) {
         auto const q = dec.read_uint(TOK_REF);
         auto const len = (q > 0) ? dec.read_uint(TOK_LEN) : 0;
 
@@ -36,7 +36,7 @@ void decompress_offline(In in, Out out, uint64_t const expected_magic) {
             }
         }
         
-        if(in) {
+        if(dec) {
             auto const c = dec.read_char(TOK_LITERAL);
             factors.push_back(s.length());
             s.push_back(c);
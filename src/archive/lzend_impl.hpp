@@ -21,6 +21,7 @@ constexpr bool PROTOCOL = false;
 constexpr bool TIME_PHASES = false;
 constexpr bool TIME_OPS = false;
 
+// nb: block streams used to begin with the maximum block size only, the magic number was changed when the byte-alignment flag was added
 constexpr uint64_t MAGIC =
     ((uint64_t)'L') << 56 |
     ((uint64_t)'Z') << 48 |
@@ -29,7 +30,7 @@ constexpr uint64_t MAGIC =
     ((uint64_t)'D') << 24 |
     ((uint64_t)'#') << 16 |
     ((uint64_t)'#') << 8 |
-    ((uint64_t)'#');
+    ((uint64_t)'2');
 
 using Index = uint32_t;
 using SIndex = std::make_signed_t<Index>;
@@ -17,6 +17,7 @@
 
 namespace lzend_kk {
 
+// nb: block streams used to begin with the maximum block size only, the magic number was changed when the byte-alignment flag was added
 constexpr uint64_t MAGIC =
     ((uint64_t)'L') << 56 |
     ((uint64_t)'Z') << 48 |
@@ -25,7 +26,7 @@ constexpr uint64_t MAGIC =
     ((uint64_t)'D') << 24 |
     ((uint64_t)'_') << 16 |
     ((uint64_t)'K') << 8 |
-    ((uint64_t)'K');
+    ((uint64_t)'2');
 
 constexpr bool PROTOCOL = false;
 constexpr bool EXTENDED_STATS = false;
@@ -15,7 +15,7 @@ struct Compressor : public CompressorBase {
         return ".rle";
     }
 
-    virtual void compress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) override {
+    virtual void compress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) override {
         using Index = uint32_t;
 
         // read input into RAM
@@ -92,7 +92,7 @@ struct Compressor : public CompressorBase {
         }
     }
     
-    virtual void decompress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) override {
+    virtual void decompress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) override {
         std::abort();
     }
 };
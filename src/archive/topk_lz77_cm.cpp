@@ -25,11 +25,11 @@ struct Compressor : public TopkCompressorCountMin {
         return ".topklz77cm";
     }
 
-    virtual void compress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) override {
-        topk_lz77::compress<Topk>(in.begin(), in.end(), iopp::bitwise_output_to(out), threshold, k, window, sketch_columns, block_size, result);
+    virtual void compress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) override {
+        topk_lz77::compress<Topk>(in.begin(), in.end(), iopp::bitwise_output_to(out), threshold, false, false, k, window, sketch_columns, block_size, false, 1, result);
     }
     
-    virtual void decompress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) override {
+    virtual void decompress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) override {
         topk_lz77::decompress<Topk>(iopp::bitwise_input_from(in.begin(), in.end()), iopp::StreamOutputIterator(out));
     }
 };
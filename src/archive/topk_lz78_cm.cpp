@@ -19,12 +19,12 @@ struct Compressor : public TopkCompressorCountMin {
         return ".topklz78cm";
     }
 
-    virtual void compress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) override {
-        topk_lz78::compress<TopKPrefixesCountMin<>>(in.begin(), in.end(), iopp::bitwise_output_to(out), k, sketch_columns, block_size, result);
+    virtual void compress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) override {
+        topk_lz78::compress<TopKPrefixesCountMin<>>(in.begin(), in.end(), iopp::bitwise_output_to(out), k, sketch_columns, block_size, false, 1, topk_lz78::Dictionary(), result);
     }
     
-    virtual void decompress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) override {
-        topk_lz78::decompress<TopKPrefixesCountMin<>>(iopp::bitwise_input_from(in.begin(), in.end()), iopp::StreamOutputIterator(out));
+    virtual void decompress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) override {
+        topk_lz78::decompress<TopKPrefixesCountMin<>>(iopp::bitwise_input_from(in.begin(), in.end()), iopp::StreamOutputIterator(out), topk_lz78::Dictionary());
     }
 };
 
@@ -20,6 +20,7 @@
 
 namespace topk_lzend {
 
+// nb: block streams used to begin with the maximum block size only, the magic number was changed when the byte-alignment flag was added
 constexpr uint64_t MAGIC =
     ((uint64_t)'T') << 56 |
     ((uint64_t)'O') << 48 |
@@ -28,7 +29,7 @@ constexpr uint64_t MAGIC =
     ((uint64_t)'Z') << 24 |
     ((uint64_t)'E') << 16 |
     ((uint64_t)'N') << 8 |
-    ((uint64_t)'D');
+    ((uint64_t)'2');
 
 constexpr bool PROTOCOL = false;
 constexpr bool DEBUG = false;
@@ -735,7 +736,7 @@ void decompress(In in, Out out) {
 
     BlockDecoder dec(in);
     setup_encoding(dec, k, max_block);
-    while(in) {
+    while(dec) {
         auto const p = dec.read_uint(TOK_REF);
         auto const len = (p > 0) ? dec.read_uint(TOK_LEN) : 0;
         auto const c = dec.read_char(TOK_LITERAL);
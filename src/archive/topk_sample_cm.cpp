@@ -39,11 +39,11 @@ struct Compressor : public CompressorBase {
         return ".topksamplecm";
     }
 
-    virtual void compress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) override {
+    virtual void compress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) override {
         topk_sample::compress<TopKStringsCountMin<>, false>(in.begin(), in.end(), iopp::StreamOutputIterator(out), sample_exp, len_exp_min, len_exp_max, min_dist, k, sketch_rows, sketch_columns, result);
     }
     
-    virtual void decompress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) override {
+    virtual void decompress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) override {
         topk_sample::decompress<TopKStringsCountMin<>, false>(in.begin(), in.end(), iopp::StreamOutputIterator(out));
     }
 };
@@ -7,6 +7,7 @@
 
 namespace topk_sel {
 
+// nb: block streams used to begin with the maximum block size only, the magic number was changed when the byte-alignment flag was added
 constexpr uint64_t MAGIC =
     ((uint64_t)'T') << 56 |
     ((uint64_t)'O') << 48 |
@@ -15,7 +16,7 @@ constexpr uint64_t MAGIC =
     ((uint64_t)'S') << 24 |
     ((uint64_t)'E') << 16 |
     ((uint64_t)'L') << 8 |
-    ((uint64_t)'#');
+    ((uint64_t)'2');
 
 constexpr bool DEBUG = false;
 constexpr bool PROTOCOL = false;
@@ -259,7 +260,7 @@ void decompress(In in, Out out) {
     size_t num_frequent = 0;
     size_t num_literal = 0;
 
-    while(in) {
+    while(dec) {
         auto const p = dec.read_uint(TOK_TRIE_REF);
 
         if(p) {
@@ -3,11 +3,23 @@
 #include <iopp/file_input_stream.hpp>
 #include <iopp/file_output_stream.hpp>
 
+#include <debug_output.hpp>
+#include <huge_pages.hpp>
+#include <memory_mapped_file.hpp>
+#include <stream_input.hpp>
+#include <stream_output.hpp>
+#include <tlb_miss_counter.hpp>
+
 #include <iopp/bitwise_io.hpp>
 #include <iopp/stream_input_iterator.hpp>
 #include <iopp/stream_output_iterator.hpp>
 
 #include <cmath>
+#include <memory>
+#include <ostream>
+#include <string>
+
+#include <unistd.h>
 
 #include <pm/malloc_counter.hpp>
 #include <pm/stopwatch.hpp>
@@ -24,61 +36,129 @@ struct CompressorBase : public ConfigObject {
     uint64_t block_size = 32'768; // best value according to many many experiments
     uint64_t prefix = UINTMAX_MAX;
 
+    bool huge_pages = false;
+    uint64_t numa_node = UINTMAX_MAX;
+
     CompressorBase(std::string&& type_name, std::string&& desc) : ConfigObject(std::move(type_name), std::move(desc)) {
         param('o', "out", output, "The output filename.");
         param('d', "decompress", decompress_flag, "Decompress the input file rather than compressing it.");
         param('b', "block-size", block_size, "The block size for encoding.");
         param('p', "prefix", prefix, "The prefix of the input file to consider.");
+        param("huge-pages", huge_pages, "Back large data structures by transparent huge pages.");
+        param("numa-node", numa_node, "Bind large data structures to the given NUMA node (requires --huge-pages).");
     }
 
     virtual void init_result(pm::Result& result) {
         result.add("block_size", block_size);
+        result.add("huge_pages", huge_pages);
+        if(numa_node != UINTMAX_MAX) result.add("numa_node", numa_node);
     }
 
     virtual std::string file_ext() = 0;
 
-    virtual void compress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) = 0;
+    virtual void compress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) = 0;
+
+    virtual void decompress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) = 0;
+
+    // whether the compressor can compress a stream of unknown length in a single pass (see compress_stream)
+    virtual bool can_stream() {
+        return false;
+    }
 
-    virtual void decompress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) = 0;
+    virtual void compress_stream(StreamInput& in, std::ostream& out, pm::Result& result) {
+        std::cerr << "streaming is not supported" << std::endl;
+        std::abort();
+    }
+
+    // whether the compressor can decompress a stream in a single pass (see decompress_stream)
+    virtual bool can_decompress_stream() {
+        return false;
+    }
+
+    virtual void decompress_stream(StreamInput& in, std::ostream& out, pm::Result& result) {
+        std::cerr << "streaming is not supported" << std::endl;
+        std::abort();
+    }
 
-    int run(Application const& app) {
+    virtual int run(Application const& app) {
         if(!app.args().empty()) {
+            // "-" denotes stdin or stdout, respectively
             input = app.args()[0];
+            bool const from_stdin = (input == "-");
+            if(from_stdin && !(decompress_flag ? can_decompress_stream() : can_stream())) {
+                // nb: we do not silently read the entire stream into memory
+                std::cerr << (decompress_flag ? "decompressing" : "compressing") << " a stream is not supported by this tool, please pass a file" << std::endl;
+                return -1;
+            }
+
             if(output.empty()) {
-                output = input + (decompress_flag ? ".dec" : file_ext());
+                output = from_stdin ? "-" : input + (decompress_flag ? ".dec" : file_ext());
             }
 
+            // when writing the output to stdout, everything else that is printed (including the result) goes to stderr
+            bool const to_stdout = (output == "-");
+            std::ostream& print = to_stdout ? std::cerr : std::cout;
+            DebugOutput::stream = &print;
+
+            HugePages::enabled = huge_pages;
+            HugePages::numa_node = (numa_node != UINTMAX_MAX) ? (int)numa_node : -1;
+
             pm::Result result;
-            result.add("file", std::filesystem::path(input).filename().string());
-            result.add("n", std::min(std::filesystem::file_size(input), prefix));
+            result.add("file", from_stdin ? std::string("stdin") : std::filesystem::path(input).filename().string());
             this->init_result(result);
 
             {
-                iopp::FileInputStream fis(input, 0, prefix);
-                iopp::FileOutputStream fos(output);
+                std::unique_ptr<StreamInput> stream_in;
+                MemoryMappedFile in;
+                if(from_stdin) {
+                    stream_in = std::make_unique<StreamInput>(STDIN_FILENO, prefix);
+                } else {
+                    in = MemoryMappedFile(input, prefix);
+                    result.add("n", in.size());
+                }
+                std::unique_ptr<std::ostream> out;
+                if(to_stdout) {
+                    out = std::make_unique<StreamOutput>(STDOUT_FILENO);
+                } else {
+                    out = std::make_unique<iopp::FileOutputStream>(output);
+                }
 
                 pm::MallocCounter m;
                 m.start();
 
+                TlbMissCounter tlb;
+                tlb.start();
+
                 pm::Stopwatch t;
                 t.start();
 
-                if(decompress_flag) {
-                    decompress(fis, fos, result);
+                if(from_stdin) {
+                    if(decompress_flag) {
+                        decompress_stream(*stream_in, *out, result);
+                    } else {
+                        compress_stream(*stream_in, *out, result);
+                    }
+                    result.add("n", stream_in->num_read());
+                } else if(decompress_flag) {
+                    decompress(in, *out, result);
                 } else {
-                    compress(fis, fos, result);
+                    compress(in, *out, result);
                 }
 
                 t.stop();
                 result.add("time", (uint64_t)std::round(t.elapsed_time_millis()));
 
+                tlb.stop();
+                if(tlb.available()) result.add("mem_tlb", tlb.count());
+
                 m.stop();
                 result.add("mem_peak", m.peak());
+                if(huge_pages) result.add("mem_huge_peak", HugePages::mapped_peak.load());
             }
 
-            result.add("nout", std::filesystem::file_size(output));
+            if(!to_stdout) result.add("nout", std::filesystem::file_size(output));
             result.sort();
-            std::cout << result.str() << std::endl;
+            print << result.str() << std::endl;
             return 0;
         } else {
             app.print_usage(*this);
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <initializer_list>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <write_bytes.hpp>
+
+// framed container format
+//
+// a framed file consists of a header (magic and engine parameters), a sequence of frames and a footer index
+// each frame is an independent bit stream that can be decoded without looking at any other frame
+// the footer index lists, for each frame, its byte offset in the file and the position of its first character in the uncompressed input,
+// followed by the uncompressed length and the number of frames, such that it can be located from the end of the file
+namespace frames {
+
+struct Frame {
+    uint64_t offset; // byte offset of the frame in the framed file
+    uint64_t pos;    // position of the frame's first character in the uncompressed input
+};
+
+// tests whether the given file begins with the given framed magic
+inline bool is_framed(char const* begin, char const* end, uint64_t const magic) {
+    if(end - begin < 8) return false;
+    return read_uint(begin, 8) == magic;
+}
+
+template<std::output_iterator<char> Out>
+class FrameWriter {
+private:
+    Out out_;
+    uint64_t num_bytes_;
+    std::vector<Frame> index_;
+
+    void write(uint64_t const x) {
+        write_uint(out_, x, 8);
+        num_bytes_ += 8;
+    }
+
+public:
+    FrameWriter(Out out, uint64_t const magic, std::initializer_list<uint64_t> params) : out_(out), num_bytes_(0) {
+        write(magic);
+        for(auto const x : params) write(x);
+    }
+
+    // writes the given frame, which begins at the given position of the uncompressed input
+    void write_frame(std::string const& frame, uint64_t const pos) {
+        index_.push_back(Frame { num_bytes_, pos });
+        out_ = std::copy(frame.begin(), frame.end(), out_);
+        num_bytes_ += frame.size();
+    }
+
+    // writes the footer index, n is the total length of the uncompressed input
+    void finish(uint64_t const n) {
+        for(auto const& f : index_) {
+            write(f.offset);
+            write(f.pos);
+        }
+        write(n);
+        write(index_.size());
+    }
+
+    size_t num_frames() const { return index_.size(); }
+};
+
+class FrameReader {
+private:
+    char const* begin_;
+    uint64_t index_offset_;
+    uint64_t n_;
+
+    std::vector<uint64_t> params_;
+    std::vector<Frame> index_;
+
+public:
+    FrameReader(char const* begin, char const* end, uint64_t const magic, size_t const num_params) : begin_(begin) {
+        auto const size = uint64_t(end - begin);
+        if(size < 8 * (3 + num_params)) {
+            std::cerr << "truncated framed file" << std::endl;
+            std::abort();
+        }
+
+        // header
+        char const* p = begin;
+        auto const file_magic = read_uint(p, 8);
+        if(file_magic != magic) {
+            std::cerr << "wrong magic: 0x" << std::hex << file_magic << " (expected: 0x" << magic << ")" << std::dec << std::endl;
+            std::abort();
+        }
+
+        params_.reserve(num_params);
+        for(size_t i = 0; i < num_params; i++) params_.push_back(read_uint(p, 8));
+
+        // footer
+        p = end - 16;
+        n_ = read_uint(p, 8);
+        auto const num_frames = read_uint(p, 8);
+
+        auto const index_size = 16 * num_frames;
+        if(size < 8 * (3 + num_params) + index_size) {
+            std::cerr << "truncated frame index" << std::endl;
+            std::abort();
+        }
+
+        index_offset_ = size - 16 - index_size;
+        p = begin + index_offset_;
+        index_.reserve(num_frames);
+        for(size_t i = 0; i < num_frames; i++) {
+            Frame f;
+            f.offset = read_uint(p, 8);
+            f.pos = read_uint(p, 8);
+            index_.push_back(f);
+        }
+    }
+
+    uint64_t param(size_t const i) const { return params_[i]; }
+
+    // the length of the uncompressed input
+    uint64_t length() const { return n_; }
+
+    size_t num_frames() const { return index_.size(); }
+
+    char const* frame_begin(size_t const i) const { return begin_ + index_[i].offset; }
+    char const* frame_end(size_t const i) const { return begin_ + (i + 1 < index_.size() ? index_[i + 1].offset : index_offset_); }
+
+    // the position of the frame's first character in the uncompressed input
+    uint64_t frame_pos(size_t const i) const { return index_[i].pos; }
+
+    // the number of uncompressed characters in the frame
+    uint64_t frame_length(size_t const i) const { return (i + 1 < index_.size() ? index_[i + 1].pos : n_) - index_[i].pos; }
+
+    // finds the frame containing the given position of the uncompressed input
+    size_t frame_containing(uint64_t const pos) const {
+        auto it = std::upper_bound(index_.begin(), index_.end(), pos, [](uint64_t const x, Frame const& f){ return x < f.pos; });
+        return it == index_.begin() ? 0 : size_t(it - index_.begin()) - 1;
+    }
+
+    // decodes the characters in the range [a, b) of the uncompressed input
+    // decode_frame(i, buffer) must append the uncompressed contents of the i-th frame to the buffer
+    // up to num_threads frames are decoded concurrently, each into its own buffer, and then emitted in order
+    template<std::output_iterator<char> Out, typename DecodeFrame>
+    void decode_range(uint64_t a, uint64_t b, Out out, DecodeFrame decode_frame, size_t const num_threads = 1) const {
+        b = std::min(b, n_);
+        if(a >= b) return;
+
+        auto const first = frame_containing(a);
+        auto last = first;
+        while(last < num_frames() && frame_pos(last) < b) ++last;
+
+        std::vector<std::string> buffers(std::max(num_threads, size_t(1)));
+        for(size_t batch = first; batch < last; batch += buffers.size()) {
+            auto const batch_size = std::min(buffers.size(), last - batch);
+
+            #pragma omp parallel for num_threads(batch_size) schedule(dynamic, 1)
+            for(size_t j = 0; j < batch_size; j++) {
+                auto const i = batch + j;
+                auto& buffer = buffers[j];
+                buffer.clear();
+                buffer.reserve(frame_length(i));
+                decode_frame(i, buffer);
+            }
+
+            // emit the parts of the frames that lie within the range
+            for(size_t j = 0; j < batch_size; j++) {
+                auto const& buffer = buffers[j];
+                auto const pos = frame_pos(batch + j);
+                auto const from = std::max(a, pos) - pos;
+                auto const to = std::min(b, pos + buffer.size()) - pos;
+                out = std::copy(buffer.begin() + from, buffer.begin() + to, out);
+            }
+        }
+    }
+};
+
+}
@@ -20,15 +20,10 @@ struct Compressor : public Lz77Compressor {
         return ".lpf";
     }
 
-    virtual void factorize(iopp::FileInputStream& in, FactorWriter& out) override {
-        // fully read file into RAM
-        std::string s;
-        s.reserve(std::filesystem::file_size(input));
-        std::copy(in.begin(), in.end(), std::back_inserter(s));
-
+    virtual void factorize(MemoryMappedFile const& in, FactorWriter& out) override {
         lz77::LPFFactorizer factorizer;
         factorizer.min_reference_length(threshold);
-        factorizer.factorize(s.begin(), s.end(), out);
+        factorizer.factorize(in.begin(), in.end(), out);
     }
 };
 
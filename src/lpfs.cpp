@@ -23,12 +23,7 @@ struct Compressor : public Lz77Compressor {
         return ".lpfs";
     }
 
-    virtual void factorize(iopp::FileInputStream& in, FactorWriter& out) override {
-        // fully read file into RAM
-        std::string s;
-        s.reserve(std::filesystem::file_size(input));
-        std::copy(in.begin(), in.end(), std::back_inserter(s));
-
+    virtual void factorize(MemoryMappedFile const& in, FactorWriter& out) override {
         LPFSemiExternalFactorizer factorizer;
         factorizer.min_reference_length(threshold);
 
@@ -37,7 +32,7 @@ struct Compressor : public Lz77Compressor {
             factorizer.isa_path(input + ".isa5");
         }
 
-        factorizer.factorize(s.begin(), s.end(), out, keep_index);
+        factorizer.factorize(in.begin(), in.end(), out, keep_index);
     }
 };
 
@@ -6,16 +6,19 @@
 struct Compressor : public CompressorBase {
     uint64_t window = 1_Mi;
     unsigned int threshold = 2;
+    bool sliding = false;
 
     Compressor() : CompressorBase("lz77-blockwise", "Blockwise LZ77 compression") {
         param('w', "window", window, "The window size.");
         param('t', "threshold", threshold, "The minimum reference length");
+        param("sliding", sliding, "Factorize each block against the previous and the current block, allowing references into the previous block.");
     }
 
     virtual void init_result(pm::Result& result) override {
         result.add("algo", "lz77-blockwise");
         result.add("window", window);
         result.add("threshold", threshold);
+        result.add("sliding", sliding);
         
         CompressorBase::init_result(result);
     }
@@ -24,11 +27,27 @@ struct Compressor : public CompressorBase {
         return ".lz77block";
     }
 
-    virtual void compress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) override {
-        lz77_blockwise::compress(in.begin(), in.end(), iopp::bitwise_output_to(out), threshold, window, block_size, result);
+    virtual void compress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) override {
+        lz77_blockwise::compress(in.begin(), in.end(), iopp::bitwise_output_to(out), threshold, sliding, window, block_size, result);
+    }
+
+    virtual bool can_stream() override {
+        return true;
+    }
+
+    virtual void compress_stream(StreamInput& in, std::ostream& out, pm::Result& result) override {
+        lz77_blockwise::compress(in.begin(), in.end(), iopp::bitwise_output_to(out), threshold, sliding, window, block_size, result);
     }
     
-    virtual void decompress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) override {
+    virtual void decompress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) override {
+        lz77_blockwise::decompress(iopp::bitwise_input_from(in.begin(), in.end()), iopp::StreamOutputIterator(out));
+    }
+
+    virtual bool can_decompress_stream() override {
+        return true;
+    }
+
+    virtual void decompress_stream(StreamInput& in, std::ostream& out, pm::Result& result) override {
         lz77_blockwise::decompress(iopp::bitwise_input_from(in.begin(), in.end()), iopp::StreamOutputIterator(out));
     }
 };
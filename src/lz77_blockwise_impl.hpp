@@ -1,9 +1,14 @@
+#include <cstring>
+
 #include <lz77/lpf_factorizer.hpp>
 
 #include <block_coding.hpp>
+#include <debug_output.hpp>
+#include <lpf_array.hpp>
 
 namespace lz77_blockwise {
 
+// nb: block streams used to begin with the maximum block size only and there was no sliding mode, the magic number was changed when the byte-alignment and sliding flags were added
 constexpr uint64_t MAGIC =
     ((uint64_t)'L') << 56 |
     ((uint64_t)'Z') << 48 |
@@ -11,8 +16,8 @@ constexpr uint64_t MAGIC =
     ((uint64_t)'7') << 32 |
     ((uint64_t)'B') << 24 |
     ((uint64_t)'L') << 16 |
-    ((uint64_t)'C') << 8 |
-    ((uint64_t)'K');
+    ((uint64_t)'K') << 8 |
+    ((uint64_t)'2');
 
 using Index = uint32_t;
 
@@ -21,7 +26,9 @@ constexpr bool PROTOCOL = false;
 // nb: we use different token types to encode references
 // the first token of any phrase is always the length:
 // - a length of one indicates a literal character
-// - otherwise, we have a block-local LZ77 factor of the corresponding length
+// - otherwise, we have an LZ77 factor of the corresponding length, whose source is given as the distance back from the current position
+// the distance is relative to the window that the block was factorized in: that is the current block alone,
+// or, in sliding mode (see --sliding), the previous block followed by the current one, so sources may reach back into the previous block
 constexpr TokenType TOK_FACT_SRC = 0;
 constexpr TokenType TOK_FACT_LEN = 1;
 constexpr TokenType TOK_LITERAL = 2;
@@ -29,15 +36,15 @@ constexpr TokenType TOK_FACT_REMAINDER = 3;
 
 constexpr size_t MAX_LZ_REF_LEN = 255;
 
-void setup_encoding(BlockEncodingBase& enc, size_t const window_size) {
-    enc.register_binary(window_size-1); // TOK_FACT_SRC
+void setup_encoding(BlockEncodingBase& enc, size_t const window_size, bool const sliding) {
+    enc.register_binary((sliding ? 2 * window_size : window_size) - 1); // TOK_FACT_SRC
     enc.register_huffman();             // TOK_FACT_LEN
     enc.register_binary(255, false);    // TOK_FACT_LITERAL
     enc.register_binary(window_size, false); // TOK_FACT_REMAINDER
 }
 
 template<iopp::InputIterator<char> In, iopp::BitSink Out>
-void compress(In begin, In const& end, Out out, size_t const threshold, size_t const window_size, size_t const block_size, pm::Result& result) {
+void compress(In begin, In const& end, Out out, size_t const threshold, bool const sliding, size_t const window_size, size_t const block_size, pm::Result& result) {
     // init stats
     size_t num_ref = 0;
     size_t num_trie = 0;
@@ -49,9 +56,10 @@ void compress(In begin, In const& end, Out out, size_t const threshold, size_t c
     // write header and initialize encoding
     out.write(MAGIC, 64);
     out.write(window_size, 64);
+    out.write(sliding);
 
     BlockEncoder enc(out, block_size);
-    setup_encoding(enc, window_size);
+    setup_encoding(enc, window_size, sliding);
 
     // initialize factorizer
     lz77::LPFFactorizer lpf;
@@ -59,8 +67,11 @@ void compress(In begin, In const& end, Out out, size_t const threshold, size_t c
     std::vector<lz77::Factor> factors;
 
     // initialize buffers
+    // nb: in sliding mode, the previous block is kept directly before the current block
     auto block_offs = 0;
-    auto block = std::make_unique<char[]>(window_size);
+    auto buffer = std::make_unique<char[]>(sliding ? 2 * window_size : window_size);
+    auto* block = buffer.get() + (sliding ? window_size : 0);
+    Index history = 0;
 
     while(begin != end) {
         // read next block
@@ -71,7 +82,11 @@ void compress(In begin, In const& end, Out out, size_t const threshold, size_t c
 
         // compute the LZ77 factorization of the block
         factors.clear();
-        lpf.factorize(block.get(), block.get() + block_num, std::back_inserter(factors));
+        if(sliding) {
+            factorize_with_history(block - history, block, block + block_num, threshold, std::back_inserter(factors));
+        } else {
+            lpf.factorize(block, block + block_num, std::back_inserter(factors));
+        }
 
         // encode the block
         Index curpos = 0;
@@ -84,7 +99,7 @@ void compress(In begin, In const& end, Out out, size_t const threshold, size_t c
                 ++num_literal;
             } else {
                 auto const fpos = curpos;
-                assert(fpos >= f.src);
+                assert(fpos + history >= f.src);
 
                 if(f.len >= MAX_LZ_REF_LEN) {
                     // encode the maximum length, then encode the rest as a special token
@@ -107,6 +122,11 @@ void compress(In begin, In const& end, Out out, size_t const threshold, size_t c
 
         // advance
         block_offs += block_num;
+        if(sliding) {
+            // nb: all blocks but the last are full
+            std::memcpy(buffer.get(), block, block_num);
+            history = window_size;
+        }
     }
     enc.flush();
 
@@ -130,16 +150,20 @@ void decompress(In in, Out out) {
     }
 
     auto const window_size = in.read(64);
+    bool const sliding = in.read();
 
     // initialize decoding
     BlockDecoder dec(in);
-    setup_encoding(dec, window_size);
+    setup_encoding(dec, window_size, sliding);
 
-    auto block = std::make_unique<char[]>(window_size);
+    // nb: in sliding mode, the previous block is kept directly before the current block
+    auto buffer = std::make_unique<char[]>(sliding ? 2 * window_size : window_size);
+    auto* block = buffer.get() + (sliding ? window_size : 0);
+    size_t history = 0;
     auto block_offs = 0;
     size_t curpos = 0;
 
-    while(in) {
+    while(dec) {
         auto const len = dec.read_uint(TOK_FACT_LEN);
         size_t phrase_len;
 
@@ -149,23 +173,24 @@ void decompress(In in, Out out) {
             auto const c = dec.read_char(TOK_LITERAL);
             block[curpos] = c;
             phrase_len = 1;
-            if constexpr(PROTOCOL) std::cout << "pos=" << gpos << ": literal " << display(c) << std::endl;
+            if constexpr(PROTOCOL) *DebugOutput::stream << "pos=" << gpos << ": literal " << display(c) << std::endl;
         } else {
             phrase_len = len;
 
-            // a block-local LZ77 reference
+            // an LZ77 reference, the source is the distance back within the window, i.e., it may reach into the previous block in sliding mode
             if(len == MAX_LZ_REF_LEN) {
                 // this factor may be even longer, decode remainder
                 phrase_len += dec.read_uint(TOK_FACT_REMAINDER);
             }
 
             auto const src = dec.read_uint(TOK_FACT_SRC);
-            assert(curpos >= src);
-            auto const srcpos = curpos - src;
+            assert(curpos + history >= src);
+            auto* dst = block + curpos;
+            auto const* srcp = dst - src;
             for(size_t i = 0; i < phrase_len; i++) {
-                block[curpos + i] = block[srcpos + i];
+                dst[i] = srcp[i];
             }
-            if constexpr(PROTOCOL) std::cout << "pos=" << gpos << ": lz (" << src << ", " << phrase_len << ")" << std::endl;
+            if constexpr(PROTOCOL) *DebugOutput::stream << "pos=" << gpos << ": lz (" << src << ", " << phrase_len << ")" << std::endl;
         }
 
         // advance
@@ -176,6 +201,10 @@ void decompress(In in, Out out) {
             for(size_t i = 0; i < window_size; i++) {
                 *out++ = block[i];
             }
+            if(sliding) {
+                std::memcpy(buffer.get(), block, window_size);
+                history = window_size;
+            }
             curpos = 0;
             block_offs += window_size;
         }
@@ -47,9 +47,9 @@ struct Lz77Compressor : public CompressorBase {
     Lz77Compressor(std::string&& type_name, std::string&& desc) : CompressorBase(std::move(type_name), std::move(desc)) {
     }
 
-    virtual void factorize(iopp::FileInputStream& in, FactorWriter& out) = 0;
+    virtual void factorize(MemoryMappedFile const& in, FactorWriter& out) = 0;
 
-    virtual void compress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) override {
+    virtual void compress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) override {
         // initialize encoding
         auto bitout = iopp::bitwise_output_to(out);
         bitout.write(lzlike::MAGIC, 64);
@@ -94,7 +94,15 @@ struct Lz77Compressor : public CompressorBase {
         result.add("phrases_avg_dist", (uint64_t)std::round((double)total_ref_dist / (double)num_ref));
     }
     
-    virtual void decompress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) override {
+    virtual void decompress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) override {
+        lzlike::decompress(iopp::bitwise_input_from(in.begin(), in.end()), iopp::StreamOutputIterator(out));
+    }
+
+    virtual bool can_decompress_stream() override {
+        return true;
+    }
+
+    virtual void decompress_stream(StreamInput& in, std::ostream& out, pm::Result& result) override {
         lzlike::decompress(iopp::bitwise_input_from(in.begin(), in.end()), iopp::StreamOutputIterator(out));
     }
 };
@@ -14,11 +14,27 @@ struct Compressor : public CompressorBase {
         return ".lz78";
     }
 
-    virtual void compress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) override {
+    virtual void compress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) override {
+        lz78::compress(in.begin(), in.end(), iopp::bitwise_output_to(out), block_size, result);
+    }
+
+    virtual bool can_stream() override {
+        return true;
+    }
+
+    virtual void compress_stream(StreamInput& in, std::ostream& out, pm::Result& result) override {
         lz78::compress(in.begin(), in.end(), iopp::bitwise_output_to(out), block_size, result);
     }
     
-    virtual void decompress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) override {
+    virtual void decompress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) override {
+        lz78::decompress(iopp::bitwise_input_from(in.begin(), in.end()), iopp::StreamOutputIterator(out));
+    }
+
+    virtual bool can_decompress_stream() override {
+        return true;
+    }
+
+    virtual void decompress_stream(StreamInput& in, std::ostream& out, pm::Result& result) override {
         lz78::decompress(iopp::bitwise_input_from(in.begin(), in.end()), iopp::StreamOutputIterator(out));
     }
 };
@@ -7,6 +7,7 @@
 
 namespace lz78 {
 
+// nb: block streams used to begin with the maximum block size only, the magic number was changed when the byte-alignment flag was added
 constexpr uint64_t MAGIC =
     ((uint64_t)'L') << 56 |
     ((uint64_t)'Z') << 48 |
@@ -15,7 +16,7 @@ constexpr uint64_t MAGIC =
     ((uint64_t)'F') << 24 |
     ((uint64_t)'U') << 16 |
     ((uint64_t)'L') << 8 |
-    ((uint64_t)'L');
+    ((uint64_t)'2');
 
 constexpr TokenType TOK_TRIE_REF = 0;
 constexpr TokenType TOK_LITERAL = 1;
@@ -104,11 +105,11 @@ void decompress(In in, Out out) {
 
     BlockDecoder dec(in);
     setup_encoding(dec);
-    while(in) {
+    while(dec) {
         auto const f = dec.read_uint(TOK_TRIE_REF);
         decode(f);
 
-        if(in) {
+        if(dec) {
             auto const c = dec.read_char(TOK_LITERAL);
             s.push_back(c);
             factors.emplace_back(f, c);
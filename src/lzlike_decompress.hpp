@@ -4,9 +4,11 @@
 #include <iopp/concepts.hpp>
 
 #include <block_coding.hpp>
+#include <debug_output.hpp>
 
 namespace lzlike {
 
+// nb: block streams used to begin with the maximum block size only, the magic number was changed when the byte-alignment flag was added
 constexpr uint64_t MAGIC =
     ((uint64_t)'L') << 56 |
     ((uint64_t)'Z') << 48 |
@@ -15,7 +17,7 @@ constexpr uint64_t MAGIC =
     ((uint64_t)'L') << 24 |
     ((uint64_t)'I') << 16 |
     ((uint64_t)'K') << 8 |
-    ((uint64_t)'E');
+    ((uint64_t)'2');
 
 constexpr bool DEBUG = false;
 
@@ -44,7 +46,7 @@ void decompress(In in, Out out) {
 
     BlockDecoder dec(in);
     setup_encoding(dec);
-    while(in) {
+    while(dec) {
         auto len = dec.read_uint(TOK_LEN);
         if(len > 0) {
             ++num_ref;
@@ -52,7 +54,7 @@ void decompress(In in, Out out) {
             auto const src = dec.read_uint(TOK_SRC);
             assert(src > 0);
 
-            if constexpr(DEBUG) std::cout << s.length() << ": REFERENCE (" << src << ", " << len << ")" << std::endl;            
+            if constexpr(DEBUG) *DebugOutput::stream << s.length() << ": REFERENCE (" << src << ", " << len << ")" << std::endl;            
 
             auto const i = s.length();
             assert(i >= src);
@@ -63,7 +65,7 @@ void decompress(In in, Out out) {
             ++num_literal;
 
             auto const c = dec.read_char(TOK_LITERAL);
-            if constexpr(DEBUG) std::cout << s.length() << ": LITERAL " << display(c) << std::endl;
+            if constexpr(DEBUG) *DebugOutput::stream << s.length() << ": LITERAL " << display(c) << std::endl;
 
             s.push_back(c);
         }
@@ -51,8 +51,7 @@ int main(int argc, char** argv) {
             {
                 auto a = text.alloc_size();
                 r.add("alloc", a.total());
-                r.add("alloc_parent", a.parent);
-                r.add("alloc_inlabel", a.inlabel);
+                r.add("alloc_trie", a.trie);
                 r.add("alloc_parsing", a.parsing);
                 r.add("alloc_literal", a.literal);
                 r.add("alloc_start", a.start);
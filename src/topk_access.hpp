@@ -4,7 +4,7 @@
 #include <filesystem>
 #include <iterator>
 
-#include <iopp/file_input_stream.hpp>
+#include <memory_mapped_file.hpp>
 #include <ordered/btree/set.hpp>
 #include <ordered/range_marking/set.hpp>
 #include <word_packing.hpp>
@@ -12,6 +12,7 @@
 #include <bv/bit_rank.hpp>
 #include <bv/rrr.hpp>
 #include <idiv_ceil.hpp>
+#include <louds_trie.hpp>
 #include <small_trie.hpp>
 
 class TopKAccess {
@@ -21,9 +22,7 @@ private:
 
     size_t n_;
     size_t k_;
-    std::unique_ptr<Pack[]> parent_;
-    size_t bits_per_parent_;
-    std::unique_ptr<char[]> inlabel_;
+    LoudsTrie trie_;
     size_t height_;
     word_packing::PackedIntVector<Pack> parsing_;
     RRR<0> literal_; // FIXME: we don't need rank on literal_
@@ -134,21 +133,11 @@ private:
     };
 
     size_t spell_reverse(size_t const node, char* buffer) const {
-        auto parent = word_packing::accessor(parent_.get(), bits_per_parent_);
-        
-        size_t dv = 0;
-        size_t v = node;
-        while(v) {
-            buffer[dv++] = inlabel_[v];
-            v = parent[v];
-        }
-        return dv;
+        return trie_.spell_reverse(node, buffer);
     }
 
     size_t spell(size_t const node, char* buffer) const {
-        auto const d = spell_reverse(node, buffer);
-        std::reverse(buffer, buffer + d);
-        return d;
+        return trie_.spell(node, buffer);
     }
 
 public:
@@ -167,18 +156,21 @@ public:
         word_packing::BitVector start;
         start.resize(n_);
 
-        iopp::FileInputStream in(path);
+        MemoryMappedFile in(path);
 
         // compute trie
         auto trie = topk_twopass::compute_topk(in.begin(), in.end(), k, k >> 8);
 
+        // compute succinct trie, which renumbers the nodes
+        std::vector<size_t> node_ids;
+        trie_ = LoudsTrie(trie, &node_ids);
+
         // compute parsing and mark phrase starts
         num_literals_ = 0;
         size_t i = 0;
         height_ = 0;
 
         word_packing::BitVector literal;
-        in.seekg(0, std::ios::beg);
         topk_twopass::parse(in.begin(), in.end(), trie, [&](topk_twopass::Phrase f) {
             height_ = std::max(height_, f.len);
 
@@ -188,7 +180,7 @@ public:
                 ++num_literals_;
             } else {
                 literal.push_back(0);
-                parsing_.push_back(f.node);
+                parsing_.push_back(node_ids[f.node]);
             }
 
             start[i] = 1;
@@ -199,17 +191,7 @@ public:
         parsing_.shrink_to_fit();
         literal_ = RRR<0>(literal.data(), literal.size());
 
-        // compute parent/inlabel arrays and discard trie
-        bits_per_parent_ = std::bit_width(k-1);
-        parent_ = std::make_unique<Pack[]>(word_packing::num_packs_required<Pack>(k, bits_per_parent_));
-        auto parent = word_packing::accessor(parent_.get(), bits_per_parent_);
-        inlabel_ = std::make_unique<char[]>(k);
-        for(size_t v = 1; v < k; v++) {
-            auto const& node = trie.node(v);
-            parent[v] = node.parent;
-            inlabel_[v] = node.inlabel;
-        }
-
+        // discard trie
         trie = decltype(trie)();
 
         // compress start and compute rank
@@ -273,16 +255,14 @@ public:
     }
 
     struct AllocSize {
-        size_t parent;
-        size_t inlabel;
+        size_t trie;
         size_t parsing;
         size_t literal;
         size_t start;
         size_t start_rank;
 
         AllocSize(TopKAccess const& topk) {
-            parent = word_packing::num_packs_required<Pack>(topk.k_, topk.bits_per_parent_) * sizeof(Pack);
-            inlabel = topk.k_ * sizeof(char);
+            trie = topk.trie_.mem_size();
             parsing = word_packing::num_packs_required<Pack>(topk.parsing_.capacity(), topk.parsing_.width()) * sizeof(Pack);
             literal = topk.literal_.alloc_size();
             start = topk.start_.alloc_size();
@@ -290,7 +270,7 @@ public:
         }
 
         size_t total() const {
-            return parent + inlabel + parsing + literal + start + start_rank;
+            return trie + parsing + literal + start + start_rank;
         }
     };
 
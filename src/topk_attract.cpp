@@ -14,11 +14,11 @@ struct Compressor : public TopkCompressor {
         return ".topkattract";
     }
 
-    virtual void compress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) override {
+    virtual void compress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) override {
         topk_attract::compress(in.begin(), in.end(), iopp::bitwise_output_to(out), k, max_freq, block_size, result);
     }
     
-    virtual void decompress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) override {
+    virtual void decompress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) override {
         std::abort();
     }
 };
@@ -16,3 +16,43 @@ struct TopkCompressor : public CompressorBase {
         result.add("max_freq", max_freq);
     }
 };
+
+// a top-k compressor that can optionally write a framed container of independently decodable frames
+struct FramedTopkCompressor : public TopkCompressor {
+    uint64_t frame_size = 0;
+    std::string range;
+    unsigned int threads = 1;
+    bool align_blocks = false;
+
+    FramedTopkCompressor(std::string&& type_name, std::string&& desc) : TopkCompressor(std::move(type_name), std::move(desc)) {
+        param('f', "frame-size", frame_size, "If nonzero, write a framed container with a new frame after (roughly) this many input characters.");
+        param("range", range, "When decompressing a framed container, only decode the characters in the given range a:b (exclusive).");
+        param('j', "threads", threads, "The number of threads to use; when compressing, full blocks are entropy coded concurrently to parsing, and when decompressing a framed container, frames are decoded concurrently.");
+        param("align-blocks", align_blocks, "Pad each encoded block to a byte boundary and append a block index, such that blocks can be located without decoding.");
+    }
+
+    virtual void init_result(pm::Result& result) override {
+        TopkCompressor::init_result(result);
+        result.add("frame_size", frame_size);
+        result.add("threads", threads);
+        result.add("align_blocks", align_blocks);
+    }
+
+    // parses the range to decode, if any
+    void decode_range(uint64_t& a, uint64_t& b) const {
+        a = 0;
+        b = UINT64_MAX;
+        if(!range.empty()) {
+            auto const sep = range.find(':');
+            if(sep == std::string::npos) {
+                std::cerr << "invalid range: " << range << " (expected: a:b)" << std::endl;
+                std::abort();
+            }
+
+            auto const sa = range.substr(0, sep);
+            auto const sb = range.substr(sep + 1);
+            if(!sa.empty()) a = std::stoull(sa);
+            if(!sb.empty()) b = std::stoull(sb);
+        }
+    }
+};
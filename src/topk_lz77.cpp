@@ -5,31 +5,82 @@
 
 using Topk = TopKPrefixesMisraGries<>;
 
-struct Compressor : public TopkCompressor {
+struct Compressor : public FramedTopkCompressor {
     uint64_t window = 1_Mi;
     unsigned int threshold = 2;
+    bool optimal = false;
+    bool sliding = false;
 
-    Compressor() : TopkCompressor("topk-lz77", "Best of both worlds approach to blockwise LZ77 and top-k LZ78.") {
+    Compressor() : FramedTopkCompressor("topk-lz77", "Best of both worlds approach to blockwise LZ77 and top-k LZ78.") {
         param('w', "window", window, "The window size.");
         param('t', "threshold", threshold, "The minimum reference length");
+        param("sliding", sliding, "Factorize each block against the previous and the current block, allowing references into the previous block.");
+        param("optimal", optimal, "Parse each block such that its estimated encoded size is minimal rather than greedily (slower).");
     }
 
     virtual void init_result(pm::Result& result) override {
         result.add("algo", "topk-lz77");
-        TopkCompressor::init_result(result);
+        FramedTopkCompressor::init_result(result);
         result.add("window", window);
         result.add("threshold", threshold);
+        result.add("optimal", optimal);
+        result.add("sliding", sliding);
     }
 
     virtual std::string file_ext() override {
         return ".topklz77";
     }
 
-    virtual void compress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) override {
-        topk_lz77::compress<Topk>(in.begin(), in.end(), iopp::bitwise_output_to(out), threshold, k, window, max_freq, block_size, result);
+    template<typename Input>
+    void compress_input(Input& in, std::ostream& out, pm::Result& result) {
+        if(frame_size > 0) {
+            topk_lz77::compress_framed<Topk>(in.begin(), in.end(), iopp::StreamOutputIterator(out), threshold, optimal, sliding, k, window, max_freq, block_size, align_blocks, std::max(threads, 1U), frame_size, result);
+        } else {
+            topk_lz77::compress<Topk>(in.begin(), in.end(), iopp::bitwise_output_to(out), threshold, optimal, sliding, k, window, max_freq, block_size, align_blocks, std::max(threads, 1U), result);
+        }
+    }
+
+    virtual void compress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) override {
+        compress_input(in, out, result);
+    }
+
+    virtual bool can_stream() override {
+        return true;
+    }
+
+    virtual void compress_stream(StreamInput& in, std::ostream& out, pm::Result& result) override {
+        compress_input(in, out, result);
     }
     
-    virtual void decompress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) override {
+    virtual void decompress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) override {
+        if(frames::is_framed(in.begin(), in.end(), topk_lz77::FRAMED_MAGIC)) {
+            uint64_t a, b;
+            decode_range(a, b);
+            topk_lz77::decompress_framed<Topk>(in.begin(), in.end(), iopp::StreamOutputIterator(out), a, b, std::max(threads, 1U));
+        } else {
+            if(!range.empty()) {
+                std::cerr << "decoding a range requires a framed container (see --frame-size)" << std::endl;
+                std::abort();
+            }
+            topk_lz77::decompress<Topk>(iopp::bitwise_input_from(in.begin(), in.end()), iopp::StreamOutputIterator(out));
+        }
+    }
+
+    virtual bool can_decompress_stream() override {
+        return true;
+    }
+
+    // nb: the frames of a framed container are located via its footer index, so it cannot be decoded in a single pass
+    virtual void decompress_stream(StreamInput& in, std::ostream& out, pm::Result& result) override {
+        auto const header = in.peek(8);
+        if(frames::is_framed(header.data(), header.data() + header.size(), topk_lz77::FRAMED_MAGIC)) {
+            std::cerr << "framed containers cannot be decompressed from a stream, please pass a file" << std::endl;
+            std::abort();
+        }
+        if(!range.empty()) {
+            std::cerr << "decoding a range requires a framed container (see --frame-size)" << std::endl;
+            std::abort();
+        }
         topk_lz77::decompress<Topk>(iopp::bitwise_input_from(in.begin(), in.end()), iopp::StreamOutputIterator(out));
     }
 };
@@ -1,14 +1,25 @@
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstring>
+
 #include <display.hpp>
 
 #include <lz77/lpf_factorizer.hpp>
 
 #include <block_coding.hpp>
+#include <debug_output.hpp>
+#include <idiv_ceil.hpp>
+#include <lpf_array.hpp>
 #include <pm/result.hpp>
 
 #include <valgrind.hpp>
 
+#include "frames.hpp"
+
 namespace topk_lz77 {
 
+// nb: block streams used to begin with the maximum block size only and there was no sliding mode, the magic number was changed when the byte-alignment and sliding flags were added
 constexpr uint64_t MAGIC =
     ((uint64_t)'T') << 56 |
     ((uint64_t)'O') << 48 |
@@ -17,18 +28,39 @@ constexpr uint64_t MAGIC =
     ((uint64_t)'F') << 24 |
     ((uint64_t)'A') << 16 |
     ((uint64_t)'C') << 8 |
-    ((uint64_t)'T');
+    ((uint64_t)'2');
+
+constexpr uint64_t FRAMED_MAGIC =
+    ((uint64_t)'T') << 56 |
+    ((uint64_t)'O') << 48 |
+    ((uint64_t)'P') << 40 |
+    ((uint64_t)'K') << 32 |
+    ((uint64_t)'F') << 24 |
+    ((uint64_t)'A') << 16 |
+    ((uint64_t)'C') << 8 |
+    ((uint64_t)'F');
 
 using Index = uint32_t;
 using Node = Index;
 
 constexpr bool PROTOCOL = false;
 
+// the number of positions looked up in a batch (see encode)
+constexpr size_t PREFETCH_GROUP = 16;
+
+// in optimal parsing, all LZ77 reference lengths up to this are considered at each position, longer references only at their full length
+constexpr size_t OPTIMAL_NICE_LEN = 64;
+
+// in optimal parsing, the number of times the shortest paths are computed per block, each time using costs estimated from the previous path
+constexpr size_t OPTIMAL_PASSES = 3;
+
 // nb: we use different token types to encode references
 // the first token of any phrase is always the length:
 // - a length of zero indicates a top-k trie reference
 // - a length of one indicates a literal character
-// - otherwise, we have a block-local LZ77 factor of the corresponding length
+// - otherwise, we have an LZ77 factor of the corresponding length, whose source is given as the distance back from the current position
+// the distance is relative to the window that the block was factorized in: that is the current block alone,
+// or, in sliding mode (see --sliding), the previous block followed by the current one, so sources may reach back into the previous block
 constexpr TokenType TOK_TRIE_REF = 0;
 constexpr TokenType TOK_FACT_SRC = 1;
 constexpr TokenType TOK_FACT_LEN = 2;
@@ -37,17 +69,119 @@ constexpr TokenType TOK_FACT_REMAINDER = 4;
 
 constexpr size_t MAX_LZ_REF_LEN = 255;
 
-void setup_encoding(BlockEncodingBase& enc, size_t const k, size_t const window_size) {
-    enc.register_binary(k-1);           // TOK_TRIE_REF
-    enc.register_binary(window_size-1); // TOK_FACT_SRC
-    enc.register_huffman();             // TOK_FACT_LEN
-    enc.register_binary(255, false);    // TOK_FACT_LITERAL
+void setup_encoding(BlockEncodingBase& enc, size_t const k, size_t const window_size, bool const sliding) {
+    enc.register_adaptive(k-1);             // TOK_TRIE_REF
+    enc.register_adaptive((sliding ? 2 * window_size : window_size) - 1); // TOK_FACT_SRC
+    enc.register_adaptive(MAX_LZ_REF_LEN);  // TOK_FACT_LEN
+    enc.register_adaptive(255);             // TOK_FACT_LITERAL
     enc.register_binary(window_size, false); // TOK_FACT_REMAINDER
 }
 
-template<typename Topk, iopp::InputIterator<char> In, iopp::BitSink Out>
-void compress(In begin, In const& end, Out out, size_t const threshold, size_t const k, size_t const window_size, size_t const max_freq, size_t const block_size, pm::Result& result) {
-    // init stats
+// the context of a literal at the given position of a block for context mixing, i.e., the (up to) two preceding characters
+inline TokenContext literal_context(char const* block, size_t const pos) {
+    TokenContext ctx = 0;
+    if(pos >= 1) ctx |= uint8_t(block[pos - 1]);
+    if(pos >= 2) ctx |= TokenContext(uint8_t(block[pos - 2])) << 8;
+    return ctx;
+}
+
+// a block of input along with its LZ77 factorization
+// for optimal parsing, we instead keep the longest previous factor at each position, along with the distance to its source
+struct Block {
+    std::unique_ptr<char[]> data;
+    Index size;
+    std::vector<lz77::Factor> factors;
+    std::unique_ptr<Index[]> lpf;
+    std::unique_ptr<Index[]> dist;
+};
+
+// estimates the encoded size of tokens, in 1/COST_SCALE bits, from the frequencies of tokens counted before, e.g., those written for the previous block
+// lengths and literals are modelled per symbol, trie references and LZ77 sources by their bit width, plus the remaining bits verbatim
+// nb: this mimics the Huffman codes built for these tokens, but is not exact, because token blocks do not coincide with input blocks
+class CostModel {
+private:
+    static constexpr size_t NUM_WIDTHS = 65;
+
+    std::array<uint32_t, MAX_LZ_REF_LEN + 1> len_freq_;
+    std::array<uint32_t, 256> literal_freq_;
+    std::array<uint32_t, NUM_WIDTHS> ref_freq_;
+    std::array<uint32_t, NUM_WIDTHS> src_freq_;
+
+    std::array<uint32_t, MAX_LZ_REF_LEN + 1> len_cost_;
+    std::array<uint32_t, 256> literal_cost_;
+    std::array<uint32_t, NUM_WIDTHS> ref_cost_;
+    std::array<uint32_t, NUM_WIDTHS> src_cost_;
+    uint32_t remainder_cost_;
+
+    template<size_t N>
+    static void costs(std::array<uint32_t, N> const& freq, std::array<uint32_t, N>& cost) {
+        // nb: every symbol is counted once more than it occurred, so unseen symbols get a finite cost
+        double total = 0;
+        for(auto const f : freq) total += f + 1;
+        for(size_t i = 0; i < N; i++) cost[i] = uint32_t(std::lround(COST_SCALE * std::log2(total / double(freq[i] + 1))));
+    }
+
+    static size_t width(uintmax_t const x) { return std::bit_width(x); }
+
+public:
+    static constexpr uint32_t COST_SCALE = 256;
+
+    CostModel(size_t const window_size) : remainder_cost_(COST_SCALE * std::bit_width(window_size)) {
+        len_freq_.fill(0);
+        literal_freq_.fill(0);
+        ref_freq_.fill(0);
+        src_freq_.fill(0);
+        update();
+    }
+
+    // computes the token costs from the frequencies counted so far, and resets the frequencies
+    void update() {
+        costs(len_freq_, len_cost_);
+        costs(literal_freq_, literal_cost_);
+        costs(ref_freq_, ref_cost_);
+        costs(src_freq_, src_cost_);
+
+        for(size_t w = 1; w < NUM_WIDTHS; w++) {
+            ref_cost_[w] += COST_SCALE * (w - 1);
+            src_cost_[w] += COST_SCALE * (w - 1);
+        }
+
+        len_freq_.fill(0);
+        literal_freq_.fill(0);
+        ref_freq_.fill(0);
+        src_freq_.fill(0);
+    }
+
+    uint32_t trie_ref(Node const v) const {
+        return len_cost_[0] + ref_cost_[width(v)];
+    }
+
+    uint32_t literal(char const c) const {
+        return len_cost_[1] + literal_cost_[uint8_t(c)];
+    }
+
+    uint32_t lz_ref(size_t const len, size_t const dist) const {
+        return (len >= MAX_LZ_REF_LEN ? len_cost_[MAX_LZ_REF_LEN] + remainder_cost_ : len_cost_[len]) + src_cost_[width(dist)];
+    }
+
+    void count_trie_ref(Node const v) {
+        ++len_freq_[0];
+        ++ref_freq_[width(v)];
+    }
+
+    void count_literal(char const c) {
+        ++len_freq_[1];
+        ++literal_freq_[uint8_t(c)];
+    }
+
+    void count_lz_ref(size_t const len, size_t const dist) {
+        ++len_freq_[std::min(len, MAX_LZ_REF_LEN)];
+        ++src_freq_[width(dist)];
+    }
+};
+
+struct Stats {
+    size_t n = 0;
     size_t num_lz = 0;
     size_t num_trie = 0;
     size_t num_literal = 0;
@@ -57,37 +191,170 @@ void compress(In begin, In const& end, Out out, size_t const threshold, size_t c
     size_t total_lz_len = 0;
     size_t num_relevant = 0;
 
-    // write header and initialize encoding
-    out.write(MAGIC, 64);
-    out.write(k, 64);
-    out.write(window_size, 64);
-    out.write(max_freq, 64);
+    void add_to(pm::Result& result) const {
+        result.add("phrases_total", num_lz + num_literal + num_trie);
+        result.add("phrases_ref", num_lz + num_trie);
+        result.add("phrases_literal", num_literal);
+        result.add("num_relevant", num_relevant);
+        result.add("phrases_longest", std::max(trie_longest, lz_longest));
+        result.add("phrases_longest_lz", lz_longest);
+        result.add("phrases_longest_trie", trie_longest);
+        result.add("phrases_ref_lz", num_lz);
+        result.add("phrases_ref_trie", num_trie);
+        result.add("phrases_avg_ref_len", std::round(100.0 * ((double)(total_lz_len + total_trie_len) / (double)(num_lz + num_trie))) / 100.0);
+        result.add("phrases_avg_ref_len_lz", std::round(100.0 * ((double)total_lz_len / (double)num_lz)) / 100.0);
+        result.add("phrases_avg_ref_len_trie", std::round(100.0 * ((double)total_trie_len / (double)num_trie)) / 100.0);
+    }
+};
 
-    BlockEncoder enc(out, block_size);
-    setup_encoding(enc, k, window_size);
+// encodes the input block by block until the end of the input is reached, or until max_blocks blocks have been encoded
+// if optimal is set, each block is parsed such that its estimated encoded size is minimal (see encode_block_optimal), otherwise greedily
+// if sliding is set, LZ77 references may reach back into the previous block (but not beyond the first block encoded by this call)
+template<typename Topk, iopp::InputIterator<char> In, iopp::BitSink Out>
+void encode(In& begin, In const& end, Out& out, Topk& topk, size_t const threshold, bool const optimal, bool const sliding, size_t const k, size_t const window_size, size_t const block_size, bool const align_blocks, size_t const num_threads, size_t const max_blocks, Stats& stats) {
+    // initialize encoding
+    BlockEncoder enc(out, block_size, align_blocks);
+    setup_encoding(enc, k, window_size, sliding);
 
-    // initialize top-k
-    Topk topk(k - 1, max_freq);
+    // initialize buffers
+    // nb: we keep two batches of blocks -- while the current batch is being encoded, the LZ77 factorizations of the next batch are computed in parallel
+    assert(num_threads >= 1);
+    auto const batch_size = num_threads;
+
+    std::vector<Block> cur_batch(batch_size);
+    std::vector<Block> next_batch(batch_size);
+    for(auto* batch : { &cur_batch, &next_batch }) {
+        for(auto& b : *batch) {
+            b.data = std::make_unique<char[]>(window_size);
+            if(optimal) {
+                b.lpf = std::make_unique<Index[]>(window_size);
+                b.dist = std::make_unique<Index[]>(window_size);
+            }
+        }
+    }
 
-    // initialize factorizer
-    lz77::LPFFactorizer lpf;
-    lpf.min_reference_length(threshold);
-    std::vector<lz77::Factor> factors;
+    size_t num_blocks_read = 0;
+    auto read_batch = [&](std::vector<Block>& batch){
+        size_t num_blocks = 0;
+        while(num_blocks < batch_size && num_blocks_read < max_blocks && begin != end) {
+            ++num_blocks_read;
+            auto& b = batch[num_blocks++];
+            b.size = 0;
+            while(b.size < window_size && begin != end) {
+                b.data[b.size++] = *begin++;
+            }
+        }
+        return num_blocks;
+    };
+
+    // factorizes a block, given the previous block in sliding mode (or nullptr if there is none)
+    auto factorize_block = [&](Block& b, Block const* prev){
+        // in sliding mode, the block is factorized as the suffix of the concatenation with the previous block
+        std::unique_ptr<char[]> text;
+        Index history = 0;
+        if(sliding && prev) {
+            history = prev->size;
+            text = std::make_unique_for_overwrite<char[]>(history + b.size);
+            std::memcpy(text.get(), prev->data.get(), history);
+            std::memcpy(text.get() + history, b.data.get(), b.size);
+        }
 
-    // initialize buffers
-    auto block_offs = 0;
-    auto block = std::make_unique<char[]>(window_size);
+        if(optimal) {
+            // compute the longest previous factor at each position
+            if(history > 0) {
+                auto lpf = std::make_unique<Index[]>(history + b.size);
+                auto src = std::make_unique<Index[]>(history + b.size);
+                lpf_prev_u32(text.get(), text.get() + history + b.size, lpf.get(), src.get());
+                std::memcpy(b.lpf.get(), lpf.get() + history, b.size * sizeof(Index));
+                std::memcpy(b.dist.get(), src.get() + history, b.size * sizeof(Index));
+            } else {
+                lpf_prev_u32(b.data.get(), b.data.get() + b.size, b.lpf.get(), b.dist.get());
+            }
+            for(Index i = 0; i < b.size; i++) {
+                if(b.lpf[i] > 0) b.dist[i] = history + i - b.dist[i];
+            }
+            return;
+        }
 
-    while(begin != end) {
-        // read next block
-        Index block_num = 0;
-        while(block_num < window_size && begin != end) {
-            block[block_num++] = *begin++;
+        b.factors.clear();
+        if(history > 0) {
+            factorize_with_history(text.get(), text.get() + history, text.get() + history + b.size, threshold, std::back_inserter(b.factors));
+            return;
         }
 
         // compute the LZ77 factorization of the block
-        factors.clear();
-        lpf.factorize(block.get(), block.get() + block_num, std::back_inserter(factors));
+        // nb: each block gets its own factorizer so that blocks can be factorized concurrently
+        lz77::LPFFactorizer lpf;
+        lpf.min_reference_length(threshold);
+        lpf.factorize(b.data.get(), b.data.get() + b.size, std::back_inserter(b.factors));
+    };
+
+    // enters a phrase into the top-k trie
+    auto topk_enter = [&](char const* block, Index const block_num, size_t const pos, size_t const len){
+        ++stats.num_relevant;
+
+        if constexpr(PROTOCOL) *DebugOutput::stream << "enter: \"";
+        typename Topk::StringState s = topk.empty_string();
+        Node node;
+        while(s.frequent && s.len < len && pos + s.len < block_num) {
+            if constexpr(PROTOCOL) *DebugOutput::stream << display_inline(block[pos + s.len]);
+            node = s.node;
+            s = topk.extend(s, block[pos + s.len]);
+        }
+        if constexpr(PROTOCOL) *DebugOutput::stream << "\" (length " << s.len << " -> node " << node << ")" << std::endl;
+    };
+
+    // write phrases
+    CostModel costs(window_size);
+
+    auto write_trie_ref = [&](Index const curpos, Node const v, Index const dv){
+        assert(v > 0);
+        enc.write_uint(TOK_FACT_LEN, 0);
+        enc.write_uint(TOK_TRIE_REF, v);
+
+        ++stats.num_trie;
+        stats.trie_longest = std::max(stats.trie_longest, (size_t)dv);
+        stats.total_trie_len += dv;
+        if(optimal) costs.count_trie_ref(v);
+
+        if constexpr(PROTOCOL) *DebugOutput::stream << "pos=" << (stats.n + curpos) << ": top-k (" << v << ") / " << dv << std::endl;
+    };
+
+    auto write_literal = [&](char const* block, Index const curpos){
+        enc.write_uint(TOK_FACT_LEN, 1);
+        enc.write_char(TOK_LITERAL, block[curpos], literal_context(block, curpos));
+
+        ++stats.num_literal;
+        if(optimal) costs.count_literal(block[curpos]);
+
+        if constexpr(PROTOCOL) *DebugOutput::stream << "pos=" << (stats.n + curpos) << ": literal " << display(block[curpos]) << std::endl;
+    };
+
+    auto write_lz_ref = [&](Index const curpos, Index const src, Index const len){
+        if(len >= MAX_LZ_REF_LEN) {
+            // encode the maximum length, then encode the rest as a special token
+            enc.write_uint(TOK_FACT_LEN, MAX_LZ_REF_LEN);
+            enc.write_uint(TOK_FACT_REMAINDER, len - MAX_LZ_REF_LEN);
+        } else {
+            // simply encode the length
+            enc.write_uint(TOK_FACT_LEN, len);
+        }
+
+        // write source
+        enc.write_uint(TOK_FACT_SRC, src);
+
+        ++stats.num_lz;
+        stats.lz_longest = std::max(stats.lz_longest, (size_t)len);
+        stats.total_lz_len += len;
+        if(optimal) costs.count_lz_ref(len, src);
+
+        if constexpr(PROTOCOL) *DebugOutput::stream << "pos=" << (stats.n + curpos) << ": lz (" << src << ", " << len << ")" << std::endl;
+    };
+
+    auto encode_block = [&](Block& b){
+        char const* block = b.data.get();
+        Index const block_num = b.size;
+        auto& factors = b.factors;
 
         CALLGRIND_START_INSTRUMENTATION;
         CALLGRIND_TOGGLE_COLLECT;
@@ -96,43 +363,58 @@ void compress(In begin, In const& end, Out out, size_t const threshold, size_t c
         // at the beginning of each LZ77 factor, we attempt to find the longest possible string back in the top-k trie
         // if we find a string longer than the next LZ77 factor, we encode it using a trie reference and advance in the LZ77 factorization, potentially chopping
         // the factor that we reach into two fractions
-        auto topk_enter = [&](size_t const pos, size_t const len){
-            ++num_relevant;
 
-            if constexpr(PROTOCOL) std::cout << "enter: \"";
-            typename Topk::StringState s = topk.empty_string();
-            Node node;
-            while(s.frequent && s.len < len && pos + s.len < block_num) {
-                if constexpr(PROTOCOL) std::cout << display_inline(block[pos + s.len]);
-                node = s.node;
-                s = topk.extend(s, block[pos + s.len]);
+        // the starting positions of upcoming LZ77 factors are likely starts of phrases as well
+        // we look them up in a batch, such that the trie nodes on their paths are loaded concurrently rather than one after another
+        // nb: the trie changes in between, so each result is validated when it is used (see refind), which falls back to a lookup if needed
+        char const* batch_strings[PREFETCH_GROUP];
+        size_t batch_lens[PREFETCH_GROUP];
+        Index batch_pos[PREFETCH_GROUP];
+        Node batch_nodes[PREFETCH_GROUP];
+        Index batch_depths[PREFETCH_GROUP];
+        size_t batch_num = 0;
+        size_t batch_next = 0;
+
+        auto lookup_batch = [&](Index const curpos, Index const z){
+            batch_num = 0;
+            batch_next = 0;
+            Index pos = curpos;
+            for(Index j = z; j < factors.size() && pos < block_num && batch_num < PREFETCH_GROUP; j++) {
+                batch_strings[batch_num] = block + pos;
+                batch_lens[batch_num] = block_num - pos;
+                batch_pos[batch_num] = pos;
+                ++batch_num;
+                pos += factors[j].num_literals();
+            }
+            topk.find_many(batch_strings, batch_lens, batch_num, batch_nodes, batch_depths);
+            topk.reset_changes();
+        };
+
+        // find the longest string represented in the top-k trie starting at the given position, where the current LZ77 factor starts
+        auto find = [&](Index const curpos, Index const z, Node& v){
+            if constexpr(requires { topk.find_many(batch_strings, batch_lens, batch_num, batch_nodes, batch_depths); topk.reset_changes(); }) {
+                while(batch_next < batch_num && batch_pos[batch_next] < curpos) ++batch_next;
+                if(batch_next == batch_num) lookup_batch(curpos, z);
+                if(batch_pos[batch_next] == curpos) {
+                    auto const j = batch_next++;
+                    return Index(topk.refind(block + curpos, block_num - curpos, batch_nodes[j], batch_depths[j], v));
+                }
             }
-            if constexpr(PROTOCOL) std::cout << "\" (length " << s.len << " -> node " << node << ")" << std::endl;
+            return Index(topk.find(block + curpos, block_num - curpos, v));
         };
 
         {
             Index z = 0; // the current LZ77 factor
             Index curpos = 0;
             while(curpos < block_num) {
-                auto const gpos = block_offs + curpos;
-
                 // find the longest string represented in the top-k trie starting at the current position
                 Node v;
-                Index dv = topk.find(block.get() + curpos, block_num - curpos, v);
+                Index dv = find(curpos, z, v);
 
                 auto const& f = factors[z];
                 if(dv >= f.num_literals()) {
                     // encode a top-k trie reference
-                    assert(v > 0);
-
-                    enc.write_uint(TOK_FACT_LEN, 0);
-                    enc.write_uint(TOK_TRIE_REF, v);
-                    
-                    ++num_trie;
-                    trie_longest = std::max(trie_longest, (size_t)dv);
-                    total_trie_len += dv;
-
-                    if constexpr(PROTOCOL) std::cout << "pos=" << gpos << ": top-k (" << v << ") / " << dv << std::endl;;
+                    write_trie_ref(curpos, v, dv);
 
                     // advance in LZ77 factorization
                     if(curpos + dv < block_num) {
@@ -150,43 +432,22 @@ void compress(In begin, In const& end, Out out, size_t const threshold, size_t c
                     }
 
                     // enter
-                    topk_enter(curpos, dv);
+                    topk_enter(block, block_num, curpos, dv);
                     curpos += dv;
                 } else {
                     // encode a LZ77 reference or a literal
                     if(f.is_literal() || f.num_literals() == 1) {
                         // a literal factor (possibly a reference of length one introduced due to chopping)
-                        enc.write_uint(TOK_FACT_LEN, 1);
-                        enc.write_char(TOK_LITERAL, block[curpos]);
-                        if constexpr(PROTOCOL) std::cout << "pos=" << gpos << ": literal " << display(block[curpos]) << std::endl;
-                        ++num_literal;
-
-                        topk_enter(curpos, 1);
+                        write_literal(block, curpos);
+                        topk_enter(block, block_num, curpos, 1);
                         ++curpos;
                     } else {
                         // a real LZ77 reference
-                        auto const fpos = curpos;
-                        assert(fpos >= f.src);
-
-                        if(f.len >= MAX_LZ_REF_LEN) {
-                            // encode the maximum length, then encode the rest as a special token
-                            enc.write_uint(TOK_FACT_LEN, MAX_LZ_REF_LEN);
-                            enc.write_uint(TOK_FACT_REMAINDER, f.len - MAX_LZ_REF_LEN);
-                        } else {
-                            // simply encode the length
-                            enc.write_uint(TOK_FACT_LEN, f.len);
-                        }
-
-                        // write source
-                        enc.write_uint(TOK_FACT_SRC, f.src);
-                        if constexpr(PROTOCOL) std::cout << "pos=" << gpos << ": lz (" << f.src << ", " << f.len << ")" << std::endl;
-
-                        ++num_lz;
-                        lz_longest = std::max(lz_longest, (size_t)f.len);
-                        total_lz_len += f.len;
+                        assert(sliding || curpos >= f.src);
+                        write_lz_ref(curpos, f.src, f.len);
 
                         // enter
-                        topk_enter(curpos, f.len);
+                        topk_enter(block, block_num, curpos, f.len);
                         curpos += f.len;
                     }
 
@@ -199,49 +460,254 @@ void compress(In begin, In const& end, Out out, size_t const threshold, size_t c
         CALLGRIND_TOGGLE_COLLECT;
         CALLGRIND_STOP_INSTRUMENTATION;
 
-        block_offs += block_num;
+        stats.n += block_num;
+    };
+
+    // encodes a block using a parsing of minimal estimated size
+    // the candidate phrases at each position are a literal, the longest trie match and LZ77 references to the longest previous factor, which
+    // form a DAG over the positions of the block -- the shortest paths to the end of the block are computed backwards, using the costs of the previous block's tokens
+    // nb: the top-k trie changes while the block is encoded, so the DAG is built using the trie as of the beginning of the block,
+    // and each phrase is then chosen greedily with respect to the current trie and the cost of the shortest path from where it ends
+    std::vector<uint64_t> path_cost;
+    std::vector<Index> path_len;
+    std::vector<Node> trie_node;
+    std::vector<Index> trie_depth;
+
+    auto encode_block_optimal = [&](Block& b){
+        char const* block = b.data.get();
+        Index const block_num = b.size;
+        auto const min_lz_len = std::max(threshold, size_t(2));
+
+        // find the longest trie match at each position
+        trie_node.resize(block_num);
+        trie_depth.resize(block_num);
+        {
+            char const* strings[PREFETCH_GROUP];
+            size_t lens[PREFETCH_GROUP];
+            for(Index i = 0; i < block_num; i += PREFETCH_GROUP) {
+                size_t const num = std::min(PREFETCH_GROUP, size_t(block_num - i));
+                for(size_t j = 0; j < num; j++) {
+                    strings[j] = block + i + j;
+                    lens[j] = block_num - i - j;
+                }
+                if constexpr(requires { topk.find_many(strings, lens, num, trie_node.data(), trie_depth.data()); }) {
+                    topk.find_many(strings, lens, num, trie_node.data() + i, trie_depth.data() + i);
+                } else {
+                    for(size_t j = 0; j < num; j++) trie_depth[i + j] = topk.find(strings[j], lens[j], trie_node[i + j]);
+                }
+            }
+        }
+
+        // the cheapest phrase starting at a position, given the costs of the shortest paths from all following positions
+        // nb: returns the length of the phrase, where zero denotes a trie reference to the given node
+        auto cheapest = [&](Index const i, Node const v, Index const dv, uint64_t& cost){
+            Index best_len = 1;
+            cost = costs.literal(block[i]) + path_cost[i + 1];
+
+            if(dv > 0) {
+                auto const c = costs.trie_ref(v) + path_cost[i + dv];
+                if(c < cost) {
+                    cost = c;
+                    best_len = 0;
+                }
+            }
+
+            auto const lpf = b.lpf[i];
+            if(lpf >= min_lz_len) {
+                auto const max_len = std::min(size_t(lpf), OPTIMAL_NICE_LEN);
+                for(size_t len = min_lz_len; len <= max_len; len++) {
+                    auto const c = costs.lz_ref(len, b.dist[i]) + path_cost[i + len];
+                    if(c < cost) {
+                        cost = c;
+                        best_len = len;
+                    }
+                }
+                if(lpf > max_len) {
+                    auto const c = costs.lz_ref(lpf, b.dist[i]) + path_cost[i + lpf];
+                    if(c < cost) {
+                        cost = c;
+                        best_len = lpf;
+                    }
+                }
+            }
+            return best_len;
+        };
+
+        // compute the costs of the shortest paths to the end of the block
+        path_cost.resize(block_num + 1);
+        path_len.resize(block_num);
+        auto shortest_paths = [&](){
+            path_cost[block_num] = 0;
+            for(Index i = block_num; i-- > 0;) {
+                path_len[i] = cheapest(i, trie_node[i], trie_depth[i], path_cost[i]);
+            }
+        };
+        shortest_paths();
+
+        // refine the costs using the statistics of the shortest path itself
+        for(size_t pass = 1; pass < OPTIMAL_PASSES; pass++) {
+            for(Index i = 0; i < block_num;) {
+                auto const len = path_len[i];
+                if(len == 0) {
+                    costs.count_trie_ref(trie_node[i]);
+                    i += trie_depth[i];
+                } else if(len == 1) {
+                    costs.count_literal(block[i]);
+                    ++i;
+                } else {
+                    costs.count_lz_ref(len, b.dist[i]);
+                    i += len;
+                }
+            }
+            costs.update();
+            shortest_paths();
+        }
+
+        // encode
+        Index curpos = 0;
+        while(curpos < block_num) {
+            Node v;
+            Index const dv = topk.find(block + curpos, block_num - curpos, v);
+
+            uint64_t cost;
+            auto const len = cheapest(curpos, v, dv, cost);
+            if(len == 0) {
+                write_trie_ref(curpos, v, dv);
+                topk_enter(block, block_num, curpos, dv);
+                curpos += dv;
+            } else if(len == 1) {
+                write_literal(block, curpos);
+                topk_enter(block, block_num, curpos, 1);
+                ++curpos;
+            } else {
+                write_lz_ref(curpos, b.dist[curpos], len);
+                topk_enter(block, block_num, curpos, len);
+                curpos += len;
+            }
+        }
+
+        // the costs for the next block are estimated from the tokens of this block
+        costs.update();
+        stats.n += block_num;
+    };
+
+    // process blocks
+    auto num_cur = read_batch(cur_batch);
+
+    #pragma omp parallel for num_threads(num_threads)
+    for(size_t i = 0; i < num_cur; i++) {
+        factorize_block(cur_batch[i], i > 0 ? &cur_batch[i-1] : nullptr);
+    }
+
+    while(num_cur > 0) {
+        // read the next batch of blocks
+        auto const num_next = read_batch(next_batch);
+
+        #pragma omp parallel num_threads(num_threads)
+        {
+            #pragma omp single
+            {
+                // spawn factorization of the next batch
+                // nb: the last block of the current batch precedes the first block of the next batch
+                for(size_t i = 0; i < num_next; i++) {
+                    auto const* prev = i > 0 ? &next_batch[i-1] : &cur_batch[num_cur-1];
+                    #pragma omp task firstprivate(i, prev) shared(next_batch)
+                    factorize_block(next_batch[i], prev);
+                }
+
+                // encode the current batch in order
+                // nb: the top-k trie is updated strictly sequentially, so the output is the same regardless of the number of threads
+                for(size_t i = 0; i < num_cur; i++) {
+                    if(optimal) encode_block_optimal(cur_batch[i]);
+                    else encode_block(cur_batch[i]);
+                }
+            }
+        }
+
+        // advance
+        std::swap(cur_batch, next_batch);
+        num_cur = num_next;
     }
     enc.flush();
+}
+
+template<typename Topk, iopp::InputIterator<char> In, iopp::BitSink Out>
+void compress(In begin, In const& end, Out out, size_t const threshold, bool const optimal, bool const sliding, size_t const k, size_t const window_size, size_t const max_freq, size_t const block_size, bool const align_blocks, size_t const num_threads, pm::Result& result) {
+    // write header
+    out.write(MAGIC, 64);
+    out.write(k, 64);
+    out.write(window_size, 64);
+    out.write(max_freq, 64);
+    out.write(sliding);
+
+    // initialize top-k
+    Topk topk(k - 1, max_freq);
+
+    // encode
+    Stats stats;
+    encode(begin, end, out, topk, threshold, optimal, sliding, k, window_size, block_size, align_blocks, num_threads, SIZE_MAX, stats);
 
     // stats
     topk.print_debug_info();
-    result.add("phrases_total", num_lz + num_literal + num_trie);
-    result.add("phrases_ref", num_lz + num_trie);
-    result.add("phrases_literal", num_literal);
-    result.add("num_relevant", num_relevant);
-    result.add("phrases_longest", std::max(trie_longest, lz_longest));
-    result.add("phrases_longest_lz", lz_longest);
-    result.add("phrases_longest_trie", trie_longest);
-    result.add("phrases_ref_lz", num_lz);
-    result.add("phrases_ref_trie", num_trie);
-    result.add("phrases_avg_ref_len", std::round(100.0 * ((double)(total_lz_len + total_trie_len) / (double)(num_lz + num_trie))) / 100.0);
-    result.add("phrases_avg_ref_len_lz", std::round(100.0 * ((double)total_lz_len / (double)num_lz)) / 100.0);
-    result.add("phrases_avg_ref_len_trie", std::round(100.0 * ((double)total_trie_len / (double)num_trie)) / 100.0);
+    stats.add_to(result);
 }
 
-template<typename Topk, iopp::BitSource In, std::output_iterator<char> Out>
-void decompress(In in, Out out) {
-    // decode header
-    uint64_t const magic = in.read(64);
-    if(magic != MAGIC) {
-        std::cerr << "wrong magic: 0x" << std::hex << magic << " (expected: 0x" << MAGIC << ")" << std::endl;
-        std::abort();
+// compresses the input into a framed container
+// each frame begins with a snapshot of the top-k structure and consists of as many whole blocks as needed to cover frame_size characters
+template<typename Topk, iopp::InputIterator<char> In, std::output_iterator<char> Out>
+void compress_framed(In begin, In const& end, Out out, size_t const threshold, bool const optimal, bool const sliding, size_t const k, size_t const window_size, size_t const max_freq, size_t const block_size, bool const align_blocks, size_t const num_threads, size_t const frame_size, pm::Result& result) {
+    frames::FrameWriter writer(out, FRAMED_MAGIC, { k, window_size, max_freq, sliding });
+
+    // initialize top-k
+    Topk topk(k - 1, max_freq);
+
+    // encode
+    auto const blocks_per_frame = std::max(size_t(1), idiv_ceil(frame_size, window_size));
+
+    Stats stats;
+    std::string frame;
+    size_t snapshot_bits = 0;
+    while(begin != end) {
+        auto const frame_pos = stats.n;
+
+        frame.clear();
+        {
+            auto frame_out = iopp::bitwise_output_to(std::back_inserter(frame));
+
+            // the first frame starts with the initial state and needs no snapshot
+            bool const initial = (frame_pos == 0);
+            frame_out.write(initial);
+            if(!initial) topk.encode_snapshot(frame_out);
+            snapshot_bits += frame_out.num_bits_written();
+
+            encode(begin, end, frame_out, topk, threshold, optimal, sliding, k, window_size, block_size, align_blocks, num_threads, blocks_per_frame, stats);
+        }
+        writer.write_frame(frame, frame_pos);
     }
+    writer.finish(stats.n);
 
-    auto const k = in.read(64);
-    auto const window_size = in.read(64);
-    auto const max_freq = in.read(64);
+    // stats
+    topk.print_debug_info();
+    stats.add_to(result);
+    result.add("frames", writer.num_frames());
+    result.add("outsize_snapshots", snapshot_bits / 8);
+}
 
+// decodes blocks until the input is exhausted
+template<typename Topk, iopp::BitSource In, std::output_iterator<char> Out>
+void decode(In& in, Topk& topk, size_t const k, size_t const window_size, bool const sliding, Out out) {
     // initialize decoding
     BlockDecoder dec(in);
-    setup_encoding(dec, k, window_size);
-    Topk topk(k - 1, max_freq);
-    
-    auto block = std::make_unique<char[]>(window_size);
+    setup_encoding(dec, k, window_size, sliding);
+
+    // nb: in sliding mode, the previous block is kept directly before the current block
+    auto buffer = std::make_unique<char[]>(sliding ? 2 * window_size : window_size);
+    auto* block = buffer.get() + (sliding ? window_size : 0);
+    size_t history = 0;
     auto block_offs = 0;
     size_t curpos = 0;
 
-    while(in) {
+    while(dec) {
         auto const len = dec.read_uint(TOK_FACT_LEN);
         size_t phrase_len;
 
@@ -249,44 +715,45 @@ void decompress(In in, Out out) {
         if(len == 0) {
             // a top-k trie reference
             auto const node = dec.read_uint(TOK_TRIE_REF);
-            phrase_len = topk.get(node, block.get() + curpos);
-            if constexpr(PROTOCOL) std::cout << "pos=" << gpos << ": top-k (" << node << ") / " << phrase_len << std::endl;;
+            phrase_len = topk.get(node, block + curpos);
+            if constexpr(PROTOCOL) *DebugOutput::stream << "pos=" << gpos << ": top-k (" << node << ") / " << phrase_len << std::endl;;
         } else if(len == 1) {
             // a literal character
-            auto const c = dec.read_char(TOK_LITERAL);
+            auto const c = dec.read_char(TOK_LITERAL, literal_context(block, curpos));
             block[curpos] = c;
             phrase_len = 1;
-            if constexpr(PROTOCOL) std::cout << "pos=" << gpos << ": literal " << display(c) << std::endl;
+            if constexpr(PROTOCOL) *DebugOutput::stream << "pos=" << gpos << ": literal " << display(c) << std::endl;
         } else {
             phrase_len = len;
 
-            // a block-local LZ77 reference
+            // an LZ77 reference, the source is the distance back within the window, i.e., it may reach into the previous block in sliding mode
             if(len == MAX_LZ_REF_LEN) {
                 // this factor may be even longer, decode remainder
                 phrase_len += dec.read_uint(TOK_FACT_REMAINDER);
             }
 
             auto const src = dec.read_uint(TOK_FACT_SRC);
-            assert(curpos >= src);
-            auto const srcpos = curpos - src;
+            assert(curpos + history >= src);
+            auto* dst = block + curpos;
+            auto const* srcp = dst - src;
             for(size_t i = 0; i < phrase_len; i++) {
-                block[curpos + i] = block[srcpos + i];
+                dst[i] = srcp[i];
             }
-            if constexpr(PROTOCOL) std::cout << "pos=" << gpos << ": lz (" << src << ", " << phrase_len << ")" << std::endl;
+            if constexpr(PROTOCOL) *DebugOutput::stream << "pos=" << gpos << ": lz (" << src << ", " << phrase_len << ")" << std::endl;
         }
 
         // enter string into top-k structure
         {
-            if constexpr(PROTOCOL) std::cout << "enter: \"";
+            if constexpr(PROTOCOL) *DebugOutput::stream << "enter: \"";
             typename Topk::StringState s = topk.empty_string();
             Node node;
             while(s.frequent && s.len < phrase_len) {
                 assert(curpos + s.len < window_size);
-                if constexpr(PROTOCOL) std::cout << display_inline(block[curpos + s.len]);
+                if constexpr(PROTOCOL) *DebugOutput::stream << display_inline(block[curpos + s.len]);
                 node = s.node;
                 s = topk.extend(s, block[curpos + s.len]);
             }
-            if constexpr(PROTOCOL) std::cout << "\" (length " << s.len << " -> node " << node << ")" << std::endl;
+            if constexpr(PROTOCOL) *DebugOutput::stream << "\" (length " << s.len << " -> node " << node << ")" << std::endl;
         }
 
         // advance
@@ -297,6 +764,10 @@ void decompress(In in, Out out) {
             for(size_t i = 0; i < window_size; i++) {
                 *out++ = block[i];
             }
+            if(sliding) {
+                std::memcpy(buffer.get(), block, window_size);
+                history = window_size;
+            }
             curpos = 0;
             block_offs += window_size;
         }
@@ -308,4 +779,43 @@ void decompress(In in, Out out) {
     }
 }
 
+template<typename Topk, iopp::BitSource In, std::output_iterator<char> Out>
+void decompress(In in, Out out) {
+    // decode header
+    uint64_t const magic = in.read(64);
+    if(magic != MAGIC) {
+        std::cerr << "wrong magic: 0x" << std::hex << magic << " (expected: 0x" << MAGIC << ")" << std::endl;
+        std::abort();
+    }
+
+    auto const k = in.read(64);
+    auto const window_size = in.read(64);
+    auto const max_freq = in.read(64);
+    bool const sliding = in.read();
+
+    // initialize decoding
+    Topk topk(k - 1, max_freq);
+    decode(in, topk, k, window_size, sliding, out);
+}
+
+// decodes the characters in the range [range_begin, range_end) from a framed container
+// frames are independent, so up to num_threads of them are decoded concurrently
+template<typename Topk, std::output_iterator<char> Out>
+void decompress_framed(char const* begin, char const* end, Out out, size_t const range_begin = 0, size_t const range_end = SIZE_MAX, size_t const num_threads = 1) {
+    frames::FrameReader reader(begin, end, FRAMED_MAGIC, 4);
+    auto const k = reader.param(0);
+    auto const window_size = reader.param(1);
+    auto const max_freq = reader.param(2);
+    bool const sliding = reader.param(3);
+
+    reader.decode_range(range_begin, range_end, out, [&](size_t const i, std::string& buffer){
+        auto in = iopp::bitwise_input_from(reader.frame_begin(i), reader.frame_end(i));
+
+        Topk topk(k - 1, max_freq);
+        bool const initial = in.read();
+        if(!initial) topk.decode_snapshot(in);
+        decode(in, topk, k, window_size, sliding, std::back_inserter(buffer));
+    }, num_threads);
+}
+
 }
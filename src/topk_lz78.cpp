@@ -3,28 +3,162 @@
 
 #include <topk_prefixes_misra_gries.hpp>
 
-struct Compressor : public TopkCompressor {
+struct Compressor : public FramedTopkCompressor {
     uint64_t ignored_ = 0;
+    bool split_nodes = false;
+    bool lazy = false;
+    bool measure_latency = false;
+    bool train = false;
+    std::string dict_file;
 
-    Compressor() : TopkCompressor("topk-lz78", "LZ78 with a trie constrained to the top-k phrases.") {
+    topk_lz78::Dictionary dict;
+
+    Compressor() : FramedTopkCompressor("topk-lz78", "LZ78 with a trie constrained to the top-k phrases.") {
         param('w', "window", ignored_, "Ignored, provided only for interoperability.");
+        param("split-nodes", split_nodes, "Keep the trie navigation data and the frequency data in separate arrays.");
+        param("lazy", lazy, "Use the lazy Space-Saving variant, which never renormalizes (changes the output).");
+        param("latency", measure_latency, "Measure the latency of each top-k update.");
+        param("train", train, "Rather than compressing, train a dictionary on all input files and write it to the output file (see --dict).");
+        param("dict", dict_file, "Start compression and decompression from the given pre-trained dictionary (see --train), which also determines k and the maximum frequency.");
     }
 
     virtual void init_result(pm::Result& result) override {
         result.add("algo", "topk-lz78");
-        TopkCompressor::init_result(result);
+        FramedTopkCompressor::init_result(result);
+        result.add("split_nodes", split_nodes);
+        result.add("lazy", lazy);
+        if(!dict.empty()) result.add("dict", std::filesystem::path(dict_file).filename().string());
     }
 
     virtual std::string file_ext() override {
         return ".topklz78";
     }
 
-    virtual void compress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) override {
-        topk_lz78::compress<TopKPrefixesMisraGries<>>(in.begin(), in.end(), iopp::bitwise_output_to(out), k, max_freq, block_size, result);
+    template<typename Topk, typename Input>
+    void compress_using(Input& in, std::ostream& out, pm::Result& result) {
+        if(frame_size > 0) {
+            topk_lz78::compress_framed<Topk>(in.begin(), in.end(), iopp::StreamOutputIterator(out), k, max_freq, block_size, align_blocks, std::max(threads, 1U), frame_size, dict, result, measure_latency);
+        } else {
+            topk_lz78::compress<Topk>(in.begin(), in.end(), iopp::bitwise_output_to(out), k, max_freq, block_size, align_blocks, std::max(threads, 1U), dict, result, measure_latency);
+        }
+    }
+
+    template<typename Topk>
+    void decompress_using(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) {
+        if(frames::is_framed(in.begin(), in.end(), topk_lz78::framed_magic_for<Topk>)) {
+            uint64_t a, b;
+            decode_range(a, b);
+            topk_lz78::decompress_framed<Topk>(in.begin(), in.end(), dict, iopp::StreamOutputIterator(out), a, b, std::max(threads, 1U));
+        } else {
+            if(!range.empty()) {
+                std::cerr << "decoding a range requires a framed container (see --frame-size)" << std::endl;
+                std::abort();
+            }
+            topk_lz78::decompress<Topk>(iopp::bitwise_input_from(in.begin(), in.end()), iopp::StreamOutputIterator(out), dict);
+        }
+    }
+
+    // invokes f with the top-k data structure selected by the given options
+    template<typename F>
+    static void with_topk(bool const split, bool const lazy, F f) {
+        if(split) {
+            if(lazy) f.template operator()<TopKPrefixesMisraGries<uint32_t, true, true>>();
+            else     f.template operator()<TopKPrefixesMisraGries<uint32_t, true, false>>();
+        } else {
+            if(lazy) f.template operator()<TopKPrefixesMisraGries<uint32_t, false, true>>();
+            else     f.template operator()<TopKPrefixesMisraGries<uint32_t, false, false>>();
+        }
+    }
+
+    // nb: the node layout does not affect the output, only the memory access pattern
+    virtual void compress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) override {
+        with_topk(split_nodes, lazy, [&]<typename Topk>(){ compress_using<Topk>(in, out, result); });
+    }
+
+    virtual bool can_stream() override {
+        return true;
+    }
+
+    virtual void compress_stream(StreamInput& in, std::ostream& out, pm::Result& result) override {
+        with_topk(split_nodes, lazy, [&]<typename Topk>(){ compress_using<Topk>(in, out, result); });
     }
     
-    virtual void decompress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) override {
-        topk_lz78::decompress<TopKPrefixesMisraGries<>>(iopp::bitwise_input_from(in.begin(), in.end()), iopp::StreamOutputIterator(out));
+    // nb: whether the lazy variant was used is determined from the input
+    virtual void decompress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) override {
+        with_topk(split_nodes, topk_lz78::is_lazy_file(in.begin(), in.end()), [&]<typename Topk>(){ decompress_using<Topk>(in, out, result); });
+    }
+
+    virtual bool can_decompress_stream() override {
+        return true;
+    }
+
+    // nb: the frames of a framed container are located via its footer index, so it cannot be decoded in a single pass
+    virtual void decompress_stream(StreamInput& in, std::ostream& out, pm::Result& result) override {
+        auto const header = in.peek(8);
+        auto const header_end = header.data() + header.size();
+        if(frames::is_framed(header.data(), header_end, topk_lz78::FRAMED_MAGIC) || frames::is_framed(header.data(), header_end, topk_lz78::LAZY_FRAMED_MAGIC)) {
+            std::cerr << "framed containers cannot be decompressed from a stream, please pass a file" << std::endl;
+            std::abort();
+        }
+        if(!range.empty()) {
+            std::cerr << "decoding a range requires a framed container (see --frame-size)" << std::endl;
+            std::abort();
+        }
+        with_topk(split_nodes, topk_lz78::is_lazy_file(header.data(), header_end), [&]<typename Topk>(){
+            topk_lz78::decompress<Topk>(iopp::bitwise_input_from(in.begin(), in.end()), iopp::StreamOutputIterator(out), dict);
+        });
+    }
+
+    // trains a dictionary on the given input files, processed one after another
+    int train_dictionary(std::vector<std::string> const& files) {
+        if(output.empty()) {
+            std::cerr << "training a dictionary requires an output file (see --out)" << std::endl;
+            return -1;
+        }
+
+        pm::Result result;
+        result.add("algo", "topk-lz78-train");
+        result.add("files", files.size());
+        result.add("k", k);
+        result.add("max_freq", max_freq);
+        result.add("lazy", lazy);
+
+        pm::Stopwatch t;
+        t.start();
+        size_t n = 0;
+        with_topk(false, lazy, [&]<typename Topk>(){
+            Topk topk(k - 1, max_freq);
+            for(auto const& file : files) {
+                MemoryMappedFile in(file, prefix);
+                topk_lz78::train(in.begin(), in.end(), topk);
+                n += in.size();
+            }
+
+            iopp::FileOutputStream fos(output);
+            topk_lz78::write_dictionary(topk, k, max_freq, iopp::bitwise_output_to(fos), result);
+        });
+        t.stop();
+
+        result.add("n", n);
+        result.add("time", (uint64_t)std::round(t.elapsed_time_millis()));
+        result.add("nout", std::filesystem::file_size(output));
+        result.sort();
+        std::cout << result.str() << std::endl;
+        return 0;
+    }
+
+    virtual int run(Application const& app) override {
+        if(train && !app.args().empty()) {
+            return train_dictionary(app.args());
+        }
+
+        if(!dict_file.empty()) {
+            MemoryMappedFile in(dict_file);
+            dict = topk_lz78::read_dictionary(in.begin(), in.end());
+            k = dict.k;
+            max_freq = dict.max_freq;
+        }
+        return CompressorBase::run(app);
     }
 };
 
@@ -1,8 +1,15 @@
 #include <block_coding.hpp>
+#include <debug_output.hpp>
+#include <latency_histogram.hpp>
+#include <topk_prefixes_misra_gries.hpp>
+#include <trie_coding.hpp>
 #include <pm/result.hpp>
 
+#include "frames.hpp"
+
 namespace topk_lz78 {
 
+// nb: block streams used to begin with the maximum block size only, the magic number was changed when the byte-alignment flag was added
 constexpr uint64_t MAGIC =
     ((uint64_t)'T') << 56 |
     ((uint64_t)'O') << 48 |
@@ -10,29 +17,230 @@ constexpr uint64_t MAGIC =
     ((uint64_t)'K') << 32 |
     ((uint64_t)'L') << 24 |
     ((uint64_t)'Z') << 16 |
-    ((uint64_t)'7') << 8 |
+    ((uint64_t)'8') << 8 |
+    ((uint64_t)'2');
+
+constexpr uint64_t FRAMED_MAGIC =
+    ((uint64_t)'T') << 56 |
+    ((uint64_t)'O') << 48 |
+    ((uint64_t)'P') << 40 |
+    ((uint64_t)'K') << 32 |
+    ((uint64_t)'L') << 24 |
+    ((uint64_t)'Z') << 16 |
+    ((uint64_t)'8') << 8 |
+    ((uint64_t)'F');
+
+// the lazy Space-Saving variant leads to a different parsing, so it is marked by separate magic numbers
+constexpr uint64_t LAZY_MAGIC =
+    ((uint64_t)'T') << 56 |
+    ((uint64_t)'O') << 48 |
+    ((uint64_t)'P') << 40 |
+    ((uint64_t)'K') << 32 |
+    ((uint64_t)'L') << 24 |
+    ((uint64_t)'Z') << 16 |
+    ((uint64_t)'L') << 8 |
     ((uint64_t)'8');
 
+constexpr uint64_t LAZY_FRAMED_MAGIC =
+    ((uint64_t)'T') << 56 |
+    ((uint64_t)'O') << 48 |
+    ((uint64_t)'P') << 40 |
+    ((uint64_t)'K') << 32 |
+    ((uint64_t)'L') << 24 |
+    ((uint64_t)'Z') << 16 |
+    ((uint64_t)'L') << 8 |
+    ((uint64_t)'F');
+
+constexpr uint64_t DICT_MAGIC =
+    ((uint64_t)'T') << 56 |
+    ((uint64_t)'O') << 48 |
+    ((uint64_t)'P') << 40 |
+    ((uint64_t)'K') << 32 |
+    ((uint64_t)'D') << 24 |
+    ((uint64_t)'I') << 16 |
+    ((uint64_t)'C') << 8 |
+    ((uint64_t)'T');
+
+template<typename Topk>
+constexpr bool is_lazy = requires { requires Topk::lazy; };
+
+template<typename Topk>
+constexpr uint64_t magic_for = is_lazy<Topk> ? LAZY_MAGIC : MAGIC;
+
+template<typename Topk>
+constexpr uint64_t framed_magic_for = is_lazy<Topk> ? LAZY_FRAMED_MAGIC : FRAMED_MAGIC;
+
+// tests whether the given compressed data was produced using the lazy Space-Saving variant
+inline bool is_lazy_file(char const* begin, char const* end) {
+    if(frames::is_framed(begin, end, LAZY_FRAMED_MAGIC)) return true;
+    if(end - begin < 8) return false;
+    return iopp::bitwise_input_from(begin, end).read(64) == LAZY_MAGIC;
+}
+
 constexpr bool PROTOCOL = false;
 
-constexpr TokenType TOK_TRIE_REF = 0;
-constexpr TokenType TOK_LITERAL = 1;
+// a pre-trained dictionary, i.e., the top-k trie after processing some training data, which compression and decompression start from
+// after k, the maximum frequency and the Space-Saving variant, the trie is stored like in topk-twopass (see trie_coding.hpp), followed by the frequencies of its nodes in depth-first order
+// a compressed file refers to its dictionary by an identifier, which is a hash of the dictionary file and the Space-Saving variant it was trained with
+// nb: the lazy variant leads to a different trie, so a dictionary can only be used with the variant it was trained with
+struct Dictionary {
+    uint64_t id = 0; // zero if there is no dictionary
+    uint64_t k = 0;
+    uint64_t max_freq = 0;
+    bool lazy = false;
+    std::vector<TopKTrieEntry> nodes; // in depth-first order, beginning with the root
 
-void setup_encoding(BlockEncodingBase& enc, size_t const k) {
-    enc.register_binary(k-1); // TOK_TRIE_REF
-    enc.register_huffman();   // TOK_LITERAL
+    bool empty() const { return id == 0; }
+
+    // tests whether the dictionary, if any, can be used with the given top-k data structure
+    template<typename Topk>
+    bool fits() const {
+        return empty() || lazy == is_lazy<Topk>;
+    }
+
+    // initializes the given top-k data structure, if there is a dictionary
+    // nb: only top-k data structures that can assign a trie support dictionaries
+    template<typename Topk>
+    void warm(Topk& topk) const {
+        if(!fits<Topk>()) {
+            std::cerr << "the dictionary was trained using the " << (lazy ? "lazy" : "regular") << " Space-Saving variant and cannot be used with the other (see --lazy)" << std::endl;
+            std::abort();
+        }
+        if(!empty()) {
+            if constexpr(requires { topk.assign(nodes); }) {
+                topk.assign(nodes);
+            } else {
+                std::cerr << "dictionaries are not supported by this top-k data structure" << std::endl;
+                std::abort();
+            }
+        }
+    }
+};
+
+// FNV-1a over the variant and the dictionary file, never zero
+inline uint64_t dictionary_id(char const* begin, char const* end, bool const lazy) {
+    uint64_t h = 0xCBF29CE484222325ULL;
+    h = (h ^ uint8_t(lazy)) * 0x100000001B3ULL;
+    for(auto p = begin; p != end; ++p) {
+        h = (h ^ uint8_t(*p)) * 0x100000001B3ULL;
+    }
+    return h ? h : 1;
 }
 
-template<typename Topk, iopp::InputIterator<char> In, iopp::BitSink Out>
-void compress(In begin, In const& end, Out out, size_t const k, size_t const max_freq, size_t const block_size, pm::Result& result) {
-    out.write(MAGIC, 64);
+// writes the frequencies of the nodes below v in depth-first order
+template<typename Topk, std::unsigned_integral NodeIndex, iopp::BitSink Out>
+void encode_frequencies(Topk const& topk, NodeIndex const v, Out& out) {
+    auto const& children = topk.children_of(v);
+    for(size_t i = 0; i < children.size(); i++) {
+        code::EliasDelta::encode(out, uint64_t(topk.frequency(children[i])) + 1);
+        encode_frequencies(topk, children[i], out);
+    }
+}
+
+// feeds a training input to the top-k data structure like compression does
+template<typename Topk, iopp::InputIterator<char> In>
+void train(In begin, In const& end, Topk& topk) {
+    auto s = topk.empty_string();
+    while(begin != end) {
+        auto const next = topk.extend(s, *begin++);
+        s = next.frequent ? next : topk.empty_string();
+    }
+}
+
+// writes the trained top-k data structure as a dictionary
+template<typename Topk, iopp::BitSink Out>
+void write_dictionary(Topk const& topk, size_t const k, size_t const max_freq, Out out, pm::Result& result) {
+    out.write(DICT_MAGIC, 64);
     out.write(k, 64);
     out.write(max_freq, 64);
+    out.write(is_lazy<Topk>);
 
-    // initialize compression
-    // - frequent substring 0 is reserved to indicate a literal character
-    
-    Topk topk(k - 1, max_freq);
+    auto bits0 = out.num_bits_written();
+    encode_topology(topk, topk.root(), out);
+    result.add("outsize_trie_topology", (out.num_bits_written() - bits0) / 8);
+
+    bits0 = out.num_bits_written();
+    {
+        std::string labels;
+        labels.reserve(k - 1);
+        gather_labels(topk, topk.root(), 0, labels);
+        encode_labels(labels, out);
+        result.add("dict_nodes", labels.size());
+    }
+    result.add("outsize_trie_labels", (out.num_bits_written() - bits0) / 8);
+
+    bits0 = out.num_bits_written();
+    encode_frequencies(topk, topk.root(), out);
+    result.add("outsize_trie_freqs", (out.num_bits_written() - bits0) / 8);
+    out.flush();
+}
+
+// reads a dictionary written by write_dictionary
+inline Dictionary read_dictionary(char const* begin, char const* end) {
+    auto in = iopp::bitwise_input_from(begin, end);
+    uint64_t const magic = in.read(64);
+    if(magic != DICT_MAGIC) {
+        std::cerr << "not a dictionary, wrong magic: 0x" << std::hex << magic << " (expected: 0x" << DICT_MAGIC << ")" << std::endl;
+        std::abort();
+    }
+
+    Dictionary dict;
+    dict.k = in.read(64);
+    dict.max_freq = in.read(64);
+    dict.lazy = in.read();
+    dict.id = dictionary_id(begin, end, dict.lazy);
+
+    size_t num_nodes;
+    auto const topology = decode_topology(in, dict.k - 1, num_nodes);
+    auto const labels = decode_labels(in, num_nodes);
+
+    // nb: the parentheses are in depth-first order, like the labels and frequencies
+    dict.nodes.reserve(num_nodes);
+    dict.nodes.push_back(TopKTrieEntry { 0, 0, 0 });
+
+    std::vector<size_t> stack = { 0 };
+    for(size_t i = 1; i + 1 < topology.size(); i++) {
+        if(topology[i]) {
+            auto const v = dict.nodes.size();
+            dict.nodes.push_back(TopKTrieEntry { stack.back(), labels[v], 0 });
+            stack.push_back(v);
+        } else {
+            stack.pop_back();
+        }
+    }
+
+    for(size_t v = 1; v < num_nodes; v++) {
+        dict.nodes[v].freq = code::EliasDelta::decode(in) - 1;
+    }
+    return dict;
+}
+
+// tests whether the given dictionary is the one a compressed file refers to by the given id, if any
+inline bool matches_dictionary(uint64_t const id, Dictionary const& dict) {
+    return id == 0 || id == dict.id;
+}
+
+// verifies that the dictionary a compressed file refers to is available
+inline void check_dictionary(uint64_t const id, Dictionary const& dict) {
+    if(!matches_dictionary(id, dict)) {
+        if(dict.empty()) {
+            std::cerr << "the input was compressed using a dictionary (id 0x" << std::hex << id << std::dec << "), which must be given (see --dict)" << std::endl;
+        } else {
+            std::cerr << "the input was compressed using a different dictionary (id 0x" << std::hex << id << ", given: 0x" << dict.id << std::dec << ")" << std::endl;
+        }
+        std::abort();
+    }
+}
+
+constexpr TokenType TOK_TRIE_REF = 0;
+constexpr TokenType TOK_LITERAL = 1;
+
+void setup_encoding(BlockEncodingBase& enc, size_t const k) {
+    enc.register_adaptive(k-1); // TOK_TRIE_REF
+    enc.register_adaptive(255); // TOK_LITERAL
+}
+
+struct Stats {
     size_t n = 0;
     size_t num_phrases = 0;
     size_t longest = 0;
@@ -40,109 +248,222 @@ void compress(In begin, In const& end, Out out, size_t const k, size_t const max
     size_t furthest = 0;
     size_t total_ref = 0;
 
+    bool measure_latency = false;
+    LatencyHistogram latency; // of the top-k updates, if measured
+
+    void add_to(pm::Result& result) const {
+        result.add("phrases_total", num_phrases);
+        result.add("phrases_longest", longest);
+        result.add("phrases_furthest", furthest);
+        result.add("phrases_avg_len", std::round(100.0 * ((double)total_len / (double)num_phrases)) / 100.0);
+        result.add("phrases_avg_dist", std::round(100.0 * ((double)total_ref / (double)num_phrases)) / 100.0);
+        if(measure_latency) latency.add_to(result, "op");
+    }
+};
+
+// parses the input and encodes the phrases until the end of the input is reached, or until a phrase ends after at least max_len characters have been read
+template<typename Topk, iopp::InputIterator<char> In, iopp::BitSink Out>
+void encode(In& begin, In const& end, Out& out, Topk& topk, size_t const k, size_t const block_size, bool const align_blocks, size_t const max_len, size_t const num_threads, Stats& stats) {
     // initialize encoding
-    BlockEncoder enc(out, block_size);
+    BlockEncoder enc(out, block_size, align_blocks);
     setup_encoding(enc, k);
 
-    auto s = topk.empty_string();
-    auto handle = [&](char const c) {
-        auto next = topk.extend(s, c);
-        if(!next.frequent) {
-            longest = std::max(longest, size_t(next.len));
-            total_len += next.len;
-            furthest = std::max(furthest, size_t(s.node));
-            total_ref += s.node;
-            enc.write_uint(TOK_TRIE_REF, s.node);
-            enc.write_char(TOK_LITERAL, c);
+    // nb: this thread parses the input, while the other threads entropy code full blocks (see BlockEncoder)
+    #pragma omp parallel num_threads(num_threads)
+    #pragma omp single
+    {
+        size_t len = 0;
+        auto s = topk.empty_string();
+        TokenContext ctx = 0; // the two preceding characters, the context of literals for context mixing
+        while(begin != end) {
+            // read next character
+            auto const c = *begin++;
+            ++len;
 
-            if constexpr(PROTOCOL) std::cout << "(" << s.node << ") 0x" << std::hex << (size_t)c << std::dec << std::endl;
+            typename Topk::StringState next;
+            if(stats.measure_latency) {
+                auto const t0 = LatencyHistogram::now();
+                next = topk.extend(s, c);
+                stats.latency.add(t0, LatencyHistogram::now());
+            } else {
+                next = topk.extend(s, c);
+            }
 
-            s = topk.empty_string();
-            ++num_phrases;
-        } else {
-            s = next;
+            if(!next.frequent) {
+                stats.longest = std::max(stats.longest, size_t(next.len));
+                stats.total_len += next.len;
+                stats.furthest = std::max(stats.furthest, size_t(s.node));
+                stats.total_ref += s.node;
+                enc.write_uint(TOK_TRIE_REF, s.node);
+                enc.write_char(TOK_LITERAL, c, ctx);
+
+                if constexpr(PROTOCOL) *DebugOutput::stream << "(" << s.node << ") 0x" << std::hex << (size_t)c << std::dec << std::endl;
+
+                s = topk.empty_string();
+                ++stats.num_phrases;
+
+                if(len >= max_len) break;
+            } else {
+                s = next;
+            }
+            ctx = (ctx << 8) | uint8_t(c);
         }
-    };
+        stats.n += len;
 
-    while(begin != end) {
-        // read next character
-        ++n;
-        handle(*begin++);
-    }
+        // encode final phrase, if any
+        // nb: this can only happen at the end of the input
+        if(s.len > 0) {
+            enc.write_uint(TOK_TRIE_REF, s.node);
+            ++stats.num_phrases;
 
-    // encode final phrase, if any
-    if(s.len > 0) {
-        enc.write_uint(TOK_TRIE_REF, s.node);
-        ++num_phrases;
+            if constexpr(PROTOCOL) *DebugOutput::stream << "(" << s.node << ")" << std::endl;
+        }
 
-        if constexpr(PROTOCOL) std::cout << "(" << s.node << ")" << std::endl;
+        enc.flush();
     }
+}
 
-    enc.flush();
+template<typename Topk, iopp::InputIterator<char> In, iopp::BitSink Out>
+void compress(In begin, In const& end, Out out, size_t const k, size_t const max_freq, size_t const block_size, bool const align_blocks, size_t const num_threads, Dictionary const& dict, pm::Result& result, bool const measure_latency = false) {
+    out.write(magic_for<Topk>, 64);
+    out.write(k, 64);
+    out.write(max_freq, 64);
+    out.write(dict.id, 64);
+
+    // initialize compression
+    // - frequent substring 0 is reserved to indicate a literal character
+    Topk topk(k - 1, max_freq);
+    dict.warm(topk);
+
+    Stats stats;
+    stats.measure_latency = measure_latency;
+    encode(begin, end, out, topk, k, block_size, align_blocks, SIZE_MAX, num_threads, stats);
     
     // stats
     topk.print_debug_info();
-    result.add("phrases_total", num_phrases);
-    result.add("phrases_longest", longest);
-    result.add("phrases_furthest", furthest);
-    result.add("phrases_avg_len", std::round(100.0 * ((double)total_len / (double)num_phrases)) / 100.0);
-    result.add("phrases_avg_dist", std::round(100.0 * ((double)total_ref / (double)num_phrases)) / 100.0);
+    stats.add_to(result);
 }
 
-template<typename Topk, iopp::BitSource In, std::output_iterator<char> Out>
-void decompress(In in, Out out) {
-    // decode header
-    uint64_t const magic = in.read(64);
-    if(magic != MAGIC) {
-        std::cerr << "wrong magic: 0x" << std::hex << magic << " (expected: 0x" << MAGIC << ")" << std::endl;
-        std::abort();
-    }
+// compresses the input into a framed container
+// each frame begins with a snapshot of the top-k structure and is cut at the first phrase boundary after frame_size characters
+template<typename Topk, iopp::InputIterator<char> In, std::output_iterator<char> Out>
+void compress_framed(In begin, In const& end, Out out, size_t const k, size_t const max_freq, size_t const block_size, bool const align_blocks, size_t const num_threads, size_t const frame_size, Dictionary const& dict, pm::Result& result, bool const measure_latency = false) {
+    frames::FrameWriter writer(out, framed_magic_for<Topk>, { k, max_freq, dict.id });
 
-    auto const k = in.read(64);
-    auto const max_freq = in.read(64);
-
-    // initialize decompression
+    // initialize compression
     // - frequent substring 0 is reserved to indicate a literal character
     Topk topk(k - 1, max_freq);
+    dict.warm(topk);
 
-    size_t n = 0;
-    size_t num_phrases = 0;
+    Stats stats;
+    stats.measure_latency = measure_latency;
+    std::string frame;
+    size_t snapshot_bits = 0;
+    while(begin != end) {
+        auto const frame_pos = stats.n;
+
+        frame.clear();
+        {
+            auto frame_out = iopp::bitwise_output_to(std::back_inserter(frame));
+
+            // the first frame starts with the initial state (the dictionary, if any) and needs no snapshot
+            bool const initial = (frame_pos == 0);
+            frame_out.write(initial);
+            if(!initial) topk.encode_snapshot(frame_out);
+            snapshot_bits += frame_out.num_bits_written();
+
+            encode(begin, end, frame_out, topk, k, block_size, align_blocks, frame_size, num_threads, stats);
+        }
+        writer.write_frame(frame, frame_pos);
+    }
+    writer.finish(stats.n);
+
+    // stats
+    topk.print_debug_info();
+    stats.add_to(result);
+    result.add("frames", writer.num_frames());
+    result.add("outsize_snapshots", snapshot_bits / 8);
+}
 
+// decodes phrases until the input is exhausted
+template<typename Topk, iopp::BitSource In, std::output_iterator<char> Out>
+void decode(In& in, Topk& topk, size_t const k, Out out) {
     // initialize decoding
     BlockDecoder dec(in);
     setup_encoding(dec, k);
 
-    char* phrase = new char[k]; // phrases can be of length up to k...
-    while(in) {
+    auto phrase = std::make_unique<char[]>(k); // phrases can be of length up to k...
+    TokenContext ctx = 0; // the two preceding characters, the context of literals for context mixing
+    while(dec) {
         // decode and handle phrase
         auto const x = dec.read_uint(TOK_TRIE_REF);
-        if constexpr(PROTOCOL) std::cout << "(" << x << ")";
+        if constexpr(PROTOCOL) *DebugOutput::stream << "(" << x << ")";
 
-        auto const phrase_len = topk.get(x, phrase);
-        
-        ++num_phrases;
-        n += phrase_len;
+        auto const phrase_len = topk.get(x, phrase.get());
 
         auto s = topk.empty_string();
         for(size_t i = 0; i < phrase_len; i++) {
             auto const c = phrase[i];
             s = topk.extend(s, c);
             *out++ = c;
+            ctx = (ctx << 8) | uint8_t(c);
         }
 
         // decode and handle literal
-        if(in)
+        if(dec)
         {
-            auto const literal = dec.read_char(TOK_LITERAL);
+            auto const literal = dec.read_char(TOK_LITERAL, ctx);
             topk.extend(s, literal);
             *out++ = literal;
-            ++n;
+            ctx = (ctx << 8) | uint8_t(literal);
 
-            if constexpr(PROTOCOL) std::cout << " 0x" << std::hex << (size_t)literal << std::dec;
+            if constexpr(PROTOCOL) *DebugOutput::stream << " 0x" << std::hex << (size_t)literal << std::dec;
         }
 
-        if constexpr(PROTOCOL) std::cout << std::endl;
+        if constexpr(PROTOCOL) *DebugOutput::stream << std::endl;
+    }
+}
+
+template<typename Topk, iopp::BitSource In, std::output_iterator<char> Out>
+void decompress(In in, Out out, Dictionary const& dict) {
+    // decode header
+    uint64_t const magic = in.read(64);
+    if(magic != magic_for<Topk>) {
+        std::cerr << "wrong magic: 0x" << std::hex << magic << " (expected: 0x" << magic_for<Topk> << ")" << std::endl;
+        std::abort();
     }
+
+    auto const k = in.read(64);
+    auto const max_freq = in.read(64);
+    uint64_t const dict_id = in.read(64);
+    check_dictionary(dict_id, dict);
+
+    // initialize decompression
+    // - frequent substring 0 is reserved to indicate a literal character
+    Topk topk(k - 1, max_freq);
+    if(dict_id) dict.warm(topk);
+    decode(in, topk, k, out);
+}
+
+// decodes the characters in the range [range_begin, range_end) from a framed container
+// frames are independent, so up to num_threads of them are decoded concurrently
+template<typename Topk, std::output_iterator<char> Out>
+void decompress_framed(char const* begin, char const* end, Dictionary const& dict, Out out, size_t const range_begin = 0, size_t const range_end = SIZE_MAX, size_t const num_threads = 1) {
+    frames::FrameReader reader(begin, end, framed_magic_for<Topk>, 3);
+    auto const k = reader.param(0);
+    auto const max_freq = reader.param(1);
+    auto const dict_id = reader.param(2);
+    check_dictionary(dict_id, dict);
+
+    reader.decode_range(range_begin, range_end, out, [&](size_t const i, std::string& buffer){
+        auto in = iopp::bitwise_input_from(reader.frame_begin(i), reader.frame_end(i));
+
+        Topk topk(k - 1, max_freq);
+        bool const initial = in.read();
+        if(!initial) topk.decode_snapshot(in);
+        else if(dict_id) dict.warm(topk);
+        decode(in, topk, k, std::back_inserter(buffer));
+    }, num_threads);
 }
 
 }
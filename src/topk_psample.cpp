@@ -42,7 +42,7 @@ struct Compressor : public CompressorBase {
         return ".topkpsample";
     }
 
-    virtual void compress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) override {
+    virtual void compress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) override {
         auto const m = 1ULL << len_exp_max;
         if(window < m) {
             std::cerr << "window too small -- must at least fit the longest considered string length" << std::endl;
@@ -52,7 +52,7 @@ struct Compressor : public CompressorBase {
         topk_psample::compress<TopKStringsMisraGries<>>(in.begin(), in.end(), iopp::StreamOutputIterator(out), window, sample_rsh, len_exp_min, len_exp_max, min_dist, k, sketch_rows, sketch_columns, result);
     }
     
-    virtual void decompress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) override {
+    virtual void decompress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) override {
         topk_psample::decompress<TopKStringsMisraGries<>>(in.begin(), in.end(), iopp::StreamOutputIterator(out));
     }
 };
@@ -5,6 +5,7 @@
 #include <queue>
 #include <vector>
 
+#include <debug_output.hpp>
 #include <display.hpp>
 #include <rolling_karp_rabin.hpp>
 #include <write_bytes.hpp>
@@ -122,7 +123,7 @@ void compress(In begin, In const& end, Out out, size_t const window, size_t cons
             t.start();
 
             if constexpr(DEBUG) {
-                std::cout << "processing block " << blocknum << " (" << blocksize << " bytes) ..." << std::endl;
+                *DebugOutput::stream << "processing block " << blocknum << " (" << blocksize << " bytes) ..." << std::endl;
             }
 
             #pragma omp parallel for
@@ -167,7 +168,7 @@ void compress(In begin, In const& end, Out out, size_t const window, size_t cons
 
                             if constexpr(DEBUG) {
                                 if(omp_get_num_threads() == 1) {
-                                    std::cout << "\ti=" << global_pos << ": found string \"" << s << "\" (length " << len
+                                    *DebugOutput::stream << "\ti=" << global_pos << ": found string \"" << s << "\" (length " << len
                                         << ", fingerprint 0x" << std::hex << fp[l] << std::dec << ") in slot " << slot << ", last seen at position " << src[l][slot] << std::endl;
                                 }
                             }
@@ -183,7 +184,7 @@ void compress(In begin, In const& end, Out out, size_t const window, size_t cons
                             src[l][slot] = global_pos;
                             if constexpr(DEBUG) {
                                 if(omp_get_num_threads() == 1) {
-                                    std::cout << "\ti=" << global_pos << ": inserted string \"" << s << "\" (length " << len
+                                    *DebugOutput::stream << "\ti=" << global_pos << ": inserted string \"" << s << "\" (length " << len
                                         << ", fingerprint 0x" << std::hex << fp[l] << std::dec << ") into slot " << slot << std::endl;
                                 }
                             }
@@ -201,7 +202,7 @@ void compress(In begin, In const& end, Out out, size_t const window, size_t cons
             t.start();
 
             if constexpr(DEBUG) {
-                std::cout << "encoding block " << blocknum << " ..." << std::endl;
+                *DebugOutput::stream << "encoding block " << blocknum << " ..." << std::endl;
             }
 
             size_t cur[num_lens];
@@ -240,7 +241,7 @@ void compress(In begin, In const& end, Out out, size_t const window, size_t cons
                 while(j < ref_pos) {
                     ++num_literals;
                     auto const c = (char)block[j];
-                    if constexpr(PROTOCOL) std::cout << "i=" << (block_offs + j) << ": " << display(c) << std::endl;
+                    if constexpr(PROTOCOL) *DebugOutput::stream << "i=" << (block_offs + j) << ": " << display(c) << std::endl;
                     *out++ = c;
                     if(c == SIGNAL) write_uint(out, 0, REF_BYTES); // nb: make SIGNAL decodable
                     ++j;
@@ -260,7 +261,7 @@ void compress(In begin, In const& end, Out out, size_t const window, size_t cons
                     total_dist += dist;
                     furthest = std::max(dist, furthest);
 
-                    if constexpr(PROTOCOL) std::cout << "i=" << (block_offs + j) << ": (" << ref_src << ", " << len << ")" << std::endl;
+                    if constexpr(PROTOCOL) *DebugOutput::stream << "i=" << (block_offs + j) << ": (" << ref_src << ", " << len << ")" << std::endl;
                     *out++ = SIGNAL;
                     write_uint(out, dist, REF_BYTES);
                     write_uint(out, ref_l, 1);
@@ -316,7 +317,7 @@ void decompress(In in, In const end, Out out) {
             auto const delta = read_uint(in, REF_BYTES);
             if(delta == 0) {
                 // we decoded a signal literal
-                if constexpr(PROTOCOL) std::cout << "i=" << s.size() << ": " << display(SIGNAL) << std::endl;
+                if constexpr(PROTOCOL) *DebugOutput::stream << "i=" << s.size() << ": " << display(SIGNAL) << std::endl;
                 s.push_back(SIGNAL);
             } else {
                 // copy characters
@@ -326,14 +327,14 @@ void decompress(In in, In const end, Out out) {
                 auto const len = get_len(l, len_exp_min);
 
                 auto src = s.size() - delta;
-                if constexpr(PROTOCOL) std::cout << "i=" << s.size() << ": (" << src << ", " << len << ")" << std::endl;
+                if constexpr(PROTOCOL) *DebugOutput::stream << "i=" << s.size() << ": (" << src << ", " << len << ")" << std::endl;
 
                 for(size_t i = 0; i < len; i++) {
                     s.push_back(s[src++]);
                 }
             }
         } else {
-            if constexpr(PROTOCOL) std::cout << "i=" << s.size() << ": " << display(c) << std::endl;
+            if constexpr(PROTOCOL) *DebugOutput::stream << "i=" << s.size() << ": " << display(c) << std::endl;
             s.push_back(c);
         }
     }
@@ -5,25 +5,39 @@
 
 struct Compressor : public TopkCompressor {
     uint64_t ignored_ = 0;
+    unsigned int threads = 1;
+    bool merge_summaries = false;
 
     Compressor() : TopkCompressor("topk-twopass", "two passes") {
         param('w', "window", ignored_, "Ignored, provided only for interoperability.");
+        param('j', "threads", threads, "The number of threads to use; the input is split into as many chunks, which are parsed concurrently.");
+        param("merge-summaries", merge_summaries, "(Experimental) Build the trie by merging summaries of the chunks computed concurrently, rather than from a single summary of the whole input.");
     }
 
     virtual void init_result(pm::Result& result) override {
         result.add("algo", "topk-twopass");
         TopkCompressor::init_result(result);
+        result.add("threads", threads);
+        result.add("merge_summaries", merge_summaries);
     }
 
     virtual std::string file_ext() override {
         return ".topk2pass";
     }
 
-    virtual void compress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) override {
-        topk_twopass::compress(in, iopp::bitwise_output_to(out), k, max_freq, block_size, result);
+    virtual void compress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) override {
+        topk_twopass::compress(in.begin(), in.end(), iopp::bitwise_output_to(out), k, max_freq, block_size, std::max(threads, 1U), merge_summaries, result);
     }
     
-    virtual void decompress(iopp::FileInputStream& in, iopp::FileOutputStream& out, pm::Result& result) override {
+    virtual void decompress(MemoryMappedFile const& in, std::ostream& out, pm::Result& result) override {
+        topk_twopass::decompress(iopp::bitwise_input_from(in.begin(), in.end()), iopp::StreamOutputIterator(out));
+    }
+
+    virtual bool can_decompress_stream() override {
+        return true;
+    }
+
+    virtual void decompress_stream(StreamInput& in, std::ostream& out, pm::Result& result) override {
         topk_twopass::decompress(iopp::bitwise_input_from(in.begin(), in.end()), iopp::StreamOutputIterator(out));
     }
 };
@@ -1,21 +1,25 @@
 #include <iopp/file_input_stream.hpp>
 #include <iopp/file_output_stream.hpp>
 #include <block_coding.hpp>
+#include <debug_output.hpp>
 
 #include <pm/result.hpp>
 
 #include <code/counter.hpp>
 
 #include <topk_prefixes_misra_gries.hpp>
-#include <simple_trie.hpp>
+#include <louds_trie.hpp>
 #include <small_trie.hpp>
+#include <trie_coding.hpp>
 
+#include <iterator>
 #include <stack>
 #include <unordered_map>
 #include <vector>
 
 namespace topk_twopass {
 
+// nb: trie references used to be depth-first node numbers, the magic number was changed when they became LOUDS numbers
 constexpr uint64_t MAGIC =
     ((uint64_t)'T') << 56 |
     ((uint64_t)'O') << 48 |
@@ -23,7 +27,7 @@ constexpr uint64_t MAGIC =
     ((uint64_t)'K') << 32 |
     ((uint64_t)'2') << 24 |
     ((uint64_t)'P') << 16 |
-    ((uint64_t)'S') << 8 |
+    ((uint64_t)'L') << 8 |
     ((uint64_t)'S');
 
 using Node = uint32_t;
@@ -38,31 +42,8 @@ void setup_encoding(BlockEncodingBase& enc, size_t const k) {
     enc.register_binary(255, false);   // TOK_LITERAL
 }
 
-template<typename Trie>
-void gather_labels(Trie const& trie, Node const v, char const inlabel, std::string& labels) {
-    labels.push_back(inlabel);
-
-    auto const& children = trie.children_of(v);
-    for(size_t i = 0; i < children.size(); i++) { 
-        gather_labels(trie, children[i], children.label(i), labels);
-    }
-}
-
-template<typename Trie, iopp::BitSink Out>
-void encode_topology(Trie const& trie, Node const v, Out& out) {
-    // balanced parantheses
-    out.write(bool(1));
-    
-    auto const& children = trie.children_of(v);
-    for(size_t i = 0; i < children.size(); i++) {
-        encode_topology(trie, children[i], out);
-    }
-
-    out.write(bool(0));
-}
-
 template<iopp::InputIterator<char> In>
-auto compute_topk(In begin, In const end, size_t const k, size_t const max_freq) {
+Topk summarize(In begin, In const end, size_t const k, size_t const max_freq) {
     Topk topk(k - 1, max_freq);
     auto s = topk.empty_string();
     while(begin != end) {
@@ -71,12 +52,43 @@ auto compute_topk(In begin, In const end, size_t const k, size_t const max_freq)
         auto next = topk.extend(s, c);
         s = next.frequent ? next : topk.empty_string();
     }
+    return topk;
+}
+
+template<iopp::InputIterator<char> In>
+auto compute_topk(In begin, In const end, size_t const k, size_t const max_freq) {
+    auto topk = summarize(begin, end, k, max_freq);
 
     // reduce top-k trie to a simple ("static") trie, depth-first
     auto topk_trie = std::move(topk.trie());
     return topk_trie;
 }
 
+// builds the top-k trie from summaries of chunks of the input that are computed concurrently (experimental)
+// the summaries are merged pairwise in rounds (see TopKPrefixesMisraGries::merge)
+template<std::forward_iterator In>
+auto compute_topk_merged(In const begin, In const end, size_t const k, size_t const max_freq, size_t const num_chunks) {
+    auto const n = size_t(std::distance(begin, end));
+
+    std::vector<Topk> summaries(num_chunks);
+    #pragma omp parallel for num_threads(num_chunks)
+    for(size_t i = 0; i < num_chunks; i++) {
+        summaries[i] = summarize(std::next(begin, n * i / num_chunks), std::next(begin, n * (i + 1) / num_chunks), k, max_freq);
+    }
+
+    for(size_t step = 1; step < num_chunks; step *= 2) {
+        #pragma omp parallel for num_threads(num_chunks)
+        for(size_t i = 0; i < num_chunks - step; i += 2 * step) {
+            summaries[i].merge(summaries[i + step]);
+            summaries[i + step] = Topk();
+        }
+    }
+
+    // reduce top-k trie to a simple ("static") trie, depth-first
+    auto topk_trie = std::move(summaries[0].trie());
+    return topk_trie;
+}
+
 struct Phrase {
     uintmax_t node;
     uintmax_t len;
@@ -133,8 +145,42 @@ void parse(In begin, In const end, Trie const& trie, std::function<void(Phrase)>
     }
 }
 
-template<iopp::BitSink Out>
-void compress(iopp::FileInputStream& in, Out out, size_t const k, size_t const max_freq, size_t const block_size, pm::Result& result) {
+// statistics about a parsing
+struct ParseStats {
+    size_t num_literal = 0;
+    size_t num_trie = 0;
+    size_t longest = 0;
+    size_t total_len = 0;
+
+    void operator+=(ParseStats const& other) {
+        num_literal += other.num_literal;
+        num_trie += other.num_trie;
+        longest = std::max(longest, other.longest);
+        total_len += other.total_len;
+    }
+};
+
+// nb: trie nodes are encoded by their numbers in the decoder's LoudsTrie, as given by node_ids
+template<std::forward_iterator In, typename Trie, typename Encoder>
+void parse_and_encode(In const begin, In const& end, Trie const& trie, std::vector<size_t> const& node_ids, Encoder& enc, ParseStats& stats) {
+    parse(begin, end, trie, [&](Phrase f){
+        if(f.is_literal()) {
+            enc.write_uint(TOK_TRIE_REF, 0);
+            enc.write_uint(TOK_LITERAL, f.literal);
+            ++stats.num_literal;
+        } else {
+            enc.write_uint(TOK_TRIE_REF, node_ids[f.node]);
+            stats.total_len += f.len;
+            stats.longest = std::max(stats.longest, f.len);
+            ++stats.num_trie;
+        }
+    });
+}
+
+// if num_threads is greater than one, the input is split into as many chunks, which are parsed concurrently
+// if merge_summaries is set, the trie is also built from concurrently computed summaries of these chunks (see compute_topk_merged)
+template<std::forward_iterator In, iopp::BitSink Out>
+void compress(In const begin, In const& end, Out out, size_t const k, size_t const max_freq, size_t const block_size, size_t const num_threads, bool const merge_summaries, pm::Result& result) {
     // write header and initialize encoding
     out.write(MAGIC, 64);
     out.write(k, 64);
@@ -144,7 +190,9 @@ void compress(iopp::FileInputStream& in, Out out, size_t const k, size_t const m
     sw.start();
 
     using ReducedTrie = SmallTrie<false>; // SimpleTrie<Node>;
-    ReducedTrie trie(compute_topk(in.begin(), in.end(), k, max_freq));
+    ReducedTrie trie = merge_summaries
+        ? ReducedTrie(compute_topk_merged(begin, end, k, max_freq, num_threads))
+        : ReducedTrie(compute_topk(begin, end, k, max_freq));
 
     sw.stop();
     result.add("time_build", (size_t)sw.elapsed_time_millis());
@@ -169,14 +217,7 @@ void compress(iopp::FileInputStream& in, Out out, size_t const k, size_t const m
             std::string labels;
             labels.reserve(k-1);
             gather_labels(trie, trie.root(), 0, labels);
-
-            code::HuffmanTree<char> huff(labels.begin(), labels.end());
-            huff.encode(out);
-
-            auto table = huff.table();
-            for(auto const c : labels) {
-                code::Huffman::encode(out, uint8_t(c), table);
-            }
+            encode_labels(labels, out);
         }
         
         auto const size_trie_labels = (out.num_bits_written() - bits0) / 8;
@@ -196,44 +237,49 @@ void compress(iopp::FileInputStream& in, Out out, size_t const k, size_t const m
 
     // pass 2: parse
 
-    // stats
-    size_t num_literal = 0;
-    size_t num_trie = 0;
-    size_t longest = 0;
-    size_t total_len = 0;
+    // number the nodes like the decoder does
+    auto const node_ids = LoudsTrie::numbering(trie);
+
+    ParseStats stats;
 
     // initialize encoding
     BlockEncoder enc(out, block_size);
     setup_encoding(enc, k);
 
     sw.start();
-    {
-        in.seekg(0, std::ios::beg);
-
-        parse(in.begin(), in.end(), trie, [&](Phrase f){
-            if(f.is_literal()) {
-                enc.write_uint(TOK_TRIE_REF, 0);
-                enc.write_uint(TOK_LITERAL, f.literal);
-                ++num_literal;
-            } else {
-                enc.write_uint(TOK_TRIE_REF, f.node);
-                total_len += f.len;
-                longest = std::max(longest, f.len);
-                ++num_trie;
-            }
-        });
+    if(num_threads > 1) {
+        // nb: the trie is static, so chunks of the input can be parsed independently, each starting at the root of the trie and ending with a complete phrase
+        // every chunk is encoded into blocks of its own, which are then appended to the output in order
+        auto const n = size_t(std::distance(begin, end));
+        std::vector<BitWriter> chunk_out(num_threads);
+        std::vector<ParseStats> chunk_stats(num_threads);
+
+        #pragma omp parallel for num_threads(num_threads)
+        for(size_t i = 0; i < num_threads; i++) {
+            BlockEncoder chunk_enc(chunk_out[i], block_size, BlockEncoder<BitWriter>::BlocksOnly{});
+            setup_encoding(chunk_enc, k);
+            parse_and_encode(std::next(begin, n * i / num_threads), std::next(begin, n * (i + 1) / num_threads), trie, node_ids, chunk_enc, chunk_stats[i]);
+            chunk_enc.flush();
+        }
 
-        enc.flush();
+        for(size_t i = 0; i < num_threads; i++) {
+            enc.append_blocks(chunk_out[i]);
+            stats += chunk_stats[i];
+        }
+    } else {
+        // nb: the input is a forward range, so we can simply parse it a second time
+        parse_and_encode(begin, end, trie, node_ids, enc, stats);
     }
+    enc.flush();
     sw.stop();
     result.add("time_parse", (size_t)sw.elapsed_time_millis());
 
-    auto const num_phrases = num_literal + num_trie;
-    result.add("phrases_total", num_literal + num_trie);
-    result.add("phrases_literal", num_literal);
-    result.add("phrases_trie", num_trie);
-    result.add("phrases_longest", longest);
-    result.add("phrases_avg_len", std::round(100.0 * ((double)total_len / (double)num_phrases)) / 100.0);
+    auto const num_phrases = stats.num_literal + stats.num_trie;
+    result.add("phrases_total", num_phrases);
+    result.add("phrases_literal", stats.num_literal);
+    result.add("phrases_trie", stats.num_trie);
+    result.add("phrases_longest", stats.longest);
+    result.add("phrases_avg_len", std::round(100.0 * ((double)stats.total_len / (double)num_phrases)) / 100.0);
 }
 
 template<iopp::BitSource In, std::output_iterator<char> Out>
@@ -245,58 +291,27 @@ void decompress(In in, Out out) {
     }
 
     auto const k = in.read(64);
-    size_t num_nodes = 1;
 
     // decode trie
-    using ReducedTrie = SmallTrie<true>; // SimpleTrie<Node>
+    // nb: the decoder only needs to spell nodes, so the trie is kept succinct
+    using ReducedTrie = LoudsTrie;
     ReducedTrie trie;
     {
         // topology
-        std::vector<bool> topology;
-        topology.reserve(2 * k);
-        {
-            const bool open_root = in.read();
-            assert(open_root == true); // nb: must at least open the root ...
-
-            topology.push_back(open_root);
-
-            size_t dv = 1;
-            while(dv) {
-                const bool b = in.read();
-                if(b) {
-                    // open node
-                    ++dv;
-                    ++num_nodes;
-                } else {
-                    // close node
-                    --dv;
-                }
-                topology.push_back(b);
-            }
-        }
-
-        assert(topology.size() % 2 == 0);
-        assert(topology.size() / 2 == num_nodes);
-        assert(topology.size() / 2 <= k);
+        size_t num_nodes;
+        auto const topology = decode_topology(in, k, num_nodes);
+        assert(num_nodes <= k);
 
         // labels
-        std::string labels;
-        labels.reserve(num_nodes);
-        {
-            code::HuffmanTree<char> huff(in);
-            for(size_t i = 0; i < num_nodes; i++) {
-                labels.push_back(code::Huffman::decode(in, huff.root()));
-            }
-        }
+        auto const labels = decode_labels(in, num_nodes);
 
         // reconstruct trie from topology and labels
-        SimpleTrie<Node> simple_trie(topology, labels);
-        trie = ReducedTrie(simple_trie);
+        trie = ReducedTrie(topology, labels);
     }
 
     {
         auto const trie_mem = trie.mem_size();
-        std::cout << "# trie_mem=" << trie_mem
+        *DebugOutput::stream << "# trie_mem=" << trie_mem
             << ", trie_mem_avg_per_node=" << std::round(100.0 * ((double)trie_mem / (double)k)) / 100.0 << std::endl;
     }
 
@@ -305,7 +320,7 @@ void decompress(In in, Out out) {
     setup_encoding(dec, k);
     auto buffer = std::make_unique<char[]>(k);
 
-    while(in) {
+    while(dec) {
         auto const v = dec.read_uint(TOK_TRIE_REF);
         if(v == 0) {
             // literal
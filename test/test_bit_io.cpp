@@ -0,0 +1,139 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <random>
+#include <vector>
+
+#include <bit_io.hpp>
+
+// hides how many bits are left in a BitReader, so that BitLookahead buffers peeked bits one by one
+class UnsizedReader {
+private:
+    BitReader reader_;
+
+public:
+    UnsizedReader(BitReader const& reader) : reader_(reader) {
+    }
+
+    bool read() { return reader_.read(); }
+    uintmax_t read(size_t const bits) { return reader_.read(bits); }
+    explicit operator bool() const { return bool(reader_); }
+};
+
+template<typename Reader>
+void check_lookahead() {
+    size_t const N = 10'000;
+    size_t const SEED = 369;
+
+    std::vector<uint64_t> values(N);
+    std::vector<size_t> widths(N);
+    BitWriter writer;
+    {
+        std::mt19937_64 gen(SEED);
+        std::uniform_int_distribution<size_t> width(1, BitLookahead<Reader>::MAX_PEEK);
+        for(size_t i = 0; i < N; i++) {
+            widths[i] = width(gen);
+            values[i] = gen() >> (64 - widths[i]);
+            writer.write(values[i], widths[i]);
+        }
+    }
+
+    // peek, skip and read in turns, peeking at most MAX_PEEK bits beyond the current code
+    auto const words = writer.words();
+    Reader reader(BitReader(words.data(), writer.num_bits_written()));
+    BitLookahead in(reader);
+    for(size_t i = 0; i < N; i++) {
+        auto const w = widths[i];
+        auto const peeked = in.peek(BitLookahead<Reader>::MAX_PEEK);
+        REQUIRE((peeked >> (BitLookahead<Reader>::MAX_PEEK - w)) == values[i]);
+        if(i % 3 == 0) in.skip(w);
+        else if(i % 3 == 1) REQUIRE(in.read(w) == values[i]);
+        else for(size_t j = 0; j < w; j++) REQUIRE(in.read() == bool((values[i] >> (w - 1 - j)) & 1));
+    }
+    REQUIRE(!in);
+
+    // peeking past the end yields zeros
+    BitWriter one;
+    one.write(true);
+    auto const one_words = one.words();
+    Reader one_reader(BitReader(one_words.data(), 1));
+    BitLookahead one_in(one_reader);
+    REQUIRE(one_in.peek(8) == 0x80);
+    one_in.skip(1);
+    REQUIRE(!one_in);
+}
+
+TEST_SUITE("bit_io") {
+    TEST_CASE("roundtrip") {
+        size_t const N = 100'000;
+        size_t const SEED = 777;
+
+        std::vector<uint64_t> values(N);
+        std::vector<size_t> widths(N);
+        {
+            std::mt19937_64 gen(SEED);
+            std::uniform_int_distribution<size_t> width(0, 64);
+            for(size_t i = 0; i < N; i++) {
+                widths[i] = width(gen);
+                values[i] = widths[i] ? (gen() >> (64 - widths[i])) : 0;
+            }
+        }
+
+        BitWriter writer;
+        size_t total = 0;
+        for(size_t i = 0; i < N; i++) {
+            if(widths[i] == 1) writer.write(bool(values[i]));
+            else writer.write(values[i], widths[i]);
+            total += widths[i];
+        }
+        REQUIRE(writer.num_bits_written() == total);
+
+        // appending to another sink must yield the same bits
+        BitWriter copy;
+        copy.write(true);
+        writer.append_to(copy);
+        REQUIRE(copy.num_bits_written() == total + 1);
+
+        auto const words = writer.words();
+        BitReader reader(words.data(), writer.num_bits_written());
+        for(size_t i = 0; i < N; i++) {
+            if(widths[i] > 0) REQUIRE(reader.peek(widths[i]) == values[i]);
+            REQUIRE(reader.read(widths[i]) == values[i]);
+        }
+        REQUIRE(!reader);
+
+        auto const copy_words = copy.words();
+        BitReader copy_reader(copy_words.data(), copy.num_bits_written());
+        REQUIRE(copy_reader.read());
+        for(size_t i = 0; i < N; i++) {
+            REQUIRE(copy_reader.read(widths[i]) == values[i]);
+        }
+    }
+
+    TEST_CASE("fixed") {
+        size_t const N = 10'001;
+        size_t const SEED = 147;
+
+        for(size_t bits : { 1, 7, 8, 13, 32, 33, 64 }) {
+            std::vector<uint64_t> values(N);
+            std::mt19937_64 gen(SEED);
+            for(auto& x : values) x = gen() >> (64 - bits);
+
+            BitWriter fixed, single;
+            write_fixed(fixed, values.data(), N, bits);
+            for(auto const x : values) single.write(x, bits);
+            REQUIRE(fixed.words() == single.words());
+
+            auto const words = fixed.words();
+            BitReader reader(words.data(), fixed.num_bits_written());
+            std::vector<uint64_t> decoded(N);
+            read_fixed(reader, decoded.data(), N, bits);
+            REQUIRE(decoded == values);
+        }
+    }
+
+    TEST_CASE("lookahead") {
+        check_lookahead<BitReader>();
+        check_lookahead<UnsizedReader>();
+    }
+}
@@ -0,0 +1,119 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <iopp/bitwise_io.hpp>
+#include <pm/result.hpp>
+
+#include <block_coding.hpp>
+
+constexpr size_t BLOCK_SIZE = 100;
+constexpr Token MAX_BINARY = 1'000;
+
+// some bits written before the block stream, such that it does not start at a byte boundary
+constexpr uint64_t PREFIX = 0x5A5;
+constexpr size_t PREFIX_BITS = 11;
+
+struct Tokens {
+    std::vector<Token> huffman;
+    std::vector<Token> binary;
+};
+
+Tokens generate_tokens(size_t const n, size_t const seed) {
+    std::mt19937 gen(seed);
+    std::geometric_distribution<Token> random_huffman(0.1);
+    std::uniform_int_distribution<Token> random_binary(0, MAX_BINARY);
+
+    Tokens t;
+    for(size_t i = 0; i < n; i++) {
+        t.huffman.push_back(random_huffman(gen));
+        t.binary.push_back(random_binary(gen));
+    }
+    return t;
+}
+
+template<typename Coder>
+void setup(Coder& coder) {
+    coder.register_huffman();
+    coder.register_binary(MAX_BINARY);
+}
+
+// writes the tokens using the iopp bit sink, alternating between the two token types
+std::string encode(Tokens const& t, bool const aligned) {
+    std::string buffer;
+    {
+        auto out = iopp::bitwise_output_to(std::back_inserter(buffer));
+        out.write(PREFIX, PREFIX_BITS);
+
+        BlockEncoder enc(out, BLOCK_SIZE, aligned);
+        setup(enc);
+        for(size_t i = 0; i < t.huffman.size(); i++) {
+            enc.write_uint(0, t.huffman[i]);
+            enc.write_uint(1, t.binary[i]);
+        }
+        enc.flush();
+    }
+    return buffer;
+}
+
+void require_decodes(std::string const& buffer, Tokens const& t) {
+    auto in = iopp::bitwise_input_from(buffer.data(), buffer.data() + buffer.size());
+    REQUIRE(in.read(PREFIX_BITS) == PREFIX);
+
+    BlockDecoder dec(in);
+    setup(dec);
+    for(size_t i = 0; i < t.huffman.size(); i++) {
+        REQUIRE(bool(dec));
+        REQUIRE(dec.read_uint(0) == t.huffman[i]);
+        REQUIRE(dec.read_uint(1) == t.binary[i]);
+    }
+    REQUIRE(!dec);
+}
+
+TEST_SUITE("block_index") {
+    TEST_CASE("aligned") {
+        for(size_t const n : { 1, 50, 1'234 }) {
+            auto const t = generate_tokens(n, n);
+            auto const buffer = encode(t, true);
+            auto const* begin = buffer.data();
+            auto const* end = begin + buffer.size();
+
+            // locate the blocks
+            BlockIndex index(begin, end);
+            size_t const num_tokens = 2 * n;
+            size_t const num_blocks = (num_tokens + BLOCK_SIZE - 1) / BLOCK_SIZE;
+            REQUIRE(index.max_block_size() == BLOCK_SIZE);
+            REQUIRE(index.num_blocks() == num_blocks);
+
+            for(size_t i = 0; i < num_blocks; i++) {
+                auto const expect = (i + 1 < num_blocks) ? BLOCK_SIZE : num_tokens - i * BLOCK_SIZE;
+                REQUIRE(index.num_tokens(i) == expect);
+                REQUIRE(index.block_bytes(i) > 0);
+                REQUIRE(index.block_begin(i) + index.block_bytes(i) <= end);
+
+                // each block begins with the bit telling that a block follows, as read by the iopp source
+                auto in = iopp::bitwise_input_from(index.block_begin(i), end);
+                REQUIRE(in.read());
+                REQUIRE(in.read() == (expect < BLOCK_SIZE));
+            }
+
+            // the end marker follows the last block
+            auto in = iopp::bitwise_input_from(index.block_begin(num_blocks), end);
+            REQUIRE(!in.read());
+
+            require_decodes(buffer, t);
+        }
+    }
+
+    TEST_CASE("unaligned") {
+        auto const t = generate_tokens(1'234, 1);
+        auto const aligned = encode(t, true);
+        auto const buffer = encode(t, false);
+        REQUIRE(buffer.size() < aligned.size());
+        require_decodes(buffer, t);
+    }
+}
@@ -0,0 +1,66 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <random>
+#include <vector>
+
+#include <context_mixing.hpp>
+
+TEST_SUITE("context_mixing") {
+    TEST_CASE("roundtrip") {
+        size_t const N = 100'000;
+        size_t const SEED = 777;
+
+        // skewed random bytes whose context is the two preceding bytes
+        std::vector<uint8_t> bytes(N);
+        std::vector<uint16_t> contexts(N);
+        {
+            std::mt19937_64 gen(SEED);
+            std::geometric_distribution<int> dist(0.1);
+            uint16_t ctx = 0;
+            for(size_t i = 0; i < N; i++) {
+                bytes[i] = uint8_t('a' + dist(gen));
+                contexts[i] = ctx;
+                ctx = (ctx << 8) | bytes[i];
+            }
+        }
+
+        ContextMixingEncoder enc;
+        for(size_t i = 0; i < N; i++) enc.encode(bytes[i], contexts[i]);
+        auto encoded = enc.finish();
+        CHECK(encoded.size() < 3 * N / 4);
+
+        ContextMixingDecoder dec;
+        dec.reset(std::move(encoded));
+        for(size_t i = 0; i < N; i++) {
+            REQUIRE(dec.decode(contexts[i]) == bytes[i]);
+        }
+    }
+
+    TEST_CASE("empty") {
+        ContextMixingEncoder enc;
+        auto encoded = enc.finish();
+
+        // nb: only the coder state is flushed, which the decoder reads when it is reset
+        REQUIRE(encoded.size() == 4);
+        ContextMixingDecoder dec;
+        dec.reset(std::move(encoded));
+        REQUIRE(dec.num_bytes_read() == 4);
+    }
+
+    TEST_CASE("reset") {
+        std::vector<uint8_t> const bytes = { 'a', 'b', 'r', 'a', 'c', 'a', 'd', 'a', 'b', 'r', 'a' };
+
+        // a reset encoder must produce the same output as a fresh one
+        ContextMixingEncoder fresh;
+        for(auto const c : bytes) fresh.encode(c, 0);
+        auto const expected = fresh.finish();
+
+        ContextMixingEncoder enc;
+        for(size_t i = 0; i < 1000; i++) enc.encode(uint8_t(i), uint16_t(i));
+        enc.finish();
+        enc.reset();
+        for(auto const c : bytes) enc.encode(c, 0);
+        REQUIRE(enc.finish() == expected);
+    }
+}
@@ -0,0 +1,71 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <iopp/bitwise_io.hpp>
+
+#include <bv/elias_fano.hpp>
+
+namespace {
+
+std::vector<uint64_t> random_sequence(size_t const n, uint64_t const max_gap, size_t const seed) {
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<uint64_t> gap(1, max_gap);
+
+    std::vector<uint64_t> seq;
+    uint64_t v = gap(gen) - 1;
+    for(size_t i = 0; i < n; i++) {
+        seq.push_back(v);
+        v += gap(gen);
+    }
+    return seq;
+}
+
+}
+
+TEST_SUITE("elias_fano") {
+    TEST_CASE("access") {
+        for(auto const max_gap : { 1ULL, 2ULL, 100ULL, 100'000ULL }) {
+            auto const seq = random_sequence(100'000, max_gap, 777);
+            EliasFano ef(seq.data(), seq.size());
+
+            REQUIRE(ef.size() == seq.size());
+            for(size_t i = 0; i < seq.size(); i++) {
+                REQUIRE(ef[i] == seq[i]);
+            }
+        }
+    }
+
+    TEST_CASE("single") {
+        uint64_t const x = 12345;
+        EliasFano ef(&x, 1);
+        REQUIRE(ef.size() == 1);
+        REQUIRE(ef[0] == x);
+    }
+
+    TEST_CASE("encode") {
+        auto const seq = random_sequence(10'000, 1'000, 147);
+        EliasFano ef(seq.data(), seq.size());
+
+        std::string buffer;
+        {
+            auto out = iopp::bitwise_output_to(std::back_inserter(buffer));
+            ef.encode(out);
+        }
+
+        EliasFano decoded;
+        {
+            auto in = iopp::bitwise_input_from(buffer.data(), buffer.data() + buffer.size());
+            decoded.decode(in);
+        }
+
+        REQUIRE(decoded.size() == seq.size());
+        for(size_t i = 0; i < seq.size(); i++) {
+            REQUIRE(decoded[i] == seq[i]);
+        }
+    }
+}
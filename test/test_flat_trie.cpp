@@ -0,0 +1,106 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <filesystem>
+#include <random>
+#include <string>
+
+#include <unistd.h>
+
+#include <flat_trie.hpp>
+#include <trie.hpp>
+#include <trie_node.hpp>
+
+#include "topk_fixture.hpp"
+
+std::filesystem::path temp_path(std::string const& name) {
+    return std::filesystem::temp_directory_path() / ("test-flat-trie-" + std::to_string(getpid()) + "-" + name);
+}
+
+TEST_SUITE("flat_trie") {
+    TEST_CASE("trie") {
+        size_t const N = 1'000;
+
+        Trie<TrieNode<uint32_t, true, true>> trie(N);
+        std::mt19937 gen(777);
+        std::uniform_int_distribution<int> random_label(0, 255);
+        for(size_t i = 0; i < N / 2; i++) {
+            std::uniform_int_distribution<uint32_t> random_parent(0, trie.size() - 1);
+            auto const parent = random_parent(gen);
+            auto const label = char(random_label(gen));
+            uint32_t discard;
+            if(!trie.try_get_child(parent, label, discard)) trie.insert_child(trie.new_node(), parent, label);
+        }
+
+        auto const path = temp_path("trie");
+        save_trie(path, trie);
+
+        MappedFlatTrie<uint32_t> view(path);
+        auto const loaded = load_trie<decltype(trie)>(path);
+        REQUIRE(view.size() == trie.size());
+        REQUIRE(loaded.size() == trie.size());
+        for(uint32_t v = 0; v < trie.size(); v++) {
+            REQUIRE(view.parent(v) == trie.parent(v));
+            REQUIRE(loaded.parent(v) == trie.parent(v));
+
+            auto const& children = trie.children_of(v);
+            REQUIRE(view.num_children(v) == children.size());
+            REQUIRE(loaded.child_count(v) == children.size());
+            for(size_t i = 0; i < children.size(); i++) {
+                uint32_t u;
+                REQUIRE(view.try_get_child(v, children.label(i), u));
+                REQUIRE(u == children[i]);
+                REQUIRE(loaded.try_get_child(v, children.label(i), u));
+                REQUIRE(u == children[i]);
+            }
+        }
+        std::filesystem::remove(path);
+    }
+
+    TEST_CASE_TEMPLATE_DEFINE("topk", Topk, test_topk) {
+        size_t const k = 256;
+
+        Topk topk(k, 1024);
+        auto const text = random_text(20'000, 4, 1);
+        feed(topk, text);
+
+        auto const path = temp_path("topk");
+        topk.save(path);
+
+        // the view finds the same strings as the original
+        {
+            MappedFlatTrie<uint32_t> view(path);
+            REQUIRE(view.has_frequencies());
+
+            char buffer[k];
+            for(size_t i = 0; i + 16 <= text.size(); i += 7) {
+                uint32_t a, b;
+                auto const da = topk.find(text.data() + i, 16, a);
+                auto const db = view.find(text.data() + i, 16, b);
+                REQUIRE(da == db);
+                REQUIRE(a == b);
+                REQUIRE(view.frequency(b) == topk.frequency(a));
+                REQUIRE(view.spell(b, buffer) == da);
+                REQUIRE(std::string(buffer, da) == text.substr(i, da));
+            }
+        }
+
+        // the loaded instance behaves exactly like the original
+        auto loaded = Topk::load(path);
+        {
+            auto const more = random_text(20'000, 4, 2);
+            auto s = topk.empty_string();
+            auto t = loaded.empty_string();
+            for(auto const c : more) {
+                auto const next_s = topk.extend(s, c);
+                auto const next_t = loaded.extend(t, c);
+                REQUIRE(next_s.node == next_t.node);
+                REQUIRE(next_s.frequent == next_t.frequent);
+                s = next_s.frequent ? next_s : topk.empty_string();
+                t = next_t.frequent ? next_t : loaded.empty_string();
+            }
+        }
+        std::filesystem::remove(path);
+    }
+    TEST_CASE_TEMPLATE_APPLY(test_topk, TopkTypes);
+}
@@ -0,0 +1,137 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include <bit_io.hpp>
+#include <bv/bit_select.hpp>
+#include <louds_trie.hpp>
+#include <trie.hpp>
+#include <trie_coding.hpp>
+#include <trie_node.hpp>
+
+TEST_SUITE("louds_trie") {
+    TEST_CASE("select") {
+        for(size_t const n : { 1, 63, 64, 65, 1'000, 100'000 }) {
+            std::mt19937 gen(n);
+            std::bernoulli_distribution random_bit(0.3);
+            std::vector<uint64_t> bits(idiv_ceil(n, 64), 0);
+            std::vector<size_t> pos0, pos1;
+            for(size_t i = 0; i < n; i++) {
+                if(random_bit(gen)) {
+                    bits[i / 64] |= uint64_t(1) << (i % 64);
+                    pos1.push_back(i);
+                } else {
+                    pos0.push_back(i);
+                }
+            }
+
+            BitSelect<0> select0(bits.data(), n);
+            BitSelect<1> select1(bits.data(), n);
+            REQUIRE(select0.num() == pos0.size());
+            REQUIRE(select1.num() == pos1.size());
+            for(size_t j = 0; j < pos0.size(); j++) REQUIRE(select0(j + 1) == pos0[j]);
+            for(size_t j = 0; j < pos1.size(); j++) REQUIRE(select1(j + 1) == pos1[j]);
+        }
+    }
+
+    TEST_CASE("navigation") {
+        size_t const N = 10'000;
+
+        Trie<TrieNode<uint32_t, true, true>> trie(N);
+        std::mt19937 gen(777);
+        std::uniform_int_distribution<int> random_label(0, 255);
+        for(size_t i = 0; i < N - 1; i++) {
+            std::uniform_int_distribution<uint32_t> random_parent(0, trie.size() - 1);
+            auto const parent = random_parent(gen);
+            auto const label = char(random_label(gen));
+            uint32_t discard;
+            if(!trie.try_get_child(parent, label, discard)) trie.insert_child(trie.new_node(), parent, label);
+        }
+
+        std::vector<size_t> node_map;
+        LoudsTrie louds(trie, &node_map);
+        REQUIRE(louds.size() == trie.size());
+
+        std::string expect, buffer(N, 0);
+        for(uint32_t v = 0; v < trie.size(); v++) {
+            auto const x = node_map[v];
+            if(v != trie.root()) {
+                REQUIRE(louds.parent(x) == node_map[trie.parent(v)]);
+                REQUIRE(louds.label(x) == trie.node(v).inlabel);
+            }
+
+            auto const& children = trie.children_of(v);
+            REQUIRE(louds.num_children(x) == children.size());
+            for(size_t i = 0; i < children.size(); i++) {
+                uint32_t u;
+                REQUIRE(louds.try_get_child(x, children.label(i), u));
+                REQUIRE(u == node_map[children[i]]);
+            }
+
+            // spell by walking up the original trie
+            expect.clear();
+            for(auto u = v; u != trie.root(); u = trie.parent(u)) expect.push_back(trie.node(u).inlabel);
+            REQUIRE(louds.spell_reverse(x, buffer.data()) == expect.size());
+            REQUIRE(buffer.substr(0, expect.size()) == expect);
+        }
+
+        // exactly the children's labels are found
+        for(size_t x = 0; x < louds.size(); x++) {
+            size_t num_found = 0;
+            for(int c = 0; c < 256; c++) {
+                uint32_t u;
+                if(louds.try_get_child(x, char(c), u)) {
+                    REQUIRE(louds.parent(u) == x);
+                    REQUIRE(louds.label(u) == char(c));
+                    ++num_found;
+                }
+            }
+            REQUIRE(num_found == louds.num_children(x));
+        }
+    }
+
+    TEST_CASE("topology") {
+        size_t const N = 10'000;
+
+        Trie<TrieNode<uint32_t, true, true>> trie(N);
+        std::mt19937 gen(147);
+        std::uniform_int_distribution<int> random_label(0, 255);
+        for(size_t i = 0; i < N - 1; i++) {
+            std::uniform_int_distribution<uint32_t> random_parent(0, trie.size() - 1);
+            auto const parent = random_parent(gen);
+            auto const label = char(random_label(gen));
+            uint32_t discard;
+            if(!trie.try_get_child(parent, label, discard)) trie.insert_child(trie.new_node(), parent, label);
+        }
+
+        // the numbering alone must match the constructed trie
+        std::vector<size_t> node_map;
+        LoudsTrie louds(trie, &node_map);
+        REQUIRE(LoudsTrie::numbering(trie) == node_map);
+
+        // construct from the depth-first topology and labels like topk-twopass does
+        BitWriter out;
+        encode_topology(trie, trie.root(), out);
+        auto const words = out.words();
+        BitReader in(words.data(), out.num_bits_written());
+        size_t num_nodes;
+        auto const topology = decode_topology(in, N, num_nodes);
+        REQUIRE(num_nodes == trie.size());
+
+        std::string labels;
+        gather_labels(trie, trie.root(), 0, labels);
+
+        LoudsTrie decoded(topology, labels);
+        REQUIRE(decoded.size() == louds.size());
+        for(size_t x = 0; x < louds.size(); x++) {
+            if(x != louds.root()) {
+                REQUIRE(decoded.parent(x) == louds.parent(x));
+                REQUIRE(decoded.label(x) == louds.label(x));
+            }
+            REQUIRE(decoded.num_children(x) == louds.num_children(x));
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <memory>
+#include <random>
+#include <string>
+
+#include <lpf_array.hpp>
+
+void test_lpf(std::string const& t) {
+    auto const n = t.length();
+    auto lpf = std::make_unique<uint32_t[]>(n);
+    auto prev = std::make_unique<uint32_t[]>(n);
+    lpf_prev_u32(t.begin(), t.end(), lpf.get(), prev.get());
+
+    auto lce = [&](size_t const i, size_t const j){
+        size_t l = 0;
+        while(i + l < n && j + l < n && t[i + l] == t[j + l]) ++l;
+        return l;
+    };
+
+    for(size_t i = 0; i < n; i++) {
+        size_t expected = 0;
+        for(size_t j = 0; j < i; j++) expected = std::max(expected, lce(i, j));
+        REQUIRE(lpf[i] == expected);
+        if(lpf[i] > 0) {
+            REQUIRE(prev[i] < i);
+            REQUIRE(lce(i, prev[i]) >= lpf[i]);
+        }
+    }
+}
+
+TEST_SUITE("lpf_array") {
+    TEST_CASE("examples") {
+        test_lpf("");
+        test_lpf("a");
+        test_lpf("aaaaaaaa");
+        test_lpf("abracadabra");
+        test_lpf("mississippi");
+        test_lpf("abaababaabaababaababa");
+    }
+
+    TEST_CASE("random") {
+        size_t const N = 2'000;
+        size_t const SEED = 777;
+
+        std::mt19937 gen(SEED);
+        for(size_t sigma : {2, 4, 26}) {
+            std::uniform_int_distribution<int> c(0, sigma - 1);
+            std::string t;
+            for(size_t i = 0; i < N; i++) t.push_back(char('a' + c(gen)));
+            test_lpf(t);
+        }
+    }
+}
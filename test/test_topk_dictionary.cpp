@@ -0,0 +1,132 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <iterator>
+#include <random>
+#include <string>
+
+#include <iopp/bitwise_io.hpp>
+#include <pm/result.hpp>
+
+#include "../src/topk_lz78_impl.hpp"
+
+using Topk = TopKPrefixesMisraGries<uint32_t, false, false>;
+using LazyTopk = TopKPrefixesMisraGries<uint32_t, false, true>;
+
+constexpr size_t K = 4096;
+constexpr size_t MAX_FREQ = 1024;
+constexpr size_t BLOCK_SIZE = 256;
+
+// generates a text over a small set of words, such that different seeds share many phrases
+std::string generate_text(size_t const n, size_t const seed) {
+    static std::string const words[] = { "top ", "k ", "compress", "trie ", "phrase ", "dictionary ", "frequency ", "lz78\n" };
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<size_t> random_word(0, std::size(words) - 1);
+
+    std::string text;
+    while(text.size() < n) text.append(words[random_word(gen)]);
+    text.resize(n);
+    return text;
+}
+
+template<typename T>
+std::string train_dictionary(std::string const& training) {
+    T topk(K - 1, MAX_FREQ);
+    topk_lz78::train(training.begin(), training.end(), topk);
+
+    std::string buffer;
+    pm::Result result;
+    topk_lz78::write_dictionary(topk, K, MAX_FREQ, iopp::bitwise_output_to(std::back_inserter(buffer)), result);
+    return buffer;
+}
+
+template<typename T>
+std::string compress(std::string const& text, topk_lz78::Dictionary const& dict) {
+    std::string buffer;
+    pm::Result result;
+    topk_lz78::compress<T>(text.begin(), text.end(), iopp::bitwise_output_to(std::back_inserter(buffer)), K, MAX_FREQ, BLOCK_SIZE, false, 1, dict, result);
+    return buffer;
+}
+
+template<typename T>
+std::string decompress(std::string const& compressed, topk_lz78::Dictionary const& dict) {
+    std::string text;
+    topk_lz78::decompress<T>(iopp::bitwise_input_from(compressed.data(), compressed.data() + compressed.size()), std::back_inserter(text), dict);
+    return text;
+}
+
+// the dictionary id recorded in the header of a compressed file
+uint64_t header_dictionary_id(std::string const& compressed) {
+    auto in = iopp::bitwise_input_from(compressed.data(), compressed.data() + compressed.size());
+    in.read(64); // magic
+    in.read(64); // k
+    in.read(64); // max_freq
+    return in.read(64);
+}
+
+TEST_SUITE("topk_dictionary") {
+    TEST_CASE("roundtrip") {
+        auto const training = generate_text(100'000, 1);
+        auto const text = generate_text(20'000, 2);
+
+        auto const dict_file = train_dictionary<Topk>(training);
+        auto const dict = topk_lz78::read_dictionary(dict_file.data(), dict_file.data() + dict_file.size());
+        REQUIRE(!dict.empty());
+        REQUIRE(dict.k == K);
+        REQUIRE(dict.max_freq == MAX_FREQ);
+        REQUIRE(!dict.lazy);
+        REQUIRE(dict.nodes.size() > 1);
+        REQUIRE(dict.nodes.size() <= K);
+
+        auto const with_dict = compress<Topk>(text, dict);
+        REQUIRE(header_dictionary_id(with_dict) == dict.id);
+        REQUIRE(decompress<Topk>(with_dict, dict) == text);
+
+        // the trained trie helps on similar text
+        topk_lz78::Dictionary const none;
+        auto const without_dict = compress<Topk>(text, none);
+        REQUIRE(header_dictionary_id(without_dict) == 0);
+        REQUIRE(decompress<Topk>(without_dict, none) == text);
+        REQUIRE(with_dict.size() < without_dict.size());
+    }
+
+    TEST_CASE("mismatch") {
+        auto const text = generate_text(10'000, 3);
+
+        auto const dict_file = train_dictionary<Topk>(generate_text(50'000, 4));
+        auto const other_file = train_dictionary<Topk>(generate_text(50'000, 5));
+        auto const dict = topk_lz78::read_dictionary(dict_file.data(), dict_file.data() + dict_file.size());
+        auto const other = topk_lz78::read_dictionary(other_file.data(), other_file.data() + other_file.size());
+        REQUIRE(dict.id != other.id);
+
+        auto const id = header_dictionary_id(compress<Topk>(text, dict));
+        REQUIRE(topk_lz78::matches_dictionary(id, dict));
+        REQUIRE(!topk_lz78::matches_dictionary(id, other));
+        REQUIRE(!topk_lz78::matches_dictionary(id, topk_lz78::Dictionary()));
+
+        // a file compressed without a dictionary can be decompressed regardless
+        REQUIRE(topk_lz78::matches_dictionary(0, dict));
+    }
+
+    TEST_CASE("variant") {
+        auto const training = generate_text(50'000, 6);
+        auto const text = generate_text(10'000, 7);
+
+        auto const dict_file = train_dictionary<Topk>(training);
+        auto const lazy_file = train_dictionary<LazyTopk>(training);
+        auto const dict = topk_lz78::read_dictionary(dict_file.data(), dict_file.data() + dict_file.size());
+        auto const lazy_dict = topk_lz78::read_dictionary(lazy_file.data(), lazy_file.data() + lazy_file.size());
+        REQUIRE(!dict.lazy);
+        REQUIRE(lazy_dict.lazy);
+        REQUIRE(dict.id != lazy_dict.id);
+
+        // a dictionary only fits the variant it was trained with
+        REQUIRE(dict.fits<Topk>());
+        REQUIRE(!dict.fits<LazyTopk>());
+        REQUIRE(lazy_dict.fits<LazyTopk>());
+        REQUIRE(!lazy_dict.fits<Topk>());
+        REQUIRE(topk_lz78::Dictionary().fits<LazyTopk>());
+
+        REQUIRE(decompress<LazyTopk>(compress<LazyTopk>(text, lazy_dict), lazy_dict) == text);
+    }
+}
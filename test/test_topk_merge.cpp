@@ -0,0 +1,75 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <map>
+#include <string>
+
+#include "topk_fixture.hpp"
+
+template<typename Topk>
+void collect(Topk const& topk, uint32_t const v, std::string const& s, std::map<std::string, uint32_t>& out) {
+    auto const& children = topk.children_of(v);
+    for(size_t i = 0; i < children.size(); i++) {
+        auto const u = children[i];
+        auto const su = s + children.label(i);
+        out.emplace(su, topk.frequency(u));
+        collect(topk, u, su, out);
+    }
+}
+
+// maps the strings contained in the trie to their estimated frequencies
+template<typename Topk>
+std::map<std::string, uint32_t> collect(Topk const& topk) {
+    std::map<std::string, uint32_t> out;
+    collect(topk, topk.root(), std::string(), out);
+    return out;
+}
+
+TEST_SUITE("topk_merge") {
+    TEST_CASE_TEMPLATE_DEFINE("union", Topk, test_union) {
+        // with sufficient space, the merged trie contains every string of either trie and the frequencies add up
+        Topk a(4096, 1024);
+        Topk b(4096, 1024);
+        feed(a, random_text(500, 3, 1));
+        feed(b, random_text(500, 4, 2));
+
+        auto const fa = collect(a);
+        auto const fb = collect(b);
+        a.merge(b);
+        auto const merged = collect(a);
+
+        std::map<std::string, uint32_t> expected = fa;
+        for(auto const& [s, f] : fb) expected[s] += f;
+        REQUIRE(merged == expected);
+    }
+    TEST_CASE_TEMPLATE_APPLY(test_union, TopkTypes);
+
+    TEST_CASE_TEMPLATE_DEFINE("prune", Topk, test_prune) {
+        // with little space, the merged trie is pruned back to k nodes, stays prefix-closed and never overestimates
+        size_t const k = 64;
+        Topk a(k, 1024);
+        Topk b(k, 1024);
+        feed(a, random_text(5'000, 3, 3));
+        feed(b, random_text(5'000, 3, 4));
+
+        auto const fa = collect(a);
+        auto const fb = collect(b);
+        a.merge(b);
+        auto const merged = collect(a);
+
+        REQUIRE(merged.size() <= k - 1);
+        for(auto const& [s, f] : merged) {
+            if(s.size() > 1) REQUIRE(merged.contains(s.substr(0, s.size() - 1)));
+
+            uint32_t sum = 0;
+            if(fa.contains(s)) sum += fa.at(s);
+            if(fb.contains(s)) sum += fb.at(s);
+            REQUIRE(f <= sum);
+        }
+
+        // the merged instance keeps working
+        feed(a, random_text(5'000, 3, 5));
+        REQUIRE(collect(a).size() <= k - 1);
+    }
+    TEST_CASE_TEMPLATE_APPLY(test_prune, TopkTypes);
+}
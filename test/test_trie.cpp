@@ -0,0 +1,93 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <random>
+
+#include <trie.hpp>
+#include <trie_node.hpp>
+
+template<typename TrieA, typename TrieB>
+void require_equal(TrieA const& a, TrieB const& b, size_t const n) {
+    for(uint32_t v = 0; v < n; v++) {
+        auto const& ca = a.children_of(v);
+        auto const& cb = b.children_of(v);
+        REQUIRE(ca.size() == cb.size());
+        for(size_t i = 0; i < ca.size(); i++) {
+            uint32_t u;
+            REQUIRE(b.try_get_child(v, ca.label(i), u));
+            REQUIRE(u == ca[i]);
+        }
+    }
+}
+
+TEST_SUITE("trie") {
+    TEST_CASE("pooled_links") {
+        size_t const N = 10'000;
+        size_t const SEED = 777;
+
+        // build two tries, one with heap allocated and one with pooled link arrays, and churn them in the exact same way
+        Trie<TrieNode<uint32_t, true, false>> heap(N);
+        Trie<TrieNode<uint32_t, true, true>> pooled(N);
+        heap.fill();
+        pooled.fill();
+
+        std::mt19937 gen(SEED);
+        std::uniform_int_distribution<uint32_t> random_node(1, N - 1);
+        std::uniform_int_distribution<uint32_t> random_parent(0, 15); // few parents, such that many of them get large
+        std::uniform_int_distribution<int> random_label(0, 255);
+
+        for(size_t i = 0; i < 20 * N; i++) {
+            auto const v = random_node(gen);
+            if(!heap.is_leaf(v)) continue;
+
+            if(heap.is_valid(heap.parent(v))) {
+                heap.extract(v);
+                pooled.extract(v);
+            }
+
+            auto const parent = random_parent(gen);
+            auto const label = (char)random_label(gen);
+            uint32_t discard;
+            if(parent != v && heap.is_leaf(v) && !heap.try_get_child(parent, label, discard)) {
+                heap.insert_child(v, parent, label);
+                pooled.insert_child(v, parent, label);
+            }
+        }
+        require_equal(heap, pooled, N);
+
+        // copies must not share link arrays with the original
+        auto copy = pooled;
+        require_equal(heap, copy, N);
+
+        for(uint32_t v = 1; v < N; v++) {
+            if(pooled.is_valid(pooled.parent(v)) && pooled.is_leaf(v)) pooled.extract(v);
+        }
+        require_equal(heap, copy, N);
+    }
+
+    TEST_CASE("pooled_churn") {
+        size_t const N = 64;
+
+        // a node whose number of children oscillates around a power of two, such that its link array changes its size class each time
+        Trie<TrieNode<uint32_t, false, true>> trie(N);
+        trie.fill();
+        for(uint32_t v = 1; v <= 17; v++) trie.insert_child(v, 0, char(v));
+
+        auto churn = [&](){
+            trie.extract(17);
+            trie.insert_child(17, 0, char(17));
+        };
+
+        // link arrays are always freed in the size class they were allocated in, so they are reused and the pool does not grow
+        churn();
+        auto const mem = trie.mem_size();
+        for(size_t i = 0; i < 10'000; i++) churn();
+        REQUIRE(trie.mem_size() == mem);
+
+        for(uint32_t v = 1; v <= 17; v++) {
+            uint32_t u;
+            REQUIRE(trie.try_get_child(0, char(v), u));
+            REQUIRE(u == v);
+        }
+    }
+}
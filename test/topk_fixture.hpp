@@ -0,0 +1,32 @@
+#pragma once
+
+#include <random>
+#include <string>
+#include <tuple>
+
+#include <topk_prefixes_misra_gries.hpp>
+
+// the variants of TopKPrefixesMisraGries that the tests are applied to (split nodes, lazy Space-Saving)
+using TopkTypes = std::tuple<
+    TopKPrefixesMisraGries<uint32_t, false, false>,
+    TopKPrefixesMisraGries<uint32_t, true, false>,
+    TopKPrefixesMisraGries<uint32_t, false, true>>;
+
+// generates a random text over the first sigma lowercase letters
+inline std::string random_text(size_t const n, size_t const sigma, size_t const seed) {
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<int> random_char(0, int(sigma) - 1);
+    std::string s;
+    for(size_t i = 0; i < n; i++) s.push_back(char('a' + random_char(gen)));
+    return s;
+}
+
+// feeds a text into the top-k trie, extending the current string as long as it is frequent
+template<typename Topk>
+void feed(Topk& topk, std::string const& text) {
+    auto s = topk.empty_string();
+    for(auto const c : text) {
+        auto const next = topk.extend(s, c);
+        s = next.frequent ? next : topk.empty_string();
+    }
+}
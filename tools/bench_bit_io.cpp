@@ -0,0 +1,113 @@
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <iopp/bitwise_io.hpp>
+
+#include <bit_io.hpp>
+
+// microbenchmark comparing the iopp bitwise adapters against BitWriter / BitReader
+// codes of random widths are written and read back, as well as a sequence of bytes written using write_fixed
+
+template<typename F>
+double measure_ns(F f) {
+    auto const t0 = std::chrono::steady_clock::now();
+    f();
+    auto const t1 = std::chrono::steady_clock::now();
+    return double(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+}
+
+int main(int argc, char** argv) {
+    size_t const n = (argc > 1) ? std::stoull(argv[1]) : 10'000'000;
+    size_t const max_bits = (argc > 2) ? std::stoull(argv[2]) : 24;
+    size_t const seed = 147;
+
+    // generate codes
+    std::vector<uint64_t> values(n);
+    std::vector<uint8_t> widths(n);
+    std::vector<uint8_t> bytes(n);
+    size_t total_bits = 0;
+    {
+        std::mt19937_64 gen(seed);
+        std::uniform_int_distribution<size_t> width(1, max_bits);
+        for(size_t i = 0; i < n; i++) {
+            widths[i] = width(gen);
+            values[i] = gen() >> (64 - widths[i]);
+            bytes[i] = uint8_t(gen());
+            total_bits += widths[i];
+        }
+    }
+
+    std::cout << "# n=" << n << ", max_bits=" << max_bits << ", total_bits=" << total_bits << std::endl;
+
+    // write codes
+    std::string iopp_buffer;
+    auto const ns_iopp_write = measure_ns([&](){
+        auto out = iopp::bitwise_output_to(std::back_inserter(iopp_buffer));
+        for(size_t i = 0; i < n; i++) out.write(values[i], widths[i]);
+    });
+
+    BitWriter writer;
+    auto const ns_writer = measure_ns([&](){
+        for(size_t i = 0; i < n; i++) writer.write(values[i], widths[i]);
+    });
+
+    std::string append_buffer;
+    auto const ns_append = measure_ns([&](){
+        auto out = iopp::bitwise_output_to(std::back_inserter(append_buffer));
+        writer.append_to(out);
+    });
+
+    if(append_buffer != iopp_buffer) {
+        std::cerr << "BitWriter output differs from iopp output" << std::endl;
+        return -1;
+    }
+
+    // read codes
+    uint64_t checksum_iopp = 0;
+    auto const ns_iopp_read = measure_ns([&](){
+        auto in = iopp::bitwise_input_from(iopp_buffer.data(), iopp_buffer.data() + iopp_buffer.size());
+        for(size_t i = 0; i < n; i++) checksum_iopp += in.read(widths[i]);
+    });
+
+    auto const words = writer.words();
+    uint64_t checksum_reader = 0;
+    auto const ns_reader = measure_ns([&](){
+        BitReader in(words.data(), writer.num_bits_written());
+        for(size_t i = 0; i < n; i++) checksum_reader += in.read(widths[i]);
+    });
+
+    if(checksum_iopp != checksum_reader) {
+        std::cerr << "BitReader input differs from iopp input" << std::endl;
+        return -1;
+    }
+
+    // write bytes
+    std::string bytes_single, bytes_fixed;
+    auto const ns_bytes_single = measure_ns([&](){
+        auto out = iopp::bitwise_output_to(std::back_inserter(bytes_single));
+        for(size_t i = 0; i < n; i++) out.write(uintmax_t(bytes[i]), 8);
+    });
+    auto const ns_bytes_fixed = measure_ns([&](){
+        auto out = iopp::bitwise_output_to(std::back_inserter(bytes_fixed));
+        write_fixed(out, bytes.data(), n, 8);
+    });
+
+    if(bytes_single != bytes_fixed) {
+        std::cerr << "write_fixed output differs from single writes" << std::endl;
+        return -1;
+    }
+
+    auto const per_code = [&](double const ns){ return ns / double(n); };
+    std::cout << "iopp_write_ns\twriter_ns\tappend_ns\tiopp_read_ns\treader_ns\tiopp_bytes_ns\twrite_fixed_ns" << std::endl;
+    std::cout << std::fixed << std::setprecision(2)
+        << per_code(ns_iopp_write) << "\t" << per_code(ns_writer) << "\t" << per_code(ns_append) << "\t"
+        << per_code(ns_iopp_read) << "\t" << per_code(ns_reader) << "\t"
+        << per_code(ns_bytes_single) << "\t" << per_code(ns_bytes_fixed) << std::endl;
+    return 0;
+}
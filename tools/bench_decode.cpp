@@ -0,0 +1,90 @@
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <string>
+
+#include <iopp/bitwise_io.hpp>
+#include <pm/result.hpp>
+
+#include <memory_mapped_file.hpp>
+#include <topk_prefixes_misra_gries.hpp>
+
+#include "../src/lz77_blockwise_impl.hpp"
+#include "../src/topk_lz77_impl.hpp"
+
+// microbenchmark for decompressing .topklz77 or .lz77b files, reporting the throughput in MB/s
+// nb: the blockwise LZ77 files code their lengths and literals using Huffman codes only
+// the decompressed output is discarded so that only decoding is measured
+
+using Topk = TopKPrefixesMisraGries<>;
+
+// output iterator that only counts the characters written to it
+class CountingOutputIterator {
+private:
+    size_t* count_;
+
+public:
+    using iterator_category = std::output_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = void;
+    using pointer = void;
+    using reference = void;
+
+    CountingOutputIterator() : count_(nullptr) {
+    }
+
+    CountingOutputIterator(size_t& count) : count_(&count) {
+    }
+
+    CountingOutputIterator& operator*() { return *this; }
+    CountingOutputIterator& operator=(char) { ++*count_; return *this; }
+    CountingOutputIterator& operator++() { return *this; }
+    CountingOutputIterator& operator++(int) { return *this; }
+};
+
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <file.topklz77|file.lz77b>... [-r <repetitions>]" << std::endl;
+        return -1;
+    }
+
+    size_t reps = 3;
+    std::cout << "file\tinsize\toutsize\tbest_ms\tin_mbps\tout_mbps" << std::endl;
+    for(int i = 1; i < argc; i++) {
+        std::string const arg = argv[i];
+        if(arg == "-r" && i + 1 < argc) {
+            reps = std::max(1ULL, std::stoull(argv[++i]));
+            continue;
+        }
+
+        MemoryMappedFile in(arg);
+        bool const framed = frames::is_framed(in.begin(), in.end(), topk_lz77::FRAMED_MAGIC);
+        bool const blockwise = !framed && in.size() >= 8 && iopp::bitwise_input_from(in.begin(), in.end()).read(64) == lz77_blockwise::MAGIC;
+
+        size_t outsize = 0;
+        double best_ns = std::numeric_limits<double>::max();
+        for(size_t r = 0; r < reps; r++) {
+            outsize = 0;
+            auto const t0 = std::chrono::steady_clock::now();
+            if(blockwise) {
+                lz77_blockwise::decompress(iopp::bitwise_input_from(in.begin(), in.end()), CountingOutputIterator(outsize));
+            } else if(framed) {
+                topk_lz77::decompress_framed<Topk>(in.begin(), in.end(), CountingOutputIterator(outsize));
+            } else {
+                topk_lz77::decompress<Topk>(iopp::bitwise_input_from(in.begin(), in.end()), CountingOutputIterator(outsize));
+            }
+            auto const t1 = std::chrono::steady_clock::now();
+            best_ns = std::min(best_ns, double(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count()));
+        }
+
+        // MB/s = bytes / (ns * 1e-9) / 1e6 = bytes / ns * 1e3
+        std::cout << arg << "\t" << in.size() << "\t" << outsize << "\t"
+            << std::fixed << std::setprecision(2) << (best_ns / 1e6) << "\t"
+            << (double(in.size()) / best_ns * 1e3) << "\t"
+            << (double(outsize) / best_ns * 1e3) << std::endl;
+    }
+    return 0;
+}
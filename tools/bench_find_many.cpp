@@ -0,0 +1,91 @@
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <memory_mapped_file.hpp>
+#include <topk_prefixes_misra_gries.hpp>
+
+// microbenchmark for top-k trie lookups at random positions of a file, comparing single lookups (find) to batched lookups (find_many)
+
+using Topk = TopKPrefixesMisraGries<>;
+
+constexpr size_t max_len = 1'024;
+
+template<size_t group_size>
+double bench_many(Topk const& topk, std::vector<char const*> const& strings, std::vector<size_t> const& lens, std::vector<uint32_t>& nodes, std::vector<uint32_t>& depths) {
+    auto const t0 = std::chrono::steady_clock::now();
+    topk.find_many<group_size>(strings.data(), lens.data(), strings.size(), nodes.data(), depths.data());
+    auto const t1 = std::chrono::steady_clock::now();
+    return double(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count()) / double(strings.size());
+}
+
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <file> [k] [num_queries]" << std::endl;
+        return -1;
+    }
+
+    MemoryMappedFile in(argv[1]);
+    size_t const k = (argc > 2) ? std::stoull(argv[2]) : 1ULL << 22;
+    size_t const num_queries = (argc > 3) ? std::stoull(argv[3]) : 10'000'000;
+    size_t const seed = 147;
+
+    // build the top-k trie like top-k LZ78 does
+    Topk topk(k, 1'024);
+    {
+        auto s = topk.empty_string();
+        for(auto const c : in) {
+            auto next = topk.extend(s, c);
+            s = next.frequent ? next : topk.empty_string();
+        }
+    }
+
+    // queries start at random positions
+    std::vector<char const*> strings;
+    std::vector<size_t> lens;
+    strings.reserve(num_queries);
+    lens.reserve(num_queries);
+    {
+        std::mt19937 gen(seed);
+        std::uniform_int_distribution<size_t> pos(0, in.size() - 1);
+        for(size_t i = 0; i < num_queries; i++) {
+            auto const p = pos(gen);
+            strings.push_back(in.begin() + p);
+            lens.push_back(std::min(max_len, in.size() - p));
+        }
+    }
+
+    std::cout << "# file=" << argv[1] << ", n=" << in.size() << ", k=" << k << ", num_queries=" << num_queries << std::endl;
+
+    // single lookups
+    std::vector<uint32_t> nodes(num_queries), depths(num_queries);
+    double ns_single;
+    {
+        auto const t0 = std::chrono::steady_clock::now();
+        for(size_t i = 0; i < num_queries; i++) {
+            depths[i] = topk.find(strings[i], lens[i], nodes[i]);
+        }
+        auto const t1 = std::chrono::steady_clock::now();
+        ns_single = double(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count()) / double(num_queries);
+    }
+
+    // batched lookups
+    std::vector<uint32_t> nodes_many(num_queries), depths_many(num_queries);
+    auto const ns_many_4 = bench_many<4>(topk, strings, lens, nodes_many, depths_many);
+    auto const ns_many_8 = bench_many<8>(topk, strings, lens, nodes_many, depths_many);
+    auto const ns_many_16 = bench_many<16>(topk, strings, lens, nodes_many, depths_many);
+    auto const ns_many_32 = bench_many<32>(topk, strings, lens, nodes_many, depths_many);
+
+    std::cout << "single_ns\tmany4_ns\tmany8_ns\tmany16_ns\tmany32_ns" << std::endl;
+    std::cout << std::fixed << std::setprecision(2) << ns_single << "\t" << ns_many_4 << "\t" << ns_many_8 << "\t" << ns_many_16 << "\t" << ns_many_32 << std::endl;
+
+    if(nodes != nodes_many || depths != depths_many) {
+        std::cerr << "batched lookups differ from single lookups" << std::endl;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <pm/result.hpp>
+
+#include <bit_io.hpp>
+#include <block_coding.hpp>
+#include <memory_mapped_file.hpp>
+#include <topk_prefixes_misra_gries.hpp>
+
+// microbenchmark for coding the literals of a top-k LZ78 parse, comparing the Huffman path to context mixing
+// reports the compressed size in bits per literal and the encoding and decoding throughput in MB/s (of literals)
+
+using Topk = TopKPrefixesMisraGries<>;
+
+constexpr TokenType TOK_LITERAL = 0;
+
+struct Literals {
+    std::vector<char> chars;
+    std::vector<TokenContext> contexts;
+};
+
+// parses the input like top-k LZ78 does, collecting the literals and their contexts (the two preceding characters)
+Literals parse(MemoryMappedFile const& in, size_t const k) {
+    Literals literals;
+    Topk topk(k, 1'024);
+
+    auto s = topk.empty_string();
+    TokenContext ctx = 0;
+    for(auto const c : in) {
+        auto const next = topk.extend(s, c);
+        if(!next.frequent) {
+            literals.chars.push_back(c);
+            literals.contexts.push_back(ctx);
+            s = topk.empty_string();
+        } else {
+            s = next;
+        }
+        ctx = (ctx << 8) | uint8_t(c);
+    }
+    return literals;
+}
+
+template<typename Setup>
+void bench(std::string const& name, Literals const& literals, size_t const block_size, Setup setup) {
+    auto const n = literals.chars.size();
+
+    BitWriter writer;
+    auto const t0 = std::chrono::steady_clock::now();
+    {
+        BlockEncoder enc(writer, block_size);
+        setup(enc);
+        for(size_t i = 0; i < n; i++) enc.write_char(TOK_LITERAL, literals.chars[i], literals.contexts[i]);
+        enc.flush();
+    }
+    auto const t1 = std::chrono::steady_clock::now();
+
+    auto const words = writer.words();
+    BitReader reader(words.data(), writer.num_bits_written());
+    bool correct = true;
+    {
+        BlockDecoder dec(reader);
+        setup(dec);
+        for(size_t i = 0; i < n; i++) correct = (dec.read_char(TOK_LITERAL, literals.contexts[i]) == literals.chars[i]) && correct;
+    }
+    auto const t2 = std::chrono::steady_clock::now();
+
+    auto const ns = [](auto const a, auto const b){ return double(std::chrono::duration_cast<std::chrono::nanoseconds>(b - a).count()); };
+
+    // MB/s = bytes / (ns * 1e-9) / 1e6 = bytes / ns * 1e3
+    std::cout << name << "\t" << n << "\t" << writer.num_bits_written() << "\t"
+        << std::fixed << std::setprecision(3) << (double(writer.num_bits_written()) / double(n)) << "\t"
+        << std::setprecision(2) << (double(n) / ns(t0, t1) * 1e3) << "\t"
+        << (double(n) / ns(t1, t2) * 1e3) << "\t"
+        << (correct ? "ok" : "FAIL") << std::endl;
+}
+
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <file> [k] [block_size]" << std::endl;
+        return -1;
+    }
+
+    MemoryMappedFile in(argv[1]);
+    size_t const k = (argc > 2) ? std::stoull(argv[2]) : 1ULL << 20;
+    size_t const block_size = (argc > 3) ? std::stoull(argv[3]) : 1ULL << 16;
+
+    auto const literals = parse(in, k);
+    std::cout << "# file=" << argv[1] << ", n=" << in.size() << ", k=" << k << ", block_size=" << block_size << std::endl;
+    std::cout << "coder\tliterals\tbits\tbits_per_literal\tenc_mbps\tdec_mbps\tcheck" << std::endl;
+
+    bench("huffman", literals, block_size, [](auto& coding){ coding.register_huffman(); });
+    bench("cm", literals, block_size, [](auto& coding){ coding.register_context_mixing(); });
+    bench("adaptive", literals, block_size, [](auto& coding){ coding.register_adaptive(255); });
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <trie.hpp>
+#include <trie_node.hpp>
+
+// microbenchmark for child lookups in trie nodes of different fanouts, comparing the scalar and the fast lookup paths
+
+struct Query {
+    uint32_t node;
+    char label;
+};
+
+template<bool fast_lookup>
+using BenchTrie = Trie<TrieNode<uint32_t, fast_lookup>>;
+
+// parents are nodes 1..num_parents, each gets fanout children with random distinct labels
+template<bool fast_lookup>
+BenchTrie<fast_lookup> build(size_t const fanout, size_t const num_parents, size_t const seed) {
+    BenchTrie<fast_lookup> trie(1 + num_parents * (1 + fanout));
+    trie.fill();
+
+    std::mt19937 gen(seed);
+    std::vector<uint8_t> labels(256);
+    for(size_t c = 0; c < 256; c++) labels[c] = c;
+
+    uint32_t next = num_parents + 1;
+    for(uint32_t p = 1; p <= num_parents; p++) {
+        std::shuffle(labels.begin(), labels.end(), gen);
+        for(size_t j = 0; j < fanout; j++) {
+            trie.insert_child(next++, p, (char)labels[j]);
+        }
+    }
+    return trie;
+}
+
+template<bool fast_lookup>
+double bench(BenchTrie<fast_lookup> const& trie, std::vector<Query> const& queries, uint64_t& checksum) {
+    auto const t0 = std::chrono::steady_clock::now();
+    uint64_t sum = 0;
+    for(auto const& q : queries) {
+        uint32_t child;
+        if(trie.try_get_child(q.node, q.label, child)) sum += child;
+    }
+    auto const t1 = std::chrono::steady_clock::now();
+
+    checksum = sum;
+    return double(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count()) / double(queries.size());
+}
+
+int main(int argc, char** argv) {
+    size_t const num_queries = (argc > 1) ? std::stoull(argv[1]) : 10'000'000;
+    size_t const num_parents = (argc > 2) ? std::stoull(argv[2]) : 4'096;
+    size_t const num_rounds = (argc > 3) ? std::stoull(argv[3]) : 5;
+    size_t const seed = 147;
+
+    // queries address random parents with random labels
+    std::vector<Query> queries;
+    queries.reserve(num_queries);
+    {
+        std::mt19937 gen(seed);
+        std::uniform_int_distribution<uint32_t> parent(1, num_parents);
+        std::uniform_int_distribution<int> label(0, 255);
+        for(size_t i = 0; i < num_queries; i++) {
+            queries.push_back(Query { parent(gen), (char)label(gen) });
+        }
+    }
+
+    std::cout << "# inline_size=" << TrieNode<>::ChildArray::inline_size_ << ", num_queries=" << num_queries << ", num_parents=" << num_parents << ", num_rounds=" << num_rounds << std::endl;
+    std::cout << "fanout\tscalar_ns\tfast_ns" << std::endl;
+
+    // both tries are built up front and measured in alternating rounds, reporting the best round of each
+    // nb: otherwise, whichever is measured first has an advantage
+    for(size_t const fanout : { 1, 2, 4, 8, 9, 16, 64, 128, 256 }) {
+        auto const trie_scalar = build<false>(fanout, num_parents, seed);
+        auto const trie_fast = build<true>(fanout, num_parents, seed);
+
+        double ns_scalar = std::numeric_limits<double>::max(), ns_fast = std::numeric_limits<double>::max();
+        uint64_t checksum_scalar, checksum_fast;
+        for(size_t r = 0; r < num_rounds; r++) {
+            ns_scalar = std::min(ns_scalar, bench<false>(trie_scalar, queries, checksum_scalar));
+            ns_fast = std::min(ns_fast, bench<true>(trie_fast, queries, checksum_fast));
+        }
+        std::cout << fanout << "\t" << std::fixed << std::setprecision(2) << ns_scalar << "\t" << ns_fast << std::endl;
+
+        if(checksum_scalar != checksum_fast) {
+            std::cerr << "checksum mismatch: " << checksum_scalar << " vs. " << checksum_fast << std::endl;
+            return -1;
+        }
+    }
+    return 0;
+}
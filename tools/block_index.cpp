@@ -0,0 +1,48 @@
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <string>
+
+#include <pm/result.hpp>
+
+#include <block_coding.hpp>
+#include <memory_mapped_file.hpp>
+
+// prints the block index of a file written with byte-aligned blocks (see --align-blocks)
+// the blocks are located and their tokens counted using only the index and the block headers, without decoding any token data
+
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <file> [-v]" << std::endl;
+        return -1;
+    }
+
+    bool const verbose = (argc > 2) && std::string(argv[2]) == "-v";
+
+    MemoryMappedFile in(argv[1]);
+    BlockIndex index(in.begin(), in.end());
+
+    if(verbose) std::cout << "block\toffset\tbytes\ttokens" << std::endl;
+
+    size_t total_bytes = 0;
+    size_t total_tokens = 0;
+    size_t min_bytes = std::numeric_limits<size_t>::max();
+    size_t max_bytes = 0;
+    for(size_t i = 0; i < index.num_blocks(); i++) {
+        auto const bytes = index.block_bytes(i);
+        auto const tokens = index.num_tokens(i);
+        if(verbose) std::cout << i << "\t" << (index.block_begin(i) - in.begin()) << "\t" << bytes << "\t" << tokens << std::endl;
+
+        total_bytes += bytes;
+        total_tokens += tokens;
+        min_bytes = std::min(min_bytes, bytes);
+        max_bytes = std::max(max_bytes, bytes);
+    }
+
+    std::cout << "# file=" << argv[1] << ", max_block_size=" << index.max_block_size() << std::endl;
+    std::cout << "blocks\ttokens\tbytes\tmin_bytes\tmax_bytes" << std::endl;
+    std::cout << index.num_blocks() << "\t" << total_tokens << "\t" << total_bytes << "\t"
+        << (index.num_blocks() ? min_bytes : 0) << "\t" << max_bytes << std::endl;
+    return 0;
+}